@@ -5,9 +5,12 @@
 #include "app/VulkanObject.h"
 #include "app/Vertex.h"
 #include "app/HelperFunctions.h"
+#include "app/CookedTexture.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/gtx/euler_angles.hpp>
@@ -26,11 +29,19 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
+#include <charconv>
+#include <limits>
 #include <optional>
 #include <set>
 #include <unordered_map>
 #include <random>
 #include <numeric>
+#include <bit>
+#include <iterator>
+#include <cmath>
+#include <functional>
+#include <future>
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -62,7 +73,9 @@ const std::vector<const char*> validationLayers = {
 
 // a swap chain is set of framebuffers that can be swapped for added stability.
 const std::vector<const char*> deviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    // the depth pyramid pushes a different pair of mips per dispatch
+    VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME
 };
 
 // below is a pre-processor directive which when a debug build is run, enables validation
@@ -73,6 +86,33 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
+// an environment variable read as a number, nothing when it is unset. A value that is not wholly
+// a number is ignored and one outside [min, max] clamped, each with a warning, rather than
+// stopping the demo at startup
+template <typename T>
+std::optional<T> readEnvNumber(const char* name, T min, T max)
+{
+    const char* value = std::getenv(name);
+    if (!value) {
+        return std::nullopt;
+    }
+
+    const char* end = value + std::strlen(value);
+    T number{};
+    const auto result = std::from_chars(value, end, number);
+    if (result.ec != std::errc{} || result.ptr != end) {
+        std::cout << "ignoring " << name << "=" << value << ", not a number it can hold" << std::endl;
+        return std::nullopt;
+    }
+
+    // written so NaN goes to min
+    if (!(number >= min && number <= max)) {
+        number = number > max ? max : min;
+        std::cout << "clamping " << name << "=" << value << " to " << number << std::endl;
+    }
+    return number;
+}
+
 // create debug messenger within VkInstance instance
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance,
     const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -145,11 +185,46 @@ void VulkanObject::createCommandBuffers(VkCommandBuffer* commandBuffer, uint32_t
 }
 
 void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> camera) {
+    const auto startupStart = std::chrono::steady_clock::now();
     this->window = window;
     this->camera = camera;
 
     imgui_clear_value = { 0.6f, 0.4f, 0.0f, 1.0f };
 
+    // the contribution threshold depends on the display the demo runs on
+    if (const auto contributionCullPixels = readEnvNumber("MC_CONTRIBUTION_CULL_PIXELS", 0.0f, std::numeric_limits<float>::max()))
+    {
+        contribution_cull_pixels = *contributionCullPixels;
+    }
+
+    // as is the LOD error budget, a pixel of error is less visible on a dense display
+    if (const auto lodErrorPixels = readEnvNumber("MC_LOD_ERROR_PIXELS", 0.0f, std::numeric_limits<float>::max()))
+    {
+        lod_error_pixels = *lodErrorPixels;
+    }
+
+    // start in visibility buffer mode, it can also be toggled from the overlay
+    if (const auto visibilityBuffer = readEnvNumber("MC_VISIBILITY_BUFFER", 0, 1))
+    {
+        visibility_buffer = *visibilityBuffer != 0;
+    }
+    visibilityBufferActive = visibility_buffer;
+
+    // G-buffer format profile index, see gbufferProfiles
+    if (const auto gbufferProfileEnv = readEnvNumber("MC_GBUFFER_PROFILE", 0, static_cast<int>(gbufferProfiles.size()) - 1))
+    {
+        gbuffer_profile = *gbufferProfileEnv;
+    }
+    gbufferProfileActive = gbuffer_profile;
+    displayModeActive = display_mode;
+    cullInstrumentationActive = wantsCullInstrumentation();
+
+    // point light benchmark, 1000, 10000 and 100000 match the overlay's presets
+    if (const auto pointLights = readEnvNumber("MC_POINT_LIGHTS", 0, static_cast<int>(maxPointLights)))
+    {
+        point_light_count = *pointLights;
+    }
+
     MODEL_PATH = "../assets/chicken/chicken.obj";
     TEXTURE_PATH = "../assets/chicken/chicken.png";
 
@@ -163,17 +238,28 @@ void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> ca
     pickPhysicalDevice();
     // create a logical device to use based off physical device
     createLogicalDevice();
+    // seeded with the last run's pipelines when it was on the same device and driver
+    const char* pipelineCachePath = std::getenv("MC_PIPELINE_CACHE");
+    pipelineCache = std::make_unique<mc::PipelineCache>(device, physicalDevice, pipelineCachePath ? pipelineCachePath : "pipeline_cache.bin");
+    // the geometry and lighting layouts take the table's set layout, textures are added later
+    bindlessTable = std::make_unique<mc::BindlessTable>(device, physicalDevice);
+    {
+        const QueueFamilyIndices queueFamilies = findQueueFamilies(physicalDevice);
+        uploadService = std::make_unique<mc::UploadService>(device, physicalDevice,
+            queueFamilies.graphicsFamily.value(), graphicsQueue,
+            queueFamilies.transferFamily.value(), transferQueue);
+    }
     // create a swap chain
     createSwapChain();
     // create our image views
     createImageViews();
     // create render pass object using previous information
     createRenderPass();
-    createComputePipeline();
-    // create graphics pipeline
-    createGraphicsPipeline();
+    // create compute and graphics pipelines
+    createPipelines();
     // create our command pool
     createCommandPool();
+    createCommandPool(&shadowCommandPool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     createDepthResources();
     // function to create framebuffers and populate swapChainFramebuffers vector
     createFramebuffers();
@@ -205,9 +291,18 @@ void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> ca
     loadModel();
     createVertexBuffer();
     createIndexBuffer();
+    createMaterialBuffers();
+    // one submission for every asset above. The graphics queue orders everything after it behind
+    // the copies, starting with the impostor bake that samples the texture
+    uploadService->flush();
+    createImpostorAtlas();
+    // once, a swap chain rebuild uploads the same instances again
+    randomiseInstances();
     createUniformBuffers();
     createSSBOs();
+    createCullInstrumentation();
     updateSSBO();
+    updateLightSSBO();
     createDescriptorPool();
     createDescriptorSets();
 
@@ -245,7 +340,7 @@ void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> ca
     init_info.Device = device;
     init_info.QueueFamily = findQueueFamilies(physicalDevice).graphicsFamily.value();
     init_info.Queue = graphicsQueue;
-    init_info.PipelineCache = VK_NULL_HANDLE;
+    init_info.PipelineCache = pipelineCache->get();
     init_info.DescriptorPool = imgui_descriptor_pool;
     init_info.Allocator = VK_NULL_HANDLE;
     init_info.MinImageCount = static_cast<uint32_t>(swapChainImages.size());
@@ -253,9 +348,8 @@ void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> ca
     init_info.CheckVkResultFn = VK_NULL_HANDLE;
     ImGui_ImplVulkan_Init(&init_info, imgui_render_pass);
 
-    VkCommandBuffer command_buffer = beginSingleTimeCommands();
-    ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
-    endSingleTimeCommands(command_buffer);
+    // submitted by the first frame's flush, ahead of the first overlay draw
+    ImGui_ImplVulkan_CreateFontsTexture(uploadService->getGraphicsCommandBuffer());
 
     createCommandPool(&imgui_command_pool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     imgui_command_buffers.resize(swapChainImageViews.size());
@@ -265,6 +359,10 @@ void VulkanObject::initVulkan(GLFWwindow* window, std::shared_ptr<mc::Camera> ca
     createCommandBuffers();
     // create and set up semaphores and fences
     createSyncObjects();
+
+    startupTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count();
+    std::cout << "startup: " << startupTimeMs << " ms, pipelines: " << pipelineCreationTimeMs << " ms ("
+        << (pipelineCache->isWarm() ? "warm" : "cold") << " pipeline cache)" << std::endl;
 }
 
 VkFormat VulkanObject::findDepthFormat() {
@@ -324,7 +422,8 @@ void VulkanObject::createTextureSampler() {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    // trilinear across the cooked mip chain, the far chickens were aliasing off mip 0
+    samplerInfo.maxLod = static_cast<float>(textureMipLevels);
 
     if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
@@ -430,42 +529,61 @@ VkImageView VulkanObject::createImageView(VkImage image, VkFormat format, VkImag
 
 void VulkanObject::loadModel()
 {
-    dragon_model.loadModel("../assets/chicken/chicken.obj");
+    // loaded off this thread so it can log each stage and the parse's progress as they go.
+    // loadModels takes every model the scene draws, though for now that is the one
+    std::future<void> loading = std::async(std::launch::async, [this] {
+        Model::loadModels({ { &dragon_model, "../assets/chicken/chicken.obj" } });
+    });
+
+    constexpr std::array<const char*, 6> stageNames = { "idle", "parse", "dedup", "remap", "LOD", "done" };
+    ModelLoadStage loggedStage = ModelLoadStage::Idle;
+    int loggedPercent = -1;
+    while (loading.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+        const ModelLoadStage stage = dragon_model.getLoadStage();
+        const int percent = static_cast<int>(dragon_model.getParseProgress() * 100.0f);
+        if (stage == loggedStage && (stage != ModelLoadStage::Parse || percent == loggedPercent)) {
+            continue;
+        }
+        std::cout << "model load: " << stageNames[static_cast<size_t>(stage)];
+        if (stage == ModelLoadStage::Parse) {
+            std::cout << " " << percent << "%";
+        }
+        std::cout << std::endl;
+        loggedStage = stage;
+        loggedPercent = percent;
+    }
+    // rethrows whatever the load threw
+    loading.get();
+
+    ModelLoadTimings const& timings = dragon_model.getLoadTimings();
+    std::cout << "model load: parse " << timings.parseMs << " ms, dedup " << timings.dedupMs
+        << " ms, remap " << timings.remapMs << " ms, LOD " << timings.lodMs << " ms" << std::endl;
 }
 
 void VulkanObject::createTextureImageView() {
-    textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    textureImageView = createImageView(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, textureMipLevels);
 }
 
+// the texture is cooked once in to a mip chained, block compressed file beside the PNG (see
+// CookedTexture.h) and later starts read that straight in to the staging buffer. BC1 when the
+// device can sample it, raw RGBA8 otherwise
 void VulkanObject::createTextureImage() {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
+    const mc::TextureEncoding encoding = textureCompressionBCSupported ? mc::TextureEncoding::BC1 : mc::TextureEncoding::RGBA8;
+    const mc::CookedTexture cookedTexture(TEXTURE_PATH, encoding);
+    if (cookedTexture.wasCooked()) {
+        std::cout << "Cooked " << mc::CookedTexture::cachePath(TEXTURE_PATH, encoding).string() << std::endl;
     }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    stbi_image_free(pixels);
+    textureFormat = cookedTexture.getFormat();
+    textureMipLevels = cookedTexture.getMipCount();
+    VkDeviceSize imageSize = cookedTexture.getDataSize();
 
-    createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+    createImage(cookedTexture.getWidth(), cookedTexture.getHeight(), textureFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory, textureMipLevels);
 
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-
-    transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // the file is read straight in to the upload ring, the service leaves the image shader readable
+    uploadService->uploadImage(textureImage, textureMipLevels, imageSize,
+        [&](void* data) { cookedTexture.readData(data); },
+        cookedTexture.getCopyRegions());
 }
 
 void VulkanObject::createImage(
@@ -514,33 +632,76 @@ void VulkanObject::createImage(
 }
 
 void VulkanObject::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 1> computePoolSizes{};
+    std::array<VkDescriptorPoolSize, 4> computePoolSizes{};
     computePoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    computePoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 20);
+    computePoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 40);
+    computePoolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    computePoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
+    // the depth pyramid and its reprojection in to the culling view
+    computePoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    computePoolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 4);
+    // the top down debug image of the instrumented cull
+    computePoolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    computePoolSizes[3].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
 
     VkDescriptorPoolCreateInfo computePoolInfo{};
     computePoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     computePoolInfo.poolSizeCount = static_cast<uint32_t>(computePoolSizes.size());
     computePoolInfo.pPoolSizes = computePoolSizes.data();
-    computePoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+    // one set per image for the camera cull and one for the shadow cull
+    computePoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size() * 2);
 
     if (vkCreateDescriptorPool(device, &computePoolInfo, nullptr, &computeDescriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 
-    std::array<VkDescriptorPoolSize, 2> depthPyramidComputePoolSizes{};
-    depthPyramidComputePoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    depthPyramidComputePoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 50);
-    depthPyramidComputePoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    depthPyramidComputePoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 50);
+    std::array<VkDescriptorPoolSize, 2> drawSortPoolSizes{};
+    drawSortPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    drawSortPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    drawSortPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    drawSortPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 7);
+
+    VkDescriptorPoolCreateInfo drawSortPoolInfo{};
+    drawSortPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    drawSortPoolInfo.poolSizeCount = static_cast<uint32_t>(drawSortPoolSizes.size());
+    drawSortPoolInfo.pPoolSizes = drawSortPoolSizes.data();
+    drawSortPoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+
+    if (vkCreateDescriptorPool(device, &drawSortPoolInfo, nullptr, &drawSortDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::array<VkDescriptorPoolSize, 3> lightCullPoolSizes{};
+    lightCullPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    lightCullPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    lightCullPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightCullPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
+    lightCullPoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    lightCullPoolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+
+    VkDescriptorPoolCreateInfo lightCullPoolInfo{};
+    lightCullPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    lightCullPoolInfo.poolSizeCount = static_cast<uint32_t>(lightCullPoolSizes.size());
+    lightCullPoolInfo.pPoolSizes = lightCullPoolSizes.data();
+    lightCullPoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+
+    if (vkCreateDescriptorPool(device, &lightCullPoolInfo, nullptr, &lightCullDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::array<VkDescriptorPoolSize, 2> aabbBinPoolSizes{};
+    aabbBinPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    aabbBinPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    aabbBinPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    aabbBinPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
 
-    VkDescriptorPoolCreateInfo depthPyramidComputePoolInfo{};
-    depthPyramidComputePoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    depthPyramidComputePoolInfo.poolSizeCount = static_cast<uint32_t>(depthPyramidComputePoolSizes.size());
-    depthPyramidComputePoolInfo.pPoolSizes = depthPyramidComputePoolSizes.data();
-    depthPyramidComputePoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size() * 50);
+    VkDescriptorPoolCreateInfo aabbBinPoolInfo{};
+    aabbBinPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    aabbBinPoolInfo.poolSizeCount = static_cast<uint32_t>(aabbBinPoolSizes.size());
+    aabbBinPoolInfo.pPoolSizes = aabbBinPoolSizes.data();
+    aabbBinPoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
 
-    if (vkCreateDescriptorPool(device, &depthPyramidComputePoolInfo, nullptr, &depthPyramidComputeDescriptorPool) != VK_SUCCESS) {
+    if (vkCreateDescriptorPool(device, &aabbBinPoolInfo, nullptr, &aabbBinDescriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 
@@ -550,7 +711,7 @@ void VulkanObject::createDescriptorPool() {
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 6);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -562,7 +723,7 @@ void VulkanObject::createDescriptorPool() {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 
-    std::array<VkDescriptorPoolSize, 6> lightingPoolSizes{};
+    std::array<VkDescriptorPoolSize, 8> lightingPoolSizes{};
     lightingPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     lightingPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 20);
     lightingPoolSizes[1].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
@@ -575,6 +736,12 @@ void VulkanObject::createDescriptorPool() {
     lightingPoolSizes[4].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
     lightingPoolSizes[5].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     lightingPoolSizes[5].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    lightingPoolSizes[6].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    lightingPoolSizes[6].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    // the debug buffer and its tile lists, or the transforms, vertices and indices the
+    // visibility resolve reads, plus the point lights and their tile lists
+    lightingPoolSizes[7].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    lightingPoolSizes[7].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 6);
 
     VkDescriptorPoolCreateInfo lightingPoolInfo{};
     lightingPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -586,9 +753,11 @@ void VulkanObject::createDescriptorPool() {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 
-    std::array<VkDescriptorPoolSize, 1> shadowPoolSizes{};
+    std::array<VkDescriptorPoolSize, 2> shadowPoolSizes{};
     shadowPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     shadowPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    shadowPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    shadowPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
 
     VkDescriptorPoolCreateInfo shadowPoolInfo{};
     shadowPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -599,6 +768,40 @@ void VulkanObject::createDescriptorPool() {
     if (vkCreateDescriptorPool(device, &shadowPoolInfo, nullptr, &shadowDescriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
+
+    std::array<VkDescriptorPoolSize, 2> pointSplatPoolSizes{};
+    pointSplatPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    pointSplatPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    pointSplatPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pointSplatPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 3);
+
+    VkDescriptorPoolCreateInfo pointSplatPoolInfo{};
+    pointSplatPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pointSplatPoolInfo.poolSizeCount = static_cast<uint32_t>(pointSplatPoolSizes.size());
+    pointSplatPoolInfo.pPoolSizes = pointSplatPoolSizes.data();
+    pointSplatPoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+
+    if (vkCreateDescriptorPool(device, &pointSplatPoolInfo, nullptr, &pointSplatDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::array<VkDescriptorPoolSize, 3> impostorPoolSizes{};
+    impostorPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    impostorPoolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+    impostorPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    impostorPoolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
+    impostorPoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    impostorPoolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size() * 2);
+
+    VkDescriptorPoolCreateInfo impostorPoolInfo{};
+    impostorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    impostorPoolInfo.poolSizeCount = static_cast<uint32_t>(impostorPoolSizes.size());
+    impostorPoolInfo.pPoolSizes = impostorPoolSizes.data();
+    impostorPoolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+
+    if (vkCreateDescriptorPool(device, &impostorPoolInfo, nullptr, &impostorDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
 }
 
 void VulkanObject::createUniformBuffers() {
@@ -640,7 +843,7 @@ void VulkanObject::createSSBOs() {
         scaleSSBO,
         scaleSSBOMemory);
 
-    bufferSize = modelTransforms->modelMatricies.size() * 32;
+    bufferSize = modelTransforms->modelMatricies.size() * indirectCommandStride;
 
     indirectLodSSBO.resize(swapChainImages.size());
     indirectLodSSBOMemory.resize(swapChainImages.size());
@@ -666,6 +869,29 @@ void VulkanObject::createSSBOs() {
             indirectLodCountSSBOMemory[i]);
     }
 
+    // the shadow pass culls against the light frustum into its own draw list so it
+    // never races the camera passes for indirectLodSSBO
+    shadowIndirectSSBO.resize(swapChainImages.size());
+    shadowIndirectSSBOMemory.resize(swapChainImages.size());
+    shadowIndirectCountSSBO.resize(swapChainImages.size());
+    shadowIndirectCountSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            bufferSize,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            shadowIndirectSSBO[i],
+            shadowIndirectSSBOMemory[i]);
+
+        createBuffer(
+            sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            shadowIndirectCountSSBO[i],
+            shadowIndirectCountSSBOMemory[i]);
+    }
+
     bufferSize = dragon_model.getTotalLodLevels() * sizeof(LodConfigData);
 
     lodConfigSSBO.resize(swapChainImages.size());
@@ -698,45 +924,286 @@ void VulkanObject::createSSBOs() {
         previousFrameLODSSBO,
         previousFrameLODSSBOMemory);
 
+    // instances below the contribution threshold, as a VkDrawIndirectCommand header followed
+    // by one mesh id per splat. Reset by the command buffer before each late cull
+    bufferSize = 4 * sizeof(uint32_t) + modelTransforms->modelMatricies.size() * sizeof(uint32_t);
+
+    // one VkDrawIndexedIndirectCommand per LOD, and a region of chickenCount instance ids per
+    // LOD for the bucketed draws to read through firstInstance
+    lodBucketSSBO.resize(swapChainImages.size());
+    lodBucketSSBOMemory.resize(swapChainImages.size());
+    bucketInstanceSSBO.resize(swapChainImages.size());
+    bucketInstanceSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            dragon_model.getTotalLodLevels() * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            lodBucketSSBO[i],
+            lodBucketSSBOMemory[i]);
+
+        createBuffer(
+            dragon_model.getTotalLodLevels() * modelTransforms->modelMatricies.size() * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            bucketInstanceSSBO[i],
+            bucketInstanceSSBOMemory[i]);
+    }
+
+    // scratch copies of the command list and the bucket instance lists for draw_sort.glsl to
+    // scatter in to before copying the sorted order back
+    drawSortCommandScratchSSBO.resize(swapChainImages.size());
+    drawSortCommandScratchSSBOMemory.resize(swapChainImages.size());
+    drawSortInstanceScratchSSBO.resize(swapChainImages.size());
+    drawSortInstanceScratchSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            modelTransforms->modelMatricies.size() * indirectCommandStride,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            drawSortCommandScratchSSBO[i],
+            drawSortCommandScratchSSBOMemory[i]);
+
+        createBuffer(
+            dragon_model.getTotalLodLevels() * modelTransforms->modelMatricies.size() * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            drawSortInstanceScratchSSBO[i],
+            drawSortInstanceScratchSSBOMemory[i]);
+    }
+
+    // impostor billboard draws for the early and late passes, VkDrawIndirectCommand headers
+    // followed by a mesh id list per pass
+    VkDeviceSize impostorBufferSize = 2 * 4 * sizeof(uint32_t) + 2 * modelTransforms->modelMatricies.size() * sizeof(uint32_t);
+
+    impostorSSBO.resize(swapChainImages.size());
+    impostorSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            impostorBufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            impostorSSBO[i],
+            impostorSSBOMemory[i]);
+    }
+
+    pointSplatSSBO.resize(swapChainImages.size());
+    pointSplatSSBOMemory.resize(swapChainImages.size());
+    cullStatsSSBO.resize(swapChainImages.size());
+    cullStatsSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            bufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            pointSplatSSBO[i],
+            pointSplatSSBOMemory[i]);
+
+        createBuffer(
+            sizeof(CullStatsData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            cullStatsSSBO[i],
+            cullStatsSSBOMemory[i]);
+    }
+
+    auto const& clusters = dragon_model.getClusterData();
+    bufferSize = clusters.size() * sizeof(ClusterData);
+
+    createBuffer(
+        bufferSize,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        clusterSSBO,
+        clusterSSBOMemory);
+
+    void* clusterData;
+    vkMapMemory(device, clusterSSBOMemory, 0, bufferSize, 0, &clusterData);
+    memcpy(clusterData, clusters.data(), bufferSize);
+    vkUnmapMemory(device, clusterSSBOMemory);
+
+    clusterDrawSSBO.resize(swapChainImages.size());
+    clusterDrawSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            clusterDrawHeaderSize + maxClusterDraws * indirectCommandStride,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            clusterDrawSSBO[i],
+            clusterDrawSSBOMemory[i]);
+    }
+
+    clusterInstanceSSBO.resize(swapChainImages.size());
+    clusterInstanceSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            getClusterInstanceCapacity() * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            clusterInstanceSSBO[i],
+            clusterInstanceSSBOMemory[i]);
+    }
+
+    createBuffer(
+        maxPointLights * sizeof(PointLight),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        pointLightSSBO,
+        pointLightSSBOMemory);
+
+    // a count per tile, then maxLightsPerTile indices per tile
+    const glm::uvec2 lightTileCount = getLightTileCount();
+    const VkDeviceSize lightTileBufferSize = lightTileCount.x * lightTileCount.y * (1 + maxLightsPerTile) * sizeof(uint32_t);
+
+    lightTileSSBO.resize(swapChainImages.size());
+    lightTileSSBOMemory.resize(swapChainImages.size());
+
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        createBuffer(
+            lightTileBufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            lightTileSSBO[i],
+            lightTileSSBOMemory[i]);
+    }
+}
+
+// the instrumented cull's projected bounds, their SSAABB tile lists and the top down debug
+// image. None of them exist while the plain cull and lighting builds are loaded
+void VulkanObject::createCullInstrumentation()
+{
     struct sphereProjectionDebugData
     {
         glm::vec4 aabb;
       //glm::vec4 depthData;
     };
 
-    bufferSize = modelTransforms->modelMatricies.size() * sizeof(sphereProjectionDebugData);
+    VkDeviceSize bufferSize = modelTransforms->modelMatricies.size() * sizeof(sphereProjectionDebugData);
 
-    sphereProjectionDebugSSBO.resize(swapChainImages.size());
-    sphereProjectionDebugSSBOMemory.resize(swapChainImages.size());
+    // only written and read on the GPU, and only while a view that draws the bounds is open
+    const size_t sphereProjectionDebugCount = cullInstrumentationActive ? swapChainImages.size() : 0;
+    sphereProjectionDebugSSBO.resize(sphereProjectionDebugCount);
+    sphereProjectionDebugSSBOMemory.resize(sphereProjectionDebugCount);
 
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
+    for (size_t i = 0; i < sphereProjectionDebugCount; i++) {
         createBuffer(
             bufferSize,
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             sphereProjectionDebugSSBO[i],
             sphereProjectionDebugSSBOMemory[i]);
     }
+
+    // a count per tile, then maxAabbsPerTile instance indices per tile
+    const glm::uvec2 aabbTileCount = getLightTileCount();
+    bufferSize = aabbTileCount.x * aabbTileCount.y * (1 + maxAabbsPerTile) * sizeof(uint32_t);
+
+    aabbTileSSBO.resize(sphereProjectionDebugCount);
+    aabbTileSSBOMemory.resize(sphereProjectionDebugCount);
+
+    for (size_t i = 0; i < sphereProjectionDebugCount; i++) {
+        createBuffer(
+            bufferSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            aabbTileSSBO[i],
+            aabbTileSSBOMemory[i]);
+    }
+
+    // the early lighting subpass reads the lists before the first binning pass has run
+    if (!aabbTileSSBO.empty())
+    {
+        VkCommandBuffer commandBuffer = uploadService->getGraphicsCommandBuffer();
+        for (VkBuffer aabbTileBuffer : aabbTileSSBO)
+        {
+            vkCmdFillBuffer(commandBuffer, aabbTileBuffer, 0, VK_WHOLE_SIZE, 0);
+        }
+
+        VkMemoryBarrier fillBarrier{};
+        fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+            1, &fillBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    // the top down cull view
+    meshesDrawnDebugViewImage = VK_NULL_HANDLE;
+    meshesDrawnDebugViewImageMemory = VK_NULL_HANDLE;
+    meshesDrawnDebugViewImageView = VK_NULL_HANDLE;
+    if (cullInstrumentationActive)
+    {
+        createImage(100,
+            100,
+            VK_FORMAT_R32G32B32A32_SFLOAT,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            meshesDrawnDebugViewImage,
+            meshesDrawnDebugViewImageMemory);
+
+        meshesDrawnDebugViewImageView = createImageView(meshesDrawnDebugViewImage, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+        transitionImageLayout(meshesDrawnDebugViewImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    }
 }
 
-void VulkanObject::createIndexBuffer() {
-    VkDeviceSize bufferSize = sizeof(dragon_model.getIndices()[0]) * dragon_model.getIndices().size();
+void VulkanObject::destroyCullInstrumentation()
+{
+    // empty and null unless the instrumented cull was active
+    for (size_t i = 0; i < sphereProjectionDebugSSBO.size(); i++)
+    {
+        vkDestroyBuffer(device, sphereProjectionDebugSSBO[i], nullptr);
+        vkFreeMemory(device, sphereProjectionDebugSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, aabbTileSSBO[i], nullptr);
+        vkFreeMemory(device, aabbTileSSBOMemory[i], nullptr);
+    }
+    sphereProjectionDebugSSBO.clear();
+    sphereProjectionDebugSSBOMemory.clear();
+    aabbTileSSBO.clear();
+    aabbTileSSBOMemory.clear();
+    vkDestroyImageView(device, meshesDrawnDebugViewImageView, nullptr);
+    vkDestroyImage(device, meshesDrawnDebugViewImage, nullptr);
+    vkFreeMemory(device, meshesDrawnDebugViewImageMemory, nullptr);
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+// one material per texture for now, every chicken uses the first. A scene with more assets adds
+// its textures to the bindless table and its materials here, the draw does not change
+void VulkanObject::createMaterialBuffers() {
+    const uint32_t chickenTexture = bindlessTable->addTexture(textureSampler, textureImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, dragon_model.getIndices().data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    std::vector<MaterialData> materials(1);
+    materials[0].baseColour = glm::vec4(1.0f);
+    materials[0].albedoTexture = chickenTexture;
+
+    const std::vector<uint32_t> instanceMaterials(chickenCount, 0);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    auto uploadStorageBuffer = [&](const void* source, VkDeviceSize bufferSize, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+    {
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+        uploadService->uploadBuffer(buffer, 0, source, bufferSize);
+    };
+
+    uploadStorageBuffer(materials.data(), materials.size() * sizeof(MaterialData), materialSSBO, materialSSBOMemory);
+    uploadStorageBuffer(instanceMaterials.data(), instanceMaterials.size() * sizeof(uint32_t), instanceMaterialSSBO, instanceMaterialSSBOMemory);
+
+    materialBufferSlot = bindlessTable->addBuffer(materialSSBO);
+    instanceMaterialBufferSlot = bindlessTable->addBuffer(instanceMaterialSSBO);
+}
+
+void VulkanObject::createIndexBuffer() {
+    // 16 or 32 bit, see Model::getIndexType
+    VkDeviceSize bufferSize = dragon_model.getIndexDataSize();
 
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+    // also read as storage by the visibility buffer resolve
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploadService->uploadBuffer(indexBuffer, 0, dragon_model.getIndexData(), bufferSize);
 }
 
 void VulkanObject::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
@@ -768,20 +1235,10 @@ void VulkanObject::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkM
 void VulkanObject::createVertexBuffer() {
     VkDeviceSize bufferSize = sizeof(dragon_model.getVertices()[0]) * dragon_model.getVertices().size();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, dragon_model.getVertices().data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+    // also read as storage by the visibility buffer resolve
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
 
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploadService->uploadBuffer(vertexBuffer, 0, dragon_model.getVertices().data(), bufferSize);
 }
 
 void VulkanObject::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount) {
@@ -800,7 +1257,7 @@ void VulkanObject::transitionImageLayout(VkImage image, VkFormat format, VkImage
     barrier.srcAccessMask = 0;
     barrier.dstAccessMask = 0;
 
-    if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
+    if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
         if (hasStencilComponent(format)) {
@@ -835,105 +1292,35 @@ void VulkanObject::transitionImageLayout(VkImage image, VkFormat format, VkImage
         sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
         destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
     else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_GENERAL) {
         barrier.srcAccessMask = 0;
         barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
         sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+        // the depth pyramid is written and read by compute
+        destinationStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
     }
     else {
         throw std::invalid_argument("unsupported layout transition!");
     }
 
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
+    // recorded in to the upload batch, which the next flush submits ahead of any frame that
+    // uses the image. Saves a queue wait per transition
     vkCmdPipelineBarrier(
-        commandBuffer,
+        uploadService->getGraphicsCommandBuffer(),
         sourceStage, destinationStage,
         0,
         0, nullptr,
         0, nullptr,
         1, &barrier
     );
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void VulkanObject::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-VkCommandBuffer VulkanObject::beginSingleTimeCommands() {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    return commandBuffer;
-}
-
-void VulkanObject::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-void VulkanObject::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
 }
 
 uint32_t VulkanObject::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -953,17 +1340,7 @@ uint32_t VulkanObject::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags
 void VulkanObject::cleanupSwapChain() {
     vkDestroyFramebuffer(device, offScreenPass.frameBuffer, nullptr);
 
-    vkDestroyImageView(device, offScreenPass.position.view, nullptr);
-    vkDestroyImage(device, offScreenPass.position.image, nullptr);
-    vkFreeMemory(device, offScreenPass.position.mem, nullptr);
-
-    vkDestroyImageView(device, offScreenPass.albedo.view, nullptr);
-    vkDestroyImage(device, offScreenPass.albedo.image, nullptr);
-    vkFreeMemory(device, offScreenPass.albedo.mem, nullptr);
-
-    vkDestroyImageView(device, offScreenPass.normal.view, nullptr);
-    vkDestroyImage(device, offScreenPass.normal.image, nullptr);
-    vkFreeMemory(device, offScreenPass.normal.mem, nullptr);
+    destroyGeometryTargets();
 
     vkDestroyImageView(device, offScreenPass.depth.view, nullptr);
     vkDestroyImage(device, offScreenPass.depth.image, nullptr);
@@ -982,6 +1359,14 @@ void VulkanObject::cleanupSwapChain() {
     }
     vkDestroyImageView(device, depthPyramidMultiMipView, nullptr);
 
+    vkDestroyImage(device, reprojectedPyramidImage, nullptr);
+    vkFreeMemory(device, reprojectedPyramidMem, nullptr);
+    for (size_t i = 0; i < reprojectedPyramidViews.size(); ++i)
+    {
+        vkDestroyImageView(device, reprojectedPyramidViews[i], nullptr);
+    }
+    vkDestroyImageView(device, reprojectedPyramidMultiMipView, nullptr);
+
     // destroy all framebuffers in swap chain
     for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
         vkDestroyFramebuffer(device, imgui_frame_buffers[i], nullptr);
@@ -990,9 +1375,9 @@ void VulkanObject::cleanupSwapChain() {
 
     vkFreeCommandBuffers(device, imgui_command_pool, static_cast<uint32_t>(imgui_command_buffers.size()), imgui_command_buffers.data());
     vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    vkFreeCommandBuffers(device, shadowCommandPool, static_cast<uint32_t>(shadowCommandBuffers.size()), shadowCommandBuffers.data());
 
-    //destroy pipeline
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    destroyDisplayModePipelines();
     // destroy render pass resources
     vkDestroyRenderPass(device, imgui_render_pass, nullptr);
     vkDestroyRenderPass(device, renderPass, nullptr);
@@ -1013,10 +1398,32 @@ void VulkanObject::cleanupSwapChain() {
         vkFreeMemory(device, indirectLodSSBOMemory[i], nullptr);
         vkDestroyBuffer(device, indirectLodCountSSBO[i], nullptr);
         vkFreeMemory(device, indirectLodCountSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, shadowIndirectSSBO[i], nullptr);
+        vkFreeMemory(device, shadowIndirectSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, shadowIndirectCountSSBO[i], nullptr);
+        vkFreeMemory(device, shadowIndirectCountSSBOMemory[i], nullptr);
         vkDestroyBuffer(device, lodConfigSSBO[i], nullptr);
         vkFreeMemory(device, lodConfigSSBOMemory[i], nullptr);
-        vkDestroyBuffer(device, sphereProjectionDebugSSBO[i], nullptr);
-        vkFreeMemory(device, sphereProjectionDebugSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, lodBucketSSBO[i], nullptr);
+        vkFreeMemory(device, lodBucketSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, bucketInstanceSSBO[i], nullptr);
+        vkFreeMemory(device, bucketInstanceSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, drawSortCommandScratchSSBO[i], nullptr);
+        vkFreeMemory(device, drawSortCommandScratchSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, drawSortInstanceScratchSSBO[i], nullptr);
+        vkFreeMemory(device, drawSortInstanceScratchSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, impostorSSBO[i], nullptr);
+        vkFreeMemory(device, impostorSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, pointSplatSSBO[i], nullptr);
+        vkFreeMemory(device, pointSplatSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, cullStatsSSBO[i], nullptr);
+        vkFreeMemory(device, cullStatsSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, clusterDrawSSBO[i], nullptr);
+        vkFreeMemory(device, clusterDrawSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, clusterInstanceSSBO[i], nullptr);
+        vkFreeMemory(device, clusterInstanceSSBOMemory[i], nullptr);
+        vkDestroyBuffer(device, lightTileSSBO[i], nullptr);
+        vkFreeMemory(device, lightTileSSBOMemory[i], nullptr);
     }
 
     for (size_t i = 0; i < shadowUniformBuffers.size(); i++)
@@ -1025,6 +1432,8 @@ void VulkanObject::cleanupSwapChain() {
         vkFreeMemory(device, shadowUniformBuffersMemory[i], nullptr);
     }
 
+    destroyCullInstrumentation();
+
     vkDestroyBuffer(device, drawnLastFrameSSBO, nullptr);
     vkFreeMemory(device, drawnLastFrameSSBOMemory, nullptr);
     vkDestroyBuffer(device, previousFrameLODSSBO, nullptr);
@@ -1033,16 +1442,62 @@ void VulkanObject::cleanupSwapChain() {
     vkFreeMemory(device, SSBOMemory, nullptr);
     vkDestroyBuffer(device, scaleSSBO, nullptr);
     vkFreeMemory(device, scaleSSBOMemory, nullptr);
+    vkDestroyBuffer(device, pointLightSSBO, nullptr);
+    vkFreeMemory(device, pointLightSSBOMemory, nullptr);
+    vkDestroyBuffer(device, clusterSSBO, nullptr);
+    vkFreeMemory(device, clusterSSBOMemory, nullptr);
 
+    // createDescriptorPool makes all of them again
     vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, lightingDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, computeDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, drawSortDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, lightCullDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, aabbBinDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, shadowDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, pointSplatDescriptorPool, nullptr);
+    vkDestroyDescriptorPool(device, impostorDescriptorPool, nullptr);
 }
 
-void VulkanObject::cleanup() {
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImPlot::DestroyContext();
-    ImGui::DestroyContext();
-
+// the albedo or visibility target and the normal target, the attachments that change with
+// the visibility buffer and G-buffer profile toggles
+void VulkanObject::destroyGeometryTargets()
+{
+    vkDestroyImageView(device, offScreenPass.albedo.view, nullptr);
+    vkDestroyImage(device, offScreenPass.albedo.image, nullptr);
+    vkFreeMemory(device, offScreenPass.albedo.mem, nullptr);
+
+    vkDestroyImageView(device, offScreenPass.visibility.view, nullptr);
+    vkDestroyImage(device, offScreenPass.visibility.image, nullptr);
+    vkFreeMemory(device, offScreenPass.visibility.mem, nullptr);
+    // only one of the two is created per mode, so neither may be left holding stale handles
+    offScreenPass.albedo = {};
+    offScreenPass.visibility = {};
+
+    vkDestroyImageView(device, offScreenPass.normal.view, nullptr);
+    vkDestroyImage(device, offScreenPass.normal.image, nullptr);
+    vkFreeMemory(device, offScreenPass.normal.mem, nullptr);
+}
+
+// every display mode variant built so far
+void VulkanObject::destroyDisplayModePipelines()
+{
+    for (const auto& [displayMode, pipelines] : displayModePipelines)
+    {
+        vkDestroyPipeline(device, pipelines.cull, nullptr);
+        vkDestroyPipeline(device, pipelines.earlyGeometry, nullptr);
+        vkDestroyPipeline(device, pipelines.lateGeometry, nullptr);
+        vkDestroyPipeline(device, pipelines.lighting, nullptr);
+    }
+    displayModePipelines.clear();
+}
+
+void VulkanObject::cleanup() {
+    ImGui_ImplVulkan_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImPlot::DestroyContext();
+    ImGui::DestroyContext();
+
     // cleanup swap chain
     cleanupSwapChain();
 
@@ -1054,38 +1509,50 @@ void VulkanObject::cleanup() {
 
     vkDestroySampler(device, shadowPass.sampler, nullptr);
     vkDestroySampler(device, shadowPass.pcfsampler, nullptr);
+
+    for (auto* attachment : {&impostorAtlas.albedo, &impostorAtlas.normalDepth})
+    {
+        vkDestroyImageView(device, attachment->view, nullptr);
+        vkDestroyImage(device, attachment->image, nullptr);
+        vkFreeMemory(device, attachment->mem, nullptr);
+    }
+    vkDestroySampler(device, impostorAtlas.sampler, nullptr);
     vkDestroyRenderPass(device, shadowPass.renderPass, nullptr);
 
     vkDestroyFramebuffer(device, geometryFrameBuffer, nullptr);
 
     computeProgram.reset();
     depthPyramidComputeProgram.reset();
+    depthReprojectProgram.reset();
+    clusterCutProgram.reset();
+    drawSortProgram.reset();
+    lightCullProgram.reset();
+    aabbBinProgram.reset();
     lightingProgram.reset();
     geometryProgram.reset();
     shadowProgram.reset();
+    pointSplatProgram.reset();
+    impostorProgram.reset();
 
-    vkDestroyPipeline(device, computePipeline, nullptr);
     vkDestroyPipeline(device, depthPyramidComputePipeline, nullptr);
-    vkDestroyPipeline(device, lateGraphicsPipeline, nullptr);
+    vkDestroyPipeline(device, depthReprojectPipeline, nullptr);
+    vkDestroyPipeline(device, clusterCutPipeline, nullptr);
+    vkDestroyPipeline(device, drawSortPipeline, nullptr);
+    vkDestroyPipeline(device, lightCullPipeline, nullptr);
+    vkDestroyPipeline(device, aabbBinPipeline, nullptr);
     vkDestroyPipeline(device, shadowPipeline, nullptr);
+    vkDestroyPipeline(device, pointSplatPipeline, nullptr);
+    vkDestroyPipeline(device, impostorPipeline, nullptr);
+    vkDestroyPipeline(device, lateImpostorPipeline, nullptr);
 
     vkDestroyRenderPass(device, earlyGeometryPass, nullptr);
     vkDestroyRenderPass(device, lateGeometryPass, nullptr);
-    vkDestroyPipeline(device, lightingPipeline, nullptr);
-
-    vkDestroyDescriptorPool(device, lightingDescriptorPool, nullptr);
-    vkDestroyDescriptorPool(device, computeDescriptorPool, nullptr);
-    vkDestroyDescriptorPool(device, depthPyramidComputeDescriptorPool, nullptr);
-    vkDestroyDescriptorPool(device, shadowDescriptorPool, nullptr);
 
     vkDestroySampler(device, meshesDrawnDebugViewSampler, nullptr);
-    vkDestroyImageView(device, meshesDrawnDebugViewImageView, nullptr);
     vkDestroySampler(device, textureSampler, nullptr);
     vkDestroyImageView(device, textureImageView, nullptr);
 
-    vkDestroyImage(device, meshesDrawnDebugViewImage, nullptr);
     vkDestroyImage(device, textureImage, nullptr);
-    vkFreeMemory(device, meshesDrawnDebugViewImageMemory, nullptr);
     vkFreeMemory(device, textureImageMemory, nullptr);
 
     vkDestroySampler(device, depthNearestSampler, nullptr);
@@ -1114,9 +1581,21 @@ void VulkanObject::cleanup() {
     // destory command pool memory
     vkDestroyCommandPool(device, commandPool, nullptr);
     vkDestroyCommandPool(device, imgui_command_pool, nullptr);
+    vkDestroyCommandPool(device, shadowCommandPool, nullptr);
 
     vkDestroyDescriptorPool(device, imgui_descriptor_pool, VK_NULL_HANDLE);
 
+    vkDestroyBuffer(device, materialSSBO, nullptr);
+    vkFreeMemory(device, materialSSBOMemory, nullptr);
+    vkDestroyBuffer(device, instanceMaterialSSBO, nullptr);
+    vkFreeMemory(device, instanceMaterialSSBOMemory, nullptr);
+    bindlessTable.reset();
+    uploadService.reset();
+
+    // keep what the driver compiled this run for the next start
+    pipelineCache->save();
+    pipelineCache.reset();
+
     // destory logical device
     vkDestroyDevice(device, nullptr);
 
@@ -1302,7 +1781,7 @@ void VulkanObject::createLogicalDevice() {
     // vector of device queue info. One for each family
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     // set of our desired queue family's values
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 
     // set queue priority
     float queuePriority = 1.0f;
@@ -1327,6 +1806,18 @@ void VulkanObject::createLogicalDevice() {
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.multiDrawIndirect = VK_TRUE;
 
+    // the cooked chicken texture is BC1 where the device can filter it, see createTextureImage
+    VkPhysicalDeviceFeatures supportedDeviceFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedDeviceFeatures);
+    VkFormatProperties bc1Properties{};
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_BC1_RGB_SRGB_BLOCK, &bc1Properties);
+    textureCompressionBCSupported = supportedDeviceFeatures.textureCompressionBC &&
+        (bc1Properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    deviceFeatures.textureCompressionBC = textureCompressionBCSupported;
+    // point splats cover more than a pixel, without largePoints gl_PointSize is clamped to 1
+    largePointsSupported = supportedDeviceFeatures.largePoints;
+    deviceFeatures.largePoints = largePointsSupported;
+
     VkPhysicalDeviceVulkan11Features vulkan11Features{};
     vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
     vulkan11Features.shaderDrawParameters = VK_TRUE;
@@ -1341,6 +1832,17 @@ void VulkanObject::createLogicalDevice() {
     vulkan12Features.samplerFilterMinmax = true;
     vulkan12Features.scalarBlockLayout = true;
     vulkan12Features.hostQueryReset = true;
+    // the bindless table, runtime sized arrays indexed per instance and written after binding
+    vulkan12Features.descriptorIndexing = true;
+    vulkan12Features.runtimeDescriptorArray = true;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = true;
+    vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = true;
+    vulkan12Features.descriptorBindingPartiallyBound = true;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+    vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = true;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = true;
+    // upload batches signal a timeline, see UploadService.h
+    vulkan12Features.timelineSemaphore = true;
 
     /*VkPhysicalDeviceHostQueryResetFeatures resetFeatures;
     resetFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES;
@@ -1403,6 +1905,8 @@ void VulkanObject::createLogicalDevice() {
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     // and get the presentation queue handle and assign it to presentQueue
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    // and the queue uploads go on, which is the graphics queue when there is no transfer family
+    vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
 }
 
 void VulkanObject::createQueryPools()
@@ -1569,6 +2073,18 @@ void VulkanObject::createImguiPass()
     }
 }
 
+glm::uvec2 VulkanObject::getLightTileCount() const
+{
+    return (glm::uvec2(swapChainExtent.width, swapChainExtent.height) + (lightTileSize - 1)) / lightTileSize;
+}
+
+uint32_t VulkanObject::getClusterInstanceCapacity() const
+{
+    // a row of cluster_cut.glsl workgroups per instance, and dispatches stop at 65535 rows
+    const uint32_t maxCut = std::max(dragon_model.getMaxClusterCut(), uint32_t{ 1 });
+    return std::clamp(maxClusterDraws / maxCut, uint32_t{ 1 }, uint32_t{ 65535 });
+}
+
 uint32_t VulkanObject::getPow2Size(uint32_t width, uint32_t height)
 {
     uint32_t imageHeightPow2 = std::pow(2, static_cast<uint32_t>(std::ceil(std::log2f(swapChainExtent.height))));
@@ -1580,28 +2096,33 @@ uint32_t VulkanObject::getPow2Size(uint32_t width, uint32_t height)
 void VulkanObject::createGeometryPass(bool const clearAttachmentsOnLoad, VkRenderPass& geometryPass)
 {
     //static bool firstRun = true;
+    const GBufferProfile& gbufferProfile = gbufferProfiles[gbufferProfileActive];
     std::array<VkAttachmentDescription, 4> attachmentDescriptions{};
     std::array<VkImageView, 4> imageViews{};
 
     std::array<VkAttachmentReference, 2> colorAttachmentRefs{};
 
-	// color 1
+	// color 1. albedo, or the instance and triangle ids in visibility buffer mode. Every LOD and
+    // the cluster hierarchy index the one index buffer, so a triangle id is its index in to it
+    // and each id gets a full 32 bits at any instance count
+    const VkFormat colorOneFormat = visibilityBufferActive ? VK_FORMAT_R32G32_UINT : gbufferProfile.albedo;
+    FrameBufferAttachment& colorOne = visibilityBufferActive ? offScreenPass.visibility : offScreenPass.albedo;
     if (clearAttachmentsOnLoad)
     {
         createImage(swapChainExtent.width,
             swapChainExtent.height,
-            VK_FORMAT_R32G32B32A32_SFLOAT,
+            colorOneFormat,
             VK_IMAGE_TILING_OPTIMAL,
             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            offScreenPass.albedo.image,
-            offScreenPass.albedo.mem);
+            colorOne.image,
+            colorOne.mem);
 
-        imageViews[0] = createImageView(offScreenPass.albedo.image, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
-        offScreenPass.albedo.view = imageViews[0];
+        imageViews[0] = createImageView(colorOne.image, colorOneFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        colorOne.view = imageViews[0];
     }
 
-    attachmentDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attachmentDescriptions[0].format = colorOneFormat;
     attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
     attachmentDescriptions[0].loadOp = clearAttachmentsOnLoad ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
     attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -1618,21 +2139,23 @@ void VulkanObject::createGeometryPass(bool const clearAttachmentsOnLoad, VkRende
     {
         createImage(swapChainExtent.width,
             swapChainExtent.height,
-            VK_FORMAT_A2R10G10B10_UNORM_PACK32,
+            gbufferProfile.normal,
             VK_IMAGE_TILING_OPTIMAL,
             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             offScreenPass.normal.image,
             offScreenPass.normal.mem);
 
-        imageViews[1] = createImageView(offScreenPass.normal.image, VK_FORMAT_A2R10G10B10_UNORM_PACK32, VK_IMAGE_ASPECT_COLOR_BIT);
+        imageViews[1] = createImageView(offScreenPass.normal.image, gbufferProfile.normal, VK_IMAGE_ASPECT_COLOR_BIT);
         offScreenPass.normal.view = imageViews[1];
     }
 
-    attachmentDescriptions[1].format = VK_FORMAT_A2R10G10B10_UNORM_PACK32;
+    // the visibility buffer resolve rebuilds normals from the mesh, so in that mode the normal
+    // target is never written and never loaded or stored
+    attachmentDescriptions[1].format = gbufferProfile.normal;
     attachmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescriptions[1].loadOp = clearAttachmentsOnLoad ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-    attachmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachmentDescriptions[1].loadOp = visibilityBufferActive ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : clearAttachmentsOnLoad ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachmentDescriptions[1].storeOp = visibilityBufferActive ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     attachmentDescriptions[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachmentDescriptions[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachmentDescriptions[1].initialLayout = clearAttachmentsOnLoad ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -1651,69 +2174,7 @@ void VulkanObject::createGeometryPass(bool const clearAttachmentsOnLoad, VkRende
     attachmentDescriptions[2].initialLayout = clearAttachmentsOnLoad ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     attachmentDescriptions[2].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-	// depth
-    if (clearAttachmentsOnLoad)
-    {
-        uint32_t imageMaxSizePow2 = getPow2Size(swapChainExtent.width, swapChainExtent.height);
-
-        auto mipLevels = static_cast<uint32_t>(std::log2(imageMaxSizePow2)) - 1;
-        assert(mipLevels >= 1);
-        createImage(swapChainExtent.width / 2,
-            swapChainExtent.height / 2,
-            VK_FORMAT_R32_SFLOAT,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            depthPyramidImage,
-            depthPyramidMem,
-            mipLevels);
-
-        depthPyramidViews.clear();
-
-        for (size_t mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
-        {
-            depthPyramidViews.emplace_back(
-                createImageView(
-                    depthPyramidImage,
-                    VK_FORMAT_R32_SFLOAT,
-                    VK_IMAGE_ASPECT_COLOR_BIT,
-                    mipLevel)
-            );
-        }
-
-        depthPyramidMultiMipView = createImageView(
-            depthPyramidImage,
-            VK_FORMAT_R32_SFLOAT,
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            0,
-            mipLevels);
-
-        createImage(swapChainExtent.width,
-            swapChainExtent.height,
-            findDepthFormat(),
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            offScreenPass.depth.image,
-            offScreenPass.depth.mem);
-
-        imageViews[imageViews.size() - 1] = createImageView(offScreenPass.depth.image, findDepthFormat(), VK_IMAGE_ASPECT_DEPTH_BIT);
-        offScreenPass.depth.view = imageViews[imageViews.size() - 1];
-
-        createImage(100,
-            100,
-            VK_FORMAT_R32G32B32A32_SFLOAT,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            meshesDrawnDebugViewImage,
-            meshesDrawnDebugViewImageMemory);
-
-        meshesDrawnDebugViewImageView = createImageView(meshesDrawnDebugViewImage, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
-
-
-    }
-
+	// depth, made along with the pyramids by createDepthTargets
     attachmentDescriptions[attachmentDescriptions.size() - 1].format = findDepthFormat();
     attachmentDescriptions[attachmentDescriptions.size() - 1].samples = VK_SAMPLE_COUNT_1_BIT;
     attachmentDescriptions[attachmentDescriptions.size() - 1].loadOp = clearAttachmentsOnLoad ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
@@ -1732,7 +2193,7 @@ void VulkanObject::createGeometryPass(bool const clearAttachmentsOnLoad, VkRende
     subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpassDescriptions[0].inputAttachmentCount = 0;
     subpassDescriptions[0].pInputAttachments = nullptr;
-    subpassDescriptions[0].colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+    subpassDescriptions[0].colorAttachmentCount = visibilityBufferActive ? 1 : static_cast<uint32_t>(colorAttachmentRefs.size());
     subpassDescriptions[0].pColorAttachments = colorAttachmentRefs.data();
     subpassDescriptions[0].pResolveAttachments = nullptr;
     subpassDescriptions[0].pDepthStencilAttachment = &depthAttachmentRef;
@@ -1804,6 +2265,86 @@ void VulkanObject::createGeometryPass(bool const clearAttachmentsOnLoad, VkRende
     //firstRun = false;
 }
 
+// the depth attachment and the pyramids built from it. Apart from the geometry passes so a
+// mode toggle that rebuilds those keeps the pyramid and its history
+void VulkanObject::createDepthTargets()
+{
+    uint32_t imageMaxSizePow2 = getPow2Size(swapChainExtent.width, swapChainExtent.height);
+
+    auto mipLevels = static_cast<uint32_t>(std::log2(imageMaxSizePow2)) - 1;
+    assert(mipLevels >= 1);
+    createImage(swapChainExtent.width / 2,
+        swapChainExtent.height / 2,
+        VK_FORMAT_R32_SFLOAT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        depthPyramidImage,
+        depthPyramidMem,
+        mipLevels);
+
+    depthPyramidViews.clear();
+
+    for (size_t mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
+    {
+        depthPyramidViews.emplace_back(
+            createImageView(
+                depthPyramidImage,
+                VK_FORMAT_R32_SFLOAT,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                mipLevel)
+        );
+    }
+
+    depthPyramidMultiMipView = createImageView(
+        depthPyramidImage,
+        VK_FORMAT_R32_SFLOAT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        0,
+        mipLevels);
+
+    createImage(swapChainExtent.width / 2,
+        swapChainExtent.height / 2,
+        VK_FORMAT_R32_UINT,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        reprojectedPyramidImage,
+        reprojectedPyramidMem,
+        mipLevels);
+
+    reprojectedPyramidViews.clear();
+
+    for (size_t mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
+    {
+        reprojectedPyramidViews.emplace_back(
+            createImageView(
+                reprojectedPyramidImage,
+                VK_FORMAT_R32_UINT,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                mipLevel)
+        );
+    }
+
+    reprojectedPyramidMultiMipView = createImageView(
+        reprojectedPyramidImage,
+        VK_FORMAT_R32_UINT,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        0,
+        mipLevels);
+
+    createImage(swapChainExtent.width,
+        swapChainExtent.height,
+        findDepthFormat(),
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        offScreenPass.depth.image,
+        offScreenPass.depth.mem);
+
+    offScreenPass.depth.view = createImageView(offScreenPass.depth.image, findDepthFormat(), VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
 void VulkanObject::createEarlyGeometryPass()
 {
     createGeometryPass(true, earlyGeometryPass);
@@ -1878,11 +2419,12 @@ void VulkanObject::createShadowPass()
 
     attachmentDescriptions[attachmentDescriptions.size() - 1].format = findDepthFormat();
     attachmentDescriptions[attachmentDescriptions.size() - 1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachmentDescriptions[attachmentDescriptions.size() - 1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    // the shadow map is cached between frames, dirty tiles are cleared inside the pass
+    attachmentDescriptions[attachmentDescriptions.size() - 1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
     attachmentDescriptions[attachmentDescriptions.size() - 1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachmentDescriptions[attachmentDescriptions.size() - 1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachmentDescriptions[attachmentDescriptions.size() - 1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachmentDescriptions[attachmentDescriptions.size() - 1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachmentDescriptions[attachmentDescriptions.size() - 1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
     attachmentDescriptions[attachmentDescriptions.size() - 1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
     VkAttachmentReference depthAttachmentRef{};
@@ -1935,10 +2477,327 @@ void VulkanObject::createShadowPass()
     }
 }
 
+void VulkanObject::createImpostorAtlas()
+{
+    const uint32_t atlasSize = impostorFramesPerSide * impostorFrameSize;
+
+    impostorAtlas.albedo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    impostorAtlas.normalDepth.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    for (auto* attachment : {&impostorAtlas.albedo, &impostorAtlas.normalDepth})
+    {
+        createImage(atlasSize,
+            atlasSize,
+            attachment->format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            attachment->image,
+            attachment->mem);
+
+        attachment->view = createImageView(attachment->image, attachment->format, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    // depth is only needed while baking
+    FrameBufferAttachment bakeDepth{};
+    bakeDepth.format = findDepthFormat();
+
+    createImage(atlasSize,
+        atlasSize,
+        bakeDepth.format,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        bakeDepth.image,
+        bakeDepth.mem);
+
+    bakeDepth.view = createImageView(bakeDepth.image, bakeDepth.format, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    // frames sit next to each other in the atlas, clamp so the outer frames don't wrap
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &impostorAtlas.sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    std::array<VkAttachmentDescription, 3> attachmentDescriptions{};
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        attachmentDescriptions[i].format = i == 0 ? impostorAtlas.albedo.format : impostorAtlas.normalDepth.format;
+        attachmentDescriptions[i].samples = VK_SAMPLE_COUNT_1_BIT;
+        // cleared to zero alpha, which marks texels outside the mesh
+        attachmentDescriptions[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachmentDescriptions[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachmentDescriptions[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescriptions[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescriptions[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachmentDescriptions[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+
+    attachmentDescriptions[2].format = bakeDepth.format;
+    attachmentDescriptions[2].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachmentDescriptions[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachmentDescriptions[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachmentDescriptions[2].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachmentDescriptions[2].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachmentDescriptions[2].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachmentDescriptions[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    std::array<VkAttachmentReference, 2> colorAttachmentRefs{};
+    colorAttachmentRefs[0] = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    colorAttachmentRefs[1] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    VkAttachmentReference depthAttachmentRef{ 2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    VkSubpassDescription subpassDescription{};
+    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescription.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+    subpassDescription.pColorAttachments = colorAttachmentRefs.data();
+    subpassDescription.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = 0;
+    dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    VkRenderPassCreateInfo bakePassInfo{};
+    bakePassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    bakePassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+    bakePassInfo.pAttachments = attachmentDescriptions.data();
+    bakePassInfo.subpassCount = 1;
+    bakePassInfo.pSubpasses = &subpassDescription;
+    bakePassInfo.dependencyCount = 1;
+    bakePassInfo.pDependencies = &dependency;
+
+    VkRenderPass bakePass;
+    if (vkCreateRenderPass(device, &bakePassInfo, nullptr, &bakePass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    std::array<VkImageView, 3> attachments = {
+        impostorAtlas.albedo.view,
+        impostorAtlas.normalDepth.view,
+        bakeDepth.view,
+    };
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = bakePass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = atlasSize;
+    framebufferInfo.height = atlasSize;
+    framebufferInfo.layers = 1;
+
+    VkFramebuffer bakeFrameBuffer;
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &bakeFrameBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer!");
+    }
+
+    auto bakeVertShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/impostor_bake_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    auto bakeFragShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/impostor_bake_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+    auto bakeProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{bakeVertShaderModule, bakeFragShaderModule});
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = bakeVertShaderModule->get();
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = bakeFragShaderModule->get();
+    shaderStages[1].pName = "main";
+
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // the whole atlas, the vertex shader places each instance in its frame
+    VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(atlasSize), static_cast<float>(atlasSize), 0.0f, 1.0f };
+    VkRect2D scissor{ { 0, 0 }, { atlasSize, atlasSize } };
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments{};
+    for (auto& colorBlendAttachment : colorBlendAttachments)
+    {
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+    }
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.layout = bakeProgram->getLayout();
+    pipelineInfo.renderPass = bakePass;
+    pipelineInfo.subpass = 0;
+
+    VkPipeline bakePipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &bakePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    VkDescriptorPoolSize bakePoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
+
+    VkDescriptorPoolCreateInfo bakePoolInfo{};
+    bakePoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    bakePoolInfo.poolSizeCount = 1;
+    bakePoolInfo.pPoolSizes = &bakePoolSize;
+    bakePoolInfo.maxSets = 1;
+
+    VkDescriptorPool bakeDescriptorPool;
+    if (vkCreateDescriptorPool(device, &bakePoolInfo, nullptr, &bakeDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    VkDescriptorSetLayout bakeSetLayout = bakeProgram->getSetLayout();
+    VkDescriptorSetAllocateInfo bakeAllocInfo{};
+    bakeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    bakeAllocInfo.descriptorPool = bakeDescriptorPool;
+    bakeAllocInfo.descriptorSetCount = 1;
+    bakeAllocInfo.pSetLayouts = &bakeSetLayout;
+
+    VkDescriptorSet bakeDescriptorSet;
+    if (vkAllocateDescriptorSets(device, &bakeAllocInfo, &bakeDescriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    mc::DescriptorInfo<VkDescriptorImageInfo> imageInfo{
+        textureSampler,
+        textureImageView,
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+
+    VkWriteDescriptorSet bakeDescriptorWrite{};
+    bakeDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    bakeDescriptorWrite.dstSet = bakeDescriptorSet;
+    bakeDescriptorWrite.dstBinding = 0;
+    bakeDescriptorWrite.dstArrayElement = 0;
+    bakeDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bakeDescriptorWrite.descriptorCount = 1;
+    bakeDescriptorWrite.pImageInfo = imageInfo.getPtr();
+
+    vkUpdateDescriptorSets(device, 1, &bakeDescriptorWrite, 0, nullptr);
+
+    // every frame is baked from the full detail mesh
+    const LodConfigData lodZero = dragon_model.getLodConfigData().front();
+
+    // part of the upload batch, behind the vertex, index and texture copies it reads
+    VkCommandBuffer commandBuffer = uploadService->getGraphicsCommandBuffer();
+
+    std::array<VkClearValue, 3> clearValues{};
+    clearValues[0].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+    clearValues[1].color = { 0.0f, 0.0f, 0.0f, 0.0f };
+    clearValues[2].depthStencil = { 1.0f, 0 };
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = bakePass;
+    renderPassInfo.framebuffer = bakeFrameBuffer;
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = { atlasSize, atlasSize };
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkBuffer vertexBuffers[] = { vertexBuffer };
+    VkDeviceSize offsets[] = { 0 };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bakePipeline);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, dragon_model.getIndexType());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bakeProgram->getLayout(), 0, 1, &bakeDescriptorSet, 0, nullptr);
+
+    // one instance per frame
+    vkCmdDrawIndexed(commandBuffer, lodZero.size, impostorFramesPerSide * impostorFramesPerSide, lodZero.offset, lodZero.vertexOffset, 0);
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    // the bake only objects go once the batch has run
+    uploadService->releaseAfterBatch([this, bakeProgram, bakeDescriptorPool, bakePipeline, bakeFrameBuffer, bakePass, bakeDepth] {
+        vkDestroyDescriptorPool(device, bakeDescriptorPool, nullptr);
+        vkDestroyPipeline(device, bakePipeline, nullptr);
+        vkDestroyFramebuffer(device, bakeFrameBuffer, nullptr);
+        vkDestroyRenderPass(device, bakePass, nullptr);
+        vkDestroyImageView(device, bakeDepth.view, nullptr);
+        vkDestroyImage(device, bakeDepth.image, nullptr);
+        vkFreeMemory(device, bakeDepth.mem, nullptr);
+    });
+}
+
 // create our render pass object
 void VulkanObject::createRenderPass()
 {
     createShadowPass();
+    createDepthTargets();
     createEarlyGeometryPass();
     createLateGeometryPass();
     createImguiPass();
@@ -1962,6 +2821,14 @@ void VulkanObject::recreateSwapChain() {
 
     // clear swap chain
     cleanupSwapChain();
+    depthPyramidHistoryValid = false;
+    // the geometry pass attachments and lighting subpass are built for the requested mode
+    visibilityBufferActive = visibility_buffer;
+    gbufferProfileActive = gbuffer_profile;
+    displayModeActive = display_mode;
+    cullInstrumentationActive = wantsCullInstrumentation();
+    // the shadow map is recreated with the swap chain
+    shadowDirtyTiles = shadowCacheAllTiles;
 
     // create swap chain
     createSwapChain();
@@ -1969,9 +2836,8 @@ void VulkanObject::recreateSwapChain() {
     createImageViews();
     // create render pass
     createRenderPass();
-    createComputePipeline();
-    // create graphics pipeline
-    createGraphicsPipeline();
+    // create compute and graphics pipelines
+    createPipelines();
     createDepthResources();
     // create framebuffers
     createFramebuffers();
@@ -1997,14 +2863,14 @@ void VulkanObject::recreateSwapChain() {
 
     createUniformBuffers();
     createSSBOs();
+    createCullInstrumentation();
     updateSSBO();
+    updateLightSSBO();
     createDescriptorPool();
 
     ImGui_ImplVulkan_SetMinImageCount(static_cast<uint32_t>(swapChainImages.size()));
 
-    VkCommandBuffer command_buffer = beginSingleTimeCommands();
-    ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
-    endSingleTimeCommands(command_buffer);
+    ImGui_ImplVulkan_CreateFontsTexture(uploadService->getGraphicsCommandBuffer());
 
     createCommandPool(&imgui_command_pool, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
     imgui_command_buffers.resize(swapChainImageViews.size());
@@ -2015,28 +2881,126 @@ void VulkanObject::recreateSwapChain() {
     createCommandBuffers();
 }
 
-void VulkanObject::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> computeLayouts(swapChainImages.size(), computeProgram->getSetLayout());
-    VkDescriptorSetAllocateInfo computeAllocInfo{};
-    computeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    computeAllocInfo.descriptorPool = computeDescriptorPool;
-    computeAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-    computeAllocInfo.pSetLayouts = computeLayouts.data();
-
-    computeDescriptorSets.resize(swapChainImages.size());
-    if (vkAllocateDescriptorSets(device, &computeAllocInfo, computeDescriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate descriptor sets!");
-    }
+// the visibility buffer, G-buffer profile and cull instrumentation toggles. Only the geometry
+// targets, the programs and pipelines built on them and the instrumented cull's debug
+// resources are rebuilt. The swap chain, the instances, the depth pyramid and its history and
+// the cached shadow map are all kept
+void VulkanObject::applyModeChange()
+{
+    vkDeviceWaitIdle(device);
 
-    std::vector<VkDescriptorSetLayout> depthPyramidComputeLayouts(swapChainImages.size(), depthPyramidComputeProgram->getSetLayout());
-    VkDescriptorSetAllocateInfo depthPyramidComputeAllocInfo{};
-    depthPyramidComputeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    depthPyramidComputeAllocInfo.descriptorPool = depthPyramidComputeDescriptorPool;
-    depthPyramidComputeAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-    depthPyramidComputeAllocInfo.pSetLayouts = depthPyramidComputeLayouts.data();
+    const bool geometryTargetsChanged = visibility_buffer != visibilityBufferActive || gbuffer_profile != gbufferProfileActive;
+    const bool instrumentationChanged = wantsCullInstrumentation() != cullInstrumentationActive;
+    visibilityBufferActive = visibility_buffer;
+    gbufferProfileActive = gbuffer_profile;
+    displayModeActive = display_mode;
+    cullInstrumentationActive = wantsCullInstrumentation();
 
-    depthPyramidComputeDescriptorSets.resize(swapChainImages.size());
-    if (vkAllocateDescriptorSets(device, &depthPyramidComputeAllocInfo, depthPyramidComputeDescriptorSets.data()) != VK_SUCCESS) {
+    // every variant was specialised against the old programs and render passes
+    destroyDisplayModePipelines();
+    vkDestroyPipeline(device, shadowPipeline, nullptr);
+    vkDestroyPipeline(device, pointSplatPipeline, nullptr);
+    vkDestroyPipeline(device, impostorPipeline, nullptr);
+    vkDestroyPipeline(device, lateImpostorPipeline, nullptr);
+    // the visibility buffer mode does not build these three
+    pointSplatPipeline = VK_NULL_HANDLE;
+    impostorPipeline = VK_NULL_HANDLE;
+    lateImpostorPipeline = VK_NULL_HANDLE;
+
+    if (instrumentationChanged)
+    {
+        destroyCullInstrumentation();
+        createCullInstrumentation();
+        createCullProgram();
+        meshesDrawnDebugViewImageViewImGUITexID = cullInstrumentationActive
+            ? ImGui_ImplVulkan_AddTexture(meshesDrawnDebugViewSampler, meshesDrawnDebugViewImageView, VK_IMAGE_LAYOUT_GENERAL)
+            : VK_NULL_HANDLE;
+    }
+
+    if (geometryTargetsChanged)
+    {
+        for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
+            vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
+        }
+        // createFramebuffers makes the shadow framebuffer again, over the same cached map
+        vkDestroyFramebuffer(device, shadowPass.frameBuffer, nullptr);
+        vkDestroyRenderPass(device, earlyGeometryPass, nullptr);
+        vkDestroyRenderPass(device, lateGeometryPass, nullptr);
+        destroyGeometryTargets();
+
+        createEarlyGeometryPass();
+        createLateGeometryPass();
+        createFramebuffers();
+    }
+
+    // the lighting program loads the resolve or the instrumented build, the rest are built
+    // against the geometry passes
+    createGraphicsPipeline();
+
+    // the sets are allocated from the program layouts and point at the new targets
+    for (VkDescriptorPool pool : { descriptorPool, lightingDescriptorPool, computeDescriptorPool, drawSortDescriptorPool,
+        lightCullDescriptorPool, aabbBinDescriptorPool, shadowDescriptorPool, pointSplatDescriptorPool, impostorDescriptorPool })
+    {
+        vkResetDescriptorPool(device, pool, 0);
+    }
+    createDescriptorSets();
+
+    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    createCommandBuffers(commandBuffers.data(), static_cast<uint32_t>(commandBuffers.size()), commandPool);
+    recordCommandBuffers();
+}
+
+void VulkanObject::createDescriptorSets() {
+    std::vector<VkDescriptorSetLayout> computeLayouts(swapChainImages.size(), computeProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo computeAllocInfo{};
+    computeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    computeAllocInfo.descriptorPool = computeDescriptorPool;
+    computeAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    computeAllocInfo.pSetLayouts = computeLayouts.data();
+
+    computeDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &computeAllocInfo, computeDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    shadowComputeDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &computeAllocInfo, shadowComputeDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::vector<VkDescriptorSetLayout> drawSortLayouts(swapChainImages.size(), drawSortProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo drawSortAllocInfo{};
+    drawSortAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    drawSortAllocInfo.descriptorPool = drawSortDescriptorPool;
+    drawSortAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    drawSortAllocInfo.pSetLayouts = drawSortLayouts.data();
+
+    drawSortDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &drawSortAllocInfo, drawSortDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::vector<VkDescriptorSetLayout> lightCullLayouts(swapChainImages.size(), lightCullProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo lightCullAllocInfo{};
+    lightCullAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    lightCullAllocInfo.descriptorPool = lightCullDescriptorPool;
+    lightCullAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    lightCullAllocInfo.pSetLayouts = lightCullLayouts.data();
+
+    lightCullDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &lightCullAllocInfo, lightCullDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::vector<VkDescriptorSetLayout> aabbBinLayouts(swapChainImages.size(), aabbBinProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo aabbBinAllocInfo{};
+    aabbBinAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    aabbBinAllocInfo.descriptorPool = aabbBinDescriptorPool;
+    aabbBinAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    aabbBinAllocInfo.pSetLayouts = aabbBinLayouts.data();
+
+    aabbBinDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &aabbBinAllocInfo, aabbBinDescriptorSets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
 
@@ -2076,6 +3040,32 @@ void VulkanObject::createDescriptorSets() {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
 
+    std::vector<VkDescriptorSetLayout> pointSplatLayouts(swapChainImages.size(), pointSplatProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo pointSplatAllocInfo{};
+    pointSplatAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    pointSplatAllocInfo.descriptorPool = pointSplatDescriptorPool;
+    pointSplatAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    pointSplatAllocInfo.pSetLayouts = pointSplatLayouts.data();
+
+    pointSplatDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &pointSplatAllocInfo, pointSplatDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    std::vector<VkDescriptorSetLayout> impostorLayouts(swapChainImages.size(), impostorProgram->getSetLayout());
+    VkDescriptorSetAllocateInfo impostorAllocInfo{};
+    impostorAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    impostorAllocInfo.descriptorPool = impostorDescriptorPool;
+    impostorAllocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
+    impostorAllocInfo.pSetLayouts = impostorLayouts.data();
+
+    impostorDescriptorSets.resize(swapChainImages.size());
+    if (vkAllocateDescriptorSets(device, &impostorAllocInfo, impostorDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    clusterCutDescriptors.resize(swapChainImages.size());
+
     for (size_t i = 0; i < swapChainImages.size(); i++) {
         mc::DescriptorInfo<VkDescriptorBufferInfo> uboInfo{
             uniformBuffers[i],
@@ -2095,13 +3085,23 @@ void VulkanObject::createDescriptorSets() {
         mc::DescriptorInfo<VkDescriptorBufferInfo> indirectSsboInfo{
             indirectLodSSBO[i],
             0,
-            modelTransforms->modelMatricies.size() * 32};
+            modelTransforms->modelMatricies.size() * indirectCommandStride};
 
         mc::DescriptorInfo<VkDescriptorBufferInfo> indirectSsboCountInfo{
             indirectLodCountSSBO[i],
             0,
             sizeof(uint32_t)};
 
+        mc::DescriptorInfo<VkDescriptorBufferInfo> shadowIndirectSsboInfo{
+            shadowIndirectSSBO[i],
+            0,
+            modelTransforms->modelMatricies.size() * indirectCommandStride};
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> shadowIndirectSsboCountInfo{
+            shadowIndirectCountSSBO[i],
+            0,
+            sizeof(uint32_t)};
+
         mc::DescriptorInfo<VkDescriptorBufferInfo> lodConfigSsboInfo{
             lodConfigSSBO[i],
             0,
@@ -2118,10 +3118,75 @@ void VulkanObject::createDescriptorSets() {
             modelTransforms->modelMatricies.size() * sizeof(uint32_t) };
 
         mc::DescriptorInfo<VkDescriptorBufferInfo> sphereProjectionDebugSsboInfo{
-            sphereProjectionDebugSSBO[i],
+            cullInstrumentationActive ? sphereProjectionDebugSSBO[i] : VK_NULL_HANDLE,
             0,
             modelTransforms->modelMatricies.size() * sizeof(glm::vec4) };
 
+        mc::DescriptorInfo<VkDescriptorBufferInfo> pointSplatSsboInfo{
+            pointSplatSSBO[i],
+            0,
+            4 * sizeof(uint32_t) + modelTransforms->modelMatricies.size() * sizeof(uint32_t) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> lodBucketSsboInfo{
+            lodBucketSSBO[i],
+            0,
+            dragon_model.getTotalLodLevels() * sizeof(VkDrawIndexedIndirectCommand) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> bucketInstanceSsboInfo{
+            bucketInstanceSSBO[i],
+            0,
+            dragon_model.getTotalLodLevels() * modelTransforms->modelMatricies.size() * sizeof(uint32_t) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> impostorSsboInfo{
+            impostorSSBO[i],
+            0,
+            2 * 4 * sizeof(uint32_t) + 2 * modelTransforms->modelMatricies.size() * sizeof(uint32_t) };
+
+        mc::DescriptorInfo<VkDescriptorImageInfo> impostorAlbedoInfo{
+            impostorAtlas.sampler,
+            impostorAtlas.albedo.view,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        mc::DescriptorInfo<VkDescriptorImageInfo> impostorNormalDepthInfo{
+            impostorAtlas.sampler,
+            impostorAtlas.normalDepth.view,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> clusterSsboInfo{
+            clusterSSBO,
+            0,
+            dragon_model.getClusterData().size() * sizeof(ClusterData) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> clusterDrawSsboInfo{
+            clusterDrawSSBO[i],
+            0,
+            clusterDrawHeaderSize + maxClusterDraws * indirectCommandStride };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> clusterInstanceSsboInfo{
+            clusterInstanceSSBO[i],
+            0,
+            getClusterInstanceCapacity() * sizeof(uint32_t) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> cullStatsSsboInfo{
+            cullStatsSSBO[i],
+            0,
+            sizeof(CullStatsData) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> pointLightSsboInfo{
+            pointLightSSBO,
+            0,
+            maxPointLights * sizeof(PointLight) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> lightTileSsboInfo{
+            lightTileSSBO[i],
+            0,
+            VK_WHOLE_SIZE };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> aabbTileSsboInfo{
+            cullInstrumentationActive ? aabbTileSSBO[i] : VK_NULL_HANDLE,
+            0,
+            VK_WHOLE_SIZE };
+
         mc::DescriptorInfo<VkDescriptorBufferInfo> shadowBufferInfo{
             shadowUniformBuffers[i],
             0,
@@ -2137,13 +3202,8 @@ void VulkanObject::createDescriptorSets() {
             shadowPass.depth.view,
             VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
 
-        mc::DescriptorInfo<VkDescriptorImageInfo> imageInfo{
-            textureSampler,
-            textureImageView,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-
         mc::DescriptorInfo<VkDescriptorImageInfo> colorDescriptorInfo{
-            offScreenPass.albedo.view,
+            visibilityBufferActive ? offScreenPass.visibility.view : offScreenPass.albedo.view,
             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
 
         mc::DescriptorInfo<VkDescriptorImageInfo> normalDescriptorInfo{
@@ -2174,276 +3234,367 @@ void VulkanObject::createDescriptorSets() {
             depthPyramidMultiMipView,
             VK_IMAGE_LAYOUT_GENERAL};
 
+        // max reduction over every mip, for the furthest depth under a light tile
+        mc::DescriptorInfo<VkDescriptorImageInfo> depthMultiMipMaxDescriptorInfo{
+            depthSampler,
+            depthPyramidMultiMipView,
+            VK_IMAGE_LAYOUT_GENERAL };
+
         mc::DescriptorInfo<VkDescriptorImageInfo> depthMultiMipReduceDescriptorInfo{
             depthNearestMinSampler,
             depthPyramidMultiMipView,
             VK_IMAGE_LAYOUT_GENERAL };
 
-        std::array<VkWriteDescriptorSet, 11> computeDescriptorWrites{};
-
-        computeDescriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[0].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[0].dstBinding = 0;
-        computeDescriptorWrites[0].dstArrayElement = 0;
-        computeDescriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[0].descriptorCount = 1;
-        computeDescriptorWrites[0].pBufferInfo = ssboInfo.getPtr();
-
-        computeDescriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[1].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[1].dstBinding = 1;
-        computeDescriptorWrites[1].dstArrayElement = 0;
-        computeDescriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[1].descriptorCount = 1;
-        computeDescriptorWrites[1].pBufferInfo = indirectSsboInfo.getPtr();
-
-        computeDescriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[2].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[2].dstBinding = 2;
-        computeDescriptorWrites[2].dstArrayElement = 0;
-        computeDescriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        computeDescriptorWrites[2].descriptorCount = 1;
-        computeDescriptorWrites[2].pBufferInfo = uboInfo.getPtr();
-
-        computeDescriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[3].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[3].dstBinding = 3;
-        computeDescriptorWrites[3].dstArrayElement = 0;
-        computeDescriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[3].descriptorCount = 1;
-        computeDescriptorWrites[3].pBufferInfo = lodConfigSsboInfo.getPtr();
-
-        computeDescriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[4].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[4].dstBinding = 4;
-        computeDescriptorWrites[4].dstArrayElement = 0;
-        computeDescriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[4].descriptorCount = 1;
-        computeDescriptorWrites[4].pBufferInfo = scaleSsboInfo.getPtr();
-
-        computeDescriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[5].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[5].dstBinding = 5;
-        computeDescriptorWrites[5].dstArrayElement = 0;
-        computeDescriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        computeDescriptorWrites[5].descriptorCount = 1;
-        computeDescriptorWrites[5].pImageInfo = depthMultiMipReduceDescriptorInfo.getPtr();
-
-        computeDescriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[6].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[6].dstBinding = 6;
-        computeDescriptorWrites[6].dstArrayElement = 0;
-        computeDescriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[6].descriptorCount = 1;
-        computeDescriptorWrites[6].pBufferInfo = drawnLastFrameSsboInfo.getPtr();
-
-        computeDescriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[7].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[7].dstBinding = 7;
-        computeDescriptorWrites[7].dstArrayElement = 0;
-        computeDescriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        computeDescriptorWrites[7].descriptorCount = 1;
-        computeDescriptorWrites[7].pImageInfo = meshesDrawnDebugViewDescriptorInfo.getPtr();
-
-        computeDescriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[8].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[8].dstBinding = 8;
-        computeDescriptorWrites[8].dstArrayElement = 0;
-        computeDescriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[8].descriptorCount = 1;
-        computeDescriptorWrites[8].pBufferInfo = sphereProjectionDebugSsboInfo.getPtr();
-
-        computeDescriptorWrites[9].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[9].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[9].dstBinding = 9;
-        computeDescriptorWrites[9].dstArrayElement = 0;
-        computeDescriptorWrites[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[9].descriptorCount = 1;
-        computeDescriptorWrites[9].pBufferInfo = indirectSsboCountInfo.getPtr();
-
-        computeDescriptorWrites[10].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        computeDescriptorWrites[10].dstSet = computeDescriptorSets[i];
-        computeDescriptorWrites[10].dstBinding = 10;
-        computeDescriptorWrites[10].dstArrayElement = 0;
-        computeDescriptorWrites[10].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        computeDescriptorWrites[10].descriptorCount = 1;
-        computeDescriptorWrites[10].pBufferInfo = previousFrameLODSsboInfo.getPtr();
-
-        vkUpdateDescriptorSets(
-            device,
-            static_cast<uint32_t>(computeDescriptorWrites.size()),
-            computeDescriptorWrites.data(),
+        mc::DescriptorInfo<VkDescriptorImageInfo> reprojectedMultiMipDescriptorInfo{
+            depthNearestSampler,
+            reprojectedPyramidMultiMipView,
+            VK_IMAGE_LAYOUT_GENERAL };
+
+        mc::DescriptorSetData cullDescriptors;
+        cullDescriptors[0] = ssboInfo;
+        cullDescriptors[1] = indirectSsboInfo;
+        cullDescriptors[2] = uboInfo;
+        cullDescriptors[3] = lodConfigSsboInfo;
+        cullDescriptors[4] = scaleSsboInfo;
+        cullDescriptors[5] = depthMultiMipReduceDescriptorInfo;
+        cullDescriptors[6] = drawnLastFrameSsboInfo;
+        cullDescriptors[7] = meshesDrawnDebugViewDescriptorInfo;
+        cullDescriptors[8] = sphereProjectionDebugSsboInfo;
+        cullDescriptors[9] = indirectSsboCountInfo;
+        cullDescriptors[10] = previousFrameLODSsboInfo;
+        cullDescriptors[11] = pointSplatSsboInfo;
+        cullDescriptors[12] = cullStatsSsboInfo;
+        cullDescriptors[13] = impostorSsboInfo;
+        cullDescriptors[14] = lodBucketSsboInfo;
+        cullDescriptors[15] = bucketInstanceSsboInfo;
+        cullDescriptors[16] = clusterInstanceSsboInfo;
+        cullDescriptors[17] = clusterDrawSsboInfo;
+        cullDescriptors[18] = reprojectedMultiMipDescriptorInfo;
+
+        // the template only writes what the cull shader declares, so the top down debug image
+        // and projected bounds are skipped by the plain build
+        computeProgram->updateDescriptorSet(computeDescriptorSets[i], cullDescriptors);
+
+        // the shadow cull shares every binding with the camera cull except the draw list it writes
+        mc::DescriptorSetData shadowCullDescriptors = cullDescriptors;
+        shadowCullDescriptors[1] = shadowIndirectSsboInfo;
+        shadowCullDescriptors[9] = shadowIndirectSsboCountInfo;
+        computeProgram->updateDescriptorSet(shadowComputeDescriptorSets[i], shadowCullDescriptors);
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> drawSortCommandScratchSsboInfo{
+            drawSortCommandScratchSSBO[i],
             0,
-            nullptr);
-
-        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = uboInfo.getPtr();
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = imageInfo.getPtr();
-
-        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[2].dstSet = descriptorSets[i];
-        descriptorWrites[2].dstBinding = 2;
-        descriptorWrites[2].dstArrayElement = 0;
-        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].pBufferInfo = ssboInfo.getPtr();
-
-        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[3].dstSet = descriptorSets[i];
-        descriptorWrites[3].dstBinding = 3;
-        descriptorWrites[3].dstArrayElement = 0;
-        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[3].descriptorCount = 1;
-        descriptorWrites[3].pBufferInfo = sphereProjectionDebugSsboInfo.getPtr();
-
-        descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[4].dstSet = descriptorSets[i];
-        descriptorWrites[4].dstBinding = 4;
-        descriptorWrites[4].dstArrayElement = 0;
-        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[4].descriptorCount = 1;
-        descriptorWrites[4].pBufferInfo = indirectSsboInfo.getPtr();
-
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
-        std::array<VkWriteDescriptorSet, 8> lightingDescriptorWrites{};
-
-        lightingDescriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[0].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[0].dstBinding = 0;
-        lightingDescriptorWrites[0].dstArrayElement = 0;
-        lightingDescriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        lightingDescriptorWrites[0].descriptorCount = 1;
-        lightingDescriptorWrites[0].pBufferInfo = uboInfo.getPtr();
-
-        lightingDescriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[1].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-        lightingDescriptorWrites[1].descriptorCount = 1;
-        lightingDescriptorWrites[1].dstBinding = 1;
-        lightingDescriptorWrites[1].pImageInfo = colorDescriptorInfo.getPtr();
-
-        lightingDescriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[2].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-        lightingDescriptorWrites[2].descriptorCount = 1;
-        lightingDescriptorWrites[2].dstBinding = 2;
-        lightingDescriptorWrites[2].pImageInfo = normalDescriptorInfo.getPtr();
-
-        lightingDescriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[3].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-        lightingDescriptorWrites[3].descriptorCount = 1;
-        lightingDescriptorWrites[3].dstBinding = 4;
-        lightingDescriptorWrites[3].pImageInfo = depthDescriptorInfo.getPtr();
-
-        lightingDescriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[4].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[4].dstBinding = 5;
-        lightingDescriptorWrites[4].dstArrayElement = 0;
-        lightingDescriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        lightingDescriptorWrites[4].descriptorCount = 1;
-        lightingDescriptorWrites[4].pImageInfo = shadowImageInfo.getPtr();
-
-        lightingDescriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[5].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[5].dstBinding = 6;
-        lightingDescriptorWrites[5].dstArrayElement = 0;
-        lightingDescriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        lightingDescriptorWrites[5].descriptorCount = 1;
-        lightingDescriptorWrites[5].pImageInfo = PCFShadowImageInfo.getPtr();
-
-        lightingDescriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[6].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[6].dstBinding = 7;
-        lightingDescriptorWrites[6].dstArrayElement = 0;
-        lightingDescriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        lightingDescriptorWrites[6].descriptorCount = 1;
-        lightingDescriptorWrites[6].pImageInfo = depthMultiMipDescriptorInfo.getPtr();
-
-        lightingDescriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        lightingDescriptorWrites[7].dstSet = lightingDescriptorSets[i];
-        lightingDescriptorWrites[7].dstBinding = 8;
-        lightingDescriptorWrites[7].dstArrayElement = 0;
-        lightingDescriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        lightingDescriptorWrites[7].descriptorCount = 1;
-        lightingDescriptorWrites[7].pBufferInfo = sphereProjectionDebugSsboInfo.getPtr();
-
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(lightingDescriptorWrites.size()), lightingDescriptorWrites.data(), 0, nullptr);
-
-        std::array<VkWriteDescriptorSet, 1> shadowDescriptorWrites{};
-
-        shadowDescriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        shadowDescriptorWrites[0].dstSet = shadowDescriptorSets[i];
-        shadowDescriptorWrites[0].dstBinding = 0;
-        shadowDescriptorWrites[0].dstArrayElement = 0;
-        shadowDescriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        shadowDescriptorWrites[0].descriptorCount = 1;
-        shadowDescriptorWrites[0].pBufferInfo = shadowBufferInfo.getPtr();
-
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(shadowDescriptorWrites.size()), shadowDescriptorWrites.data(), 0, nullptr);
+            modelTransforms->modelMatricies.size() * indirectCommandStride };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> drawSortInstanceScratchSsboInfo{
+            drawSortInstanceScratchSSBO[i],
+            0,
+            dragon_model.getTotalLodLevels() * modelTransforms->modelMatricies.size() * sizeof(uint32_t) };
+
+        mc::DescriptorSetData drawSortDescriptors;
+        drawSortDescriptors[0] = uboInfo;
+        drawSortDescriptors[1] = ssboInfo;
+        drawSortDescriptors[2] = indirectSsboInfo;
+        drawSortDescriptors[3] = indirectSsboCountInfo;
+        drawSortDescriptors[4] = lodBucketSsboInfo;
+        drawSortDescriptors[5] = bucketInstanceSsboInfo;
+        drawSortDescriptors[6] = drawSortCommandScratchSsboInfo;
+        drawSortDescriptors[7] = drawSortInstanceScratchSsboInfo;
+
+        drawSortProgram->updateDescriptorSet(drawSortDescriptorSets[i], drawSortDescriptors);
+
+        clusterCutDescriptors[i] = {};
+        clusterCutDescriptors[i][0] = ssboInfo;
+        clusterCutDescriptors[i][1] = uboInfo;
+        clusterCutDescriptors[i][2] = lodConfigSsboInfo;
+        clusterCutDescriptors[i][3] = scaleSsboInfo;
+        clusterCutDescriptors[i][4] = clusterSsboInfo;
+        clusterCutDescriptors[i][5] = clusterInstanceSsboInfo;
+        clusterCutDescriptors[i][6] = clusterDrawSsboInfo;
+
+        mc::DescriptorSetData lightCullDescriptors;
+        lightCullDescriptors[0] = uboInfo;
+        lightCullDescriptors[1] = pointLightSsboInfo;
+        lightCullDescriptors[2] = lightTileSsboInfo;
+        lightCullDescriptors[3] = depthMultiMipMaxDescriptorInfo;
+
+        lightCullProgram->updateDescriptorSet(lightCullDescriptorSets[i], lightCullDescriptors);
+
+        // only bound when the instrumented cull has written rectangles to bin
+        if (cullInstrumentationActive)
+        {
+            mc::DescriptorSetData aabbBinDescriptors;
+            aabbBinDescriptors[0] = uboInfo;
+            aabbBinDescriptors[1] = sphereProjectionDebugSsboInfo;
+            aabbBinDescriptors[2] = aabbTileSsboInfo;
+
+            aabbBinProgram->updateDescriptorSet(aabbBinDescriptorSets[i], aabbBinDescriptors);
+        }
+
+        mc::DescriptorSetData geometryDescriptors;
+        geometryDescriptors[0] = uboInfo;
+        geometryDescriptors[2] = ssboInfo;
+        geometryDescriptors[4] = indirectSsboInfo;
+        geometryDescriptors[5] = bucketInstanceSsboInfo;
+        geometryDescriptors[6] = cullStatsSsboInfo;
+        geometryDescriptors[7] = lodConfigSsboInfo;
+        geometryDescriptors[8] = clusterDrawSsboInfo;
+
+        // textures and materials come from the bindless table in set 1
+        geometryProgram->updateDescriptorSet(descriptorSets[i], geometryDescriptors);
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> vertexBufferInfo{
+            vertexBuffer,
+            0,
+            dragon_model.getVertices().size() * sizeof(Vertex) };
+
+        mc::DescriptorInfo<VkDescriptorBufferInfo> indexBufferInfo{
+            indexBuffer,
+            0,
+            dragon_model.getIndexDataSize() };
+
+        mc::DescriptorSetData lightingDescriptors;
+        lightingDescriptors[0] = uboInfo;
+        lightingDescriptors[1] = colorDescriptorInfo;
+        lightingDescriptors[2] = normalDescriptorInfo;
+        lightingDescriptors[4] = depthDescriptorInfo;
+        lightingDescriptors[5] = shadowImageInfo;
+        lightingDescriptors[6] = PCFShadowImageInfo;
+        lightingDescriptors[7] = depthMultiMipDescriptorInfo;
+        lightingDescriptors[8] = sphereProjectionDebugSsboInfo;
+        lightingDescriptors[9] = ssboInfo;
+        lightingDescriptors[10] = vertexBufferInfo;
+        lightingDescriptors[11] = indexBufferInfo;
+        lightingDescriptors[12] = lodConfigSsboInfo;
+        lightingDescriptors[13] = pointLightSsboInfo;
+        lightingDescriptors[14] = lightTileSsboInfo;
+        lightingDescriptors[15] = aabbTileSsboInfo;
+
+        // the G-buffer lighting reads normals and the debug views, the visibility buffer resolve
+        // the transforms and mesh it rebuilds each pixel from. Each shader's template
+        // only picks out its own bindings
+        lightingProgram->updateDescriptorSet(lightingDescriptorSets[i], lightingDescriptors);
+
+        mc::DescriptorSetData shadowDescriptors;
+        shadowDescriptors[0] = shadowBufferInfo;
+        shadowDescriptors[1] = ssboInfo;
+        shadowDescriptors[2] = shadowIndirectSsboInfo;
+
+        shadowProgram->updateDescriptorSet(shadowDescriptorSets[i], shadowDescriptors);
+
+        mc::DescriptorSetData pointSplatDescriptors;
+        pointSplatDescriptors[0] = uboInfo;
+        pointSplatDescriptors[1] = ssboInfo;
+        pointSplatDescriptors[2] = pointSplatSsboInfo;
+        pointSplatDescriptors[3] = scaleSsboInfo;
+
+        pointSplatProgram->updateDescriptorSet(pointSplatDescriptorSets[i], pointSplatDescriptors);
+
+        mc::DescriptorSetData impostorDescriptors;
+        impostorDescriptors[0] = uboInfo;
+        impostorDescriptors[1] = ssboInfo;
+        impostorDescriptors[2] = impostorSsboInfo;
+        impostorDescriptors[3] = impostorAlbedoInfo;
+        impostorDescriptors[4] = impostorNormalDepthInfo;
+
+        impostorProgram->updateDescriptorSet(impostorDescriptorSets[i], impostorDescriptors);
     }
 }
 
-void VulkanObject::createComputePipeline()
+// runs each job on its own thread and waits for all of them. Pipelines and shader modules can
+// be created from any thread against the one device and pipeline cache, the jobs only write
+// the members they build. The first failure is rethrown once every job has finished
+static void runInParallel(std::initializer_list<std::function<void()>> jobs)
 {
+    std::vector<std::future<void>> futures;
+    futures.reserve(jobs.size());
+    for (const auto& job : jobs)
     {
-        auto lodIndirectShaderModule = std::make_shared<mc::Shader>(
-            device,
-            "../shaders/vulkan3/lod_indirect.spv",
-            VK_SHADER_STAGE_COMPUTE_BIT);
-        computeProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ lodIndirectShaderModule }, sizeof(vk::Bool32));
+        futures.push_back(std::async(std::launch::async, job));
+    }
 
-        VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        info.stage.module = lodIndirectShaderModule->get();
-        info.stage.pName = "main";
-        info.layout = computeProgram->getLayout();
-        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &computePipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create compute pipeline!");
+    std::exception_ptr firstError;
+    for (auto& future : futures)
+    {
+        try
+        {
+            future.get();
+        }
+        catch (...)
+        {
+            if (!firstError)
+            {
+                firstError = std::current_exception();
+            }
         }
     }
-
+    if (firstError)
     {
-        auto depthPyramidShaderModule = std::make_shared<mc::Shader>(
-            device,
-            "../shaders/vulkan3/depth_pyramid_generate.spv",
-            VK_SHADER_STAGE_COMPUTE_BIT);
-        depthPyramidComputeProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ depthPyramidShaderModule }, sizeof(glm::vec2));
+        std::rethrow_exception(firstError);
+    }
+}
 
-        VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-        info.stage.module = depthPyramidShaderModule->get();
-        info.stage.pName = "main";
-        info.layout = depthPyramidComputeProgram->getLayout();
-        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &depthPyramidComputePipeline) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create compute pipeline!");
-        }
+void VulkanObject::createPipelines()
+{
+    const auto start = std::chrono::steady_clock::now();
+    // the two only share the device and the render passes, which already exist
+    runInParallel({
+        [this] { createComputePipeline(); },
+        [this] { createGraphicsPipeline(); },
+    });
+    pipelineCreationTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void VulkanObject::createComputePipeline()
+{
+    // each program and pipeline is independent of the others
+    runInParallel({
+        [this] { createCullProgram(); },
+
+        [this] {
+            auto depthPyramidShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/depth_pyramid_generate.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            // one dispatch per mip, each with its own pair of images pushed in the command buffer
+            depthPyramidComputeProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ depthPyramidShaderModule }, sizeof(glm::vec2), true);
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = depthPyramidShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = depthPyramidComputeProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &depthPyramidComputePipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+
+        [this] {
+            auto depthReprojectShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/depth_reproject.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            // one dispatch per mip like the pyramid build, images and UBO pushed in the command buffer
+            depthReprojectProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ depthReprojectShaderModule }, 0, true);
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = depthReprojectShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = depthReprojectProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &depthReprojectPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+
+        [this] {
+            auto clusterCutShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/cluster_cut.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            // runs after both camera culls over the same buffers, so they are pushed
+            clusterCutProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ clusterCutShaderModule }, 0, true);
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = clusterCutShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = clusterCutProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &clusterCutPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+
+        [this] {
+            auto drawSortShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/draw_sort.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            drawSortProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ drawSortShaderModule });
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = drawSortShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = drawSortProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &drawSortPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+
+        [this] {
+            auto lightCullShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/light_cull.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            lightCullProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ lightCullShaderModule });
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = lightCullShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = lightCullProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &lightCullPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+
+        [this] {
+            auto aabbBinShaderModule = std::make_shared<mc::Shader>(
+                device,
+                "../shaders/vulkan3/aabb_bin.spv",
+                VK_SHADER_STAGE_COMPUTE_BIT);
+            aabbBinProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ aabbBinShaderModule });
+
+            VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+            info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            info.stage.module = aabbBinShaderModule->get();
+            info.stage.pName = "main";
+            info.layout = aabbBinProgram->getLayout();
+            if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &aabbBinPipeline) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create compute pipeline!");
+            }
+        },
+    });
+}
+
+// plain or instrumented, the two builds have different layouts
+void VulkanObject::createCullProgram()
+{
+    auto lodIndirectShaderModule = std::make_shared<mc::Shader>(
+        device,
+        cullInstrumentationActive ? "../shaders/vulkan3/lod_indirect_instrumented.spv" : "../shaders/vulkan3/lod_indirect.spv",
+        VK_SHADER_STAGE_COMPUTE_BIT);
+    // the cull pipelines themselves are specialised per display mode, see createDisplayModePipelines
+    computeProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{ lodIndirectShaderModule }, sizeof(uint32_t));
+}
+
+// the visibility buffer resolve has no debug views to outline bounds in, the G-buffer
+// lighting only has them in its instrumented build
+const char* VulkanObject::lightingFragShaderPath() const
+{
+    if (visibilityBufferActive)
+    {
+        return "../shaders/vulkan3/visibility_resolve_frag.spv";
     }
+    return cullInstrumentationActive ? "../shaders/vulkan3/lighting_pass_instrumented_frag.spv" : "../shaders/vulkan3/lighting_pass_frag.spv";
 }
 
 // create the graphics pipeline.
 void VulkanObject::createGraphicsPipeline() {
     // create shader module per shader
     auto geometryVertShaderModule = std::make_shared< mc::Shader>(device, "../shaders/vulkan3/geometry_pass_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-    auto geometryFragShaderModule = std::make_shared< mc::Shader>(device, "../shaders/vulkan3/geometry_pass_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    geometryProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{geometryVertShaderModule, geometryFragShaderModule});
+    // the visibility pass writes ids in to a single attachment instead of albedo and normals
+    auto geometryFragShaderModule = std::make_shared< mc::Shader>(device,
+        visibilityBufferActive ? "../shaders/vulkan3/visibility_pass_frag.spv" : "../shaders/vulkan3/geometry_pass_frag.spv",
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+    geometryProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{geometryVertShaderModule, geometryFragShaderModule}, sizeof(uint32_t), false, bindlessTable->getSetLayout());
 
     // create a shader stage info struct for the vertex shader
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -2573,7 +3724,7 @@ void VulkanObject::createGraphicsPipeline() {
     // bitwise operation specified here
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
     // number of attachments
-    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.attachmentCount = visibilityBufferActive ? 1 : static_cast<uint32_t>(colorBlendAttachments.size());
     // set as previously defined attachment
     colorBlending.pAttachments = colorBlendAttachments.data();
     // blend constants
@@ -2625,72 +3776,18 @@ void VulkanObject::createGraphicsPipeline() {
 
     pipelineInfo.pDepthStencilState = &depthStencil;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    }
+    // the geometry and lighting pipelines read display_mode and are specialised on it, they are
+    // built lazily by createDisplayModePipelines. Only their programs are made here, the
+    // descriptor sets are allocated from the program layouts
 
-    pipelineInfo.renderPass = lateGeometryPass;
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &lateGraphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    }
-
-	///////////////////////////////////////////////////// geometry
-
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = nullptr;
-    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-
-    // we will be culling the back faces
-    rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-    // we consider vertex order to be clockwise and front facing
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-    // number of attachments
-    colorBlending.attachmentCount = 1;
-    // set as previously defined attachment
-    colorBlending.pAttachments = &colorBlendAttachments[0];
+	///////////////////////////////////////////////////// lighting
 
     // create shader module per shader
     auto lightingVertShaderModule = std::make_shared< mc::Shader>(device, "../shaders/vulkan3/lighting_pass_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-    auto lightingFragShaderModule = std::make_shared< mc::Shader>(device, "../shaders/vulkan3/lighting_pass_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    lightingProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{lightingVertShaderModule, lightingFragShaderModule});
-
-    // add the shader code
-    vertShaderStageInfo.module = lightingVertShaderModule->get();
-    // add the shader code
-    fragShaderStageInfo.module = lightingFragShaderModule->get();
-
-    shaderStages[0] = vertShaderStageInfo;
-	shaderStages[1] = fragShaderStageInfo;
-
-    pipelineInfo.pStages = shaderStages;
-    // assign layout (for passing uniforms)
-    pipelineInfo.layout = lightingProgram->getLayout();
-    // assign renderpass
-    pipelineInfo.renderPass = earlyGeometryPass;
-    // number of subpasses
-    pipelineInfo.subpass = 1;
-    // we wont fail, so NULL
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    depthStencil.depthTestEnable = VK_FALSE;
-    depthStencil.depthWriteEnable = VK_FALSE;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencil.depthBoundsTestEnable = VK_FALSE;
-    depthStencil.minDepthBounds = 0.0f;
-    depthStencil.maxDepthBounds = 1.0f;
-    depthStencil.stencilTestEnable = VK_FALSE;
-    depthStencil.front = {};
-    depthStencil.back = {};
-
-    pipelineInfo.pDepthStencilState = &depthStencil;
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &lightingPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    }
+    // the visibility buffer resolve fetches and shades each pixel's triangle in the same subpass
+    auto lightingFragShaderModule = std::make_shared< mc::Shader>(device, lightingFragShaderPath(), VK_SHADER_STAGE_FRAGMENT_BIT);
+    // the visibility buffer resolve samples the albedo through the bindless table
+    lightingProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{lightingVertShaderModule, lightingFragShaderModule}, 0, false, bindlessTable->getSetLayout());
 
     ///////////////////////////////////////////////////////// shadow
 
@@ -2748,9 +3845,265 @@ void VulkanObject::createGraphicsPipeline() {
 
     pipelineInfo.pDepthStencilState = &depthStencil;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &shadowPipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &shadowPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    ///////////////////////////////////////////////////////// point splats
+
+    // splats are generated from the mesh ids in the point splat buffer, no vertex data
+    vertexInputInfo.vertexBindingDescriptionCount = 0;
+    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+
+    // one point per instance
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+    // writes the same albedo and normal attachments as the late geometry pipeline
+    colorBlending.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
+
+    auto pointSplatVertShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/point_splat_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    auto pointSplatFragShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/point_splat_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+    pointSplatProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{pointSplatVertShaderModule, pointSplatFragShaderModule});
+
+    vertShaderStageInfo.module = pointSplatVertShaderModule->get();
+    fragShaderStageInfo.module = pointSplatFragShaderModule->get();
+
+    shaderStages[0] = vertShaderStageInfo;
+    shaderStages[1] = fragShaderStageInfo;
+
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.layout = pointSplatProgram->getLayout();
+    // drawn in the late pass, after the meshes the late cull kept
+    pipelineInfo.renderPass = lateGeometryPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    // the programs are still needed for the descriptor sets, but the pipelines write albedo and
+    // normals which do not exist in visibility buffer mode
+    pointSplatPipeline = VK_NULL_HANDLE;
+    if (!visibilityBufferActive && vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &pointSplatPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    ///////////////////////////////////////////////////////// impostors
+
+    // one camera facing quad per instance, built from gl_VertexIndex
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+    auto impostorVertShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/impostor_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    auto impostorFragShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/impostor_frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+    impostorProgram = std::make_shared<mc::ShaderProgram>(device, mc::Shaders{impostorVertShaderModule, impostorFragShaderModule});
+
+    vertShaderStageInfo.module = impostorVertShaderModule->get();
+    fragShaderStageInfo.module = impostorFragShaderModule->get();
+
+    shaderStages[0] = vertShaderStageInfo;
+    shaderStages[1] = fragShaderStageInfo;
+
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.layout = impostorProgram->getLayout();
+    pipelineInfo.renderPass = earlyGeometryPass;
+    pipelineInfo.subpass = 0;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    impostorPipeline = VK_NULL_HANDLE;
+    if (!visibilityBufferActive && vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &impostorPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    pipelineInfo.renderPass = lateGeometryPass;
+
+    lateImpostorPipeline = VK_NULL_HANDLE;
+    if (!visibilityBufferActive && vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &lateImpostorPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+}
+
+// builds the cull, geometry and lighting pipelines with display_mode baked in as a
+// specialization constant, so the driver strips the debug views the mode does not show
+VulkanObject::DisplayModePipelines VulkanObject::createDisplayModePipelines(int displayMode)
+{
+    struct DisplayModeSpecialization {
+        int32_t displayMode;
+        VkBool32 debugMeshColours;
+        VkBool32 index16;
+    };
+    // the per mesh colours only make sense when there are a handful of meshes. The visibility
+    // resolve reads the index buffer itself, so it is told which width the model was packed to
+    const DisplayModeSpecialization specializationData{
+        displayMode,
+        modelTransforms->modelMatricies.size() < 6,
+        dragon_model.getIndexType() == VK_INDEX_TYPE_UINT16 };
+    const std::array<VkSpecializationMapEntry, 3> specializationEntries = {{
+        { 0, offsetof(DisplayModeSpecialization, displayMode), sizeof(int32_t) },
+        { 1, offsetof(DisplayModeSpecialization, debugMeshColours), sizeof(VkBool32) },
+        { 2, offsetof(DisplayModeSpecialization, index16), sizeof(VkBool32) },
+    }};
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(DisplayModeSpecialization);
+    specializationInfo.pData = &specializationData;
+
+    DisplayModePipelines pipelines;
+
+    // the cull is built on a worker while this thread builds the geometry and lighting
+    std::future<void> cull = std::async(std::launch::async, [&] {
+        auto lodIndirectShaderModule = std::make_shared<mc::Shader>(device,
+            cullInstrumentationActive ? "../shaders/vulkan3/lod_indirect_instrumented.spv" : "../shaders/vulkan3/lod_indirect.spv",
+            VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = lodIndirectShaderModule->get();
+        info.stage.pName = "main";
+        info.stage.pSpecializationInfo = &specializationInfo;
+        info.layout = computeProgram->getLayout();
+        if (vkCreateComputePipelines(device, pipelineCache->get(), 1, &info, nullptr, &pipelines.cull) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+    });
+
+    // same fixed function state as createGraphicsPipeline sets up for the geometry pass
+    auto geometryVertShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/geometry_pass_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    auto geometryFragShaderModule = std::make_shared<mc::Shader>(device,
+        visibilityBufferActive ? "../shaders/vulkan3/visibility_pass_frag.spv" : "../shaders/vulkan3/geometry_pass_frag.spv",
+        VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = geometryVertShaderModule->get();
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = &specializationInfo;
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = geometryFragShaderModule->get();
+    shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    VkViewport viewport{ 0.0f, 0.0f, (float)swapChainExtent.width, (float)swapChainExtent.height, 0.0f, 1.0f };
+    VkRect2D scissor{ { 0, 0 }, swapChainExtent };
+
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments{};
+    colorBlendAttachments[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachments[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    // the visibility pass has the one id attachment
+    colorBlending.attachmentCount = visibilityBufferActive ? 1 : static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlending.pAttachments = colorBlendAttachments.data();
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.maxDepthBounds = 1.0f;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.layout = geometryProgram->getLayout();
+    pipelineInfo.renderPass = earlyGeometryPass;
+    pipelineInfo.subpass = 0;
+
+    if (vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &pipelines.earlyGeometry) != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
+
+    pipelineInfo.renderPass = lateGeometryPass;
+
+    if (vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &pipelines.lateGeometry) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    // full screen triangle in the second subpass, no vertex data or depth test
+    auto lightingVertShaderModule = std::make_shared<mc::Shader>(device, "../shaders/vulkan3/lighting_pass_vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+    auto lightingFragShaderModule = std::make_shared<mc::Shader>(device, lightingFragShaderPath(), VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    shaderStages[0].module = lightingVertShaderModule->get();
+    shaderStages[1].module = lightingFragShaderModule->get();
+
+    vertexInputInfo.vertexBindingDescriptionCount = 0;
+    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+    vertexInputInfo.pVertexBindingDescriptions = nullptr;
+    vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+
+    rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+    colorBlending.attachmentCount = 1;
+    depthStencil.depthTestEnable = VK_FALSE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+
+    pipelineInfo.layout = lightingProgram->getLayout();
+    pipelineInfo.renderPass = earlyGeometryPass;
+    pipelineInfo.subpass = 1;
+
+    if (vkCreateGraphicsPipelines(device, pipelineCache->get(), 1, &pipelineInfo, nullptr, &pipelines.lighting) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+
+    cull.get();
+    return pipelines;
+}
+
+const VulkanObject::DisplayModePipelines& VulkanObject::getDisplayModePipelines(int displayMode)
+{
+    auto it = displayModePipelines.find(displayMode);
+    if (it == displayModePipelines.end())
+    {
+        const auto start = std::chrono::steady_clock::now();
+        it = displayModePipelines.emplace(displayMode, createDisplayModePipelines(displayMode)).first;
+        pipelineCreationTimeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return it->second;
 }
 
 // function to create all of our framebuffers
@@ -2761,7 +4114,7 @@ void VulkanObject::createFramebuffers() {
     // for each image view
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
         std::array<VkImageView, 4> attachments = {
-            offScreenPass.albedo.view,
+            visibilityBufferActive ? offScreenPass.visibility.view : offScreenPass.albedo.view,
         	offScreenPass.normal.view,
             swapChainImageViews[i],
             offScreenPass.depth.view,
@@ -2865,14 +4218,41 @@ void VulkanObject::createCommandBuffers() {
     }
 
     transitionImageLayout(depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    transitionImageLayout(meshesDrawnDebugViewImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-    meshesDrawnDebugViewImageViewImGUITexID = ImGui_ImplVulkan_AddTexture(meshesDrawnDebugViewSampler,
-        meshesDrawnDebugViewImageView,
-        VK_IMAGE_LAYOUT_GENERAL);
+    // the shadow pass loads the cached map, so it has to start out in the layout the pass leaves it in
+    transitionImageLayout(shadowPass.depth.image, findDepthFormat(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+    shadowCommandBuffers.resize(swapChainFramebuffers.size());
+    createCommandBuffers(shadowCommandBuffers.data(), static_cast<uint32_t>(shadowCommandBuffers.size()), shadowCommandPool);
+    shadowRenderedForImage.assign(swapChainFramebuffers.size(), false);
+    meshesDrawnDebugViewImageViewImGUITexID = cullInstrumentationActive
+        ? ImGui_ImplVulkan_AddTexture(meshesDrawnDebugViewSampler, meshesDrawnDebugViewImageView, VK_IMAGE_LAYOUT_GENERAL)
+        : VK_NULL_HANDLE;
+
+    recordCommandBuffers();
+}
+
+// records the per image frame. Split from createCommandBuffers so a display mode switch can
+// re-record with other pipeline variants without rebuilding the swap chain
+void VulkanObject::recordCommandBuffers() {
+    const DisplayModePipelines& pipelines = getDisplayModePipelines(displayModeActive);
 
     VkBuffer vertexBuffers[] = { vertexBuffer };
     VkDeviceSize offsets[] = { 0 };
 
+    // LOD buckets as they are before a cull pass adds instances to them. Each LOD's instance
+    // ids start at lod * chickenCount
+    std::vector<VkDrawIndexedIndirectCommand> emptyLodBuckets;
+    for (auto const& lodConfig : dragon_model.getLodConfigData())
+    {
+        emptyLodBuckets.push_back({
+            lodConfig.size,
+            0,
+            lodConfig.offset,
+            lodConfig.vertexOffset,
+            static_cast<uint32_t>(emptyLodBuckets.size() * modelTransforms->modelMatricies.size()) });
+    }
+    const VkDeviceSize lodBucketsSize = emptyLodBuckets.size() * sizeof(VkDrawIndexedIndirectCommand);
+
     // for each command buffer generated
     for (size_t i = 0; i < commandBuffers.size(); i++) {
         uint32_t queryPoolIndex = 0;
@@ -2909,6 +4289,83 @@ void VulkanObject::createCommandBuffers() {
             pfnCmdEndDebugUtilsLabelEXT(commandBuffers[i]);
         };
 
+        // bins the draws the last cull emitted by view depth so they rasterize front to back.
+        // Always recorded, draw_sort.glsl returns straight away when depth_sort is off
+        auto recordDrawSort = [&](std::string_view labelName, std::pair<uint32_t, uint32_t>& queryIndices)
+        {
+            std::array<float, 4> labelCol = { 1.0f, 0.6f, 0.2f, 1.0f };
+            beginLableRegion(labelName, labelCol);
+
+            queryIndices.first = queryPoolIndex;
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
+
+            VkMemoryBarrier cullOutputBarrier{};
+            cullOutputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullOutputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullOutputBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &cullOutputBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, drawSortPipeline);
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, drawSortProgram->getLayout(), 0, 1,
+                &drawSortDescriptorSets[i], 0, nullptr);
+
+            // one workgroup for the command list and one per LOD bucket
+            vkCmdDispatch(commandBuffers[i], 1 + static_cast<uint32_t>(emptyLodBuckets.size()), 1, 1);
+
+            queryIndices.second = queryPoolIndex;
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
+
+            endLableRegion();
+        };
+
+        // cluster_cut.glsl over the instances the cull before it sent down the cluster path, as
+        // many workgroup rows as the cull counted in to the cluster draw header
+        auto recordClusterCut = [&](std::string_view labelName)
+        {
+            std::array<float, 4> labelCol = { 0.6f, 1.0f, 0.4f, 1.0f };
+            beginLableRegion(labelName, labelCol);
+
+            VkMemoryBarrier cullOutputBarrier{};
+            cullOutputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            cullOutputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            cullOutputBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &cullOutputBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, clusterCutPipeline);
+            clusterCutProgram->pushDescriptors(commandBuffers[i], clusterCutDescriptors[i]);
+            vkCmdDispatchIndirect(commandBuffers[i], clusterDrawSSBO[i], clusterCutDispatchOffset);
+
+            endLableRegion();
+        };
+
+        // no cluster draws or instances yet, and a cluster_cut.glsl dispatch as wide as the
+        // hierarchy with no rows until the cull adds instances
+        const std::array<uint32_t, 8> clusterDrawHeader = {
+            0, 0, 0, 0,
+            (static_cast<uint32_t>(dragon_model.getClusterData().size()) + clusterCutGroupSize - 1) / clusterCutGroupSize, 0, 1, 0 };
+
         // specify some info about the usage of this command buffer
         VkCommandBufferBeginInfo beginInfo{};
         // assign struct type
@@ -2923,14 +4380,24 @@ void VulkanObject::createCommandBuffers() {
 
         vkCmdResetQueryPool(commandBuffers[i], queryPools[i], 0, 50);
 
+        // empty impostor draws for both passes, the late pass's mesh ids start after the early's
+        const std::array<uint32_t, 8> impostorDrawHeaders = {
+            4, 0, 0, 0,
+            4, 0, 0, static_cast<uint32_t>(modelTransforms->modelMatricies.size()) };
+        vkCmdUpdateBuffer(commandBuffers[i], impostorSSBO[i], 0, sizeof(impostorDrawHeaders), impostorDrawHeaders.data());
+        vkCmdUpdateBuffer(commandBuffers[i], lodBucketSSBO[i], 0, lodBucketsSize, emptyLodBuckets.data());
+        vkCmdUpdateBuffer(commandBuffers[i], clusterDrawSSBO[i], 0, sizeof(clusterDrawHeader), clusterDrawHeader.data());
+        // counted in to by the late cull and both geometry passes
+        vkCmdFillBuffer(commandBuffers[i], cullStatsSSBO[i], 0, sizeof(CullStatsData), 0);
+
         std::array<VkMemoryBarrier, 1> initialDrawnLastFrameBuffer{};
         initialDrawnLastFrameBuffer[0].sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-        initialDrawnLastFrameBuffer[0].srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        initialDrawnLastFrameBuffer[0].srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
         initialDrawnLastFrameBuffer[0].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
 
         vkCmdPipelineBarrier(
             commandBuffers[i],
-            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
             VK_DEPENDENCY_BY_REGION_BIT,
             initialDrawnLastFrameBuffer.size(),
@@ -2948,10 +4415,93 @@ void VulkanObject::createCommandBuffers() {
             earlyCullQueryIndices.first = queryPoolIndex;
             vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+            // last frame's pyramid, still intact until this frame's build, scattered in to this
+            // frame's culling view. Cleared to 0 first, which the cull reads as the far plane.
+            // depth_reproject.glsl returns straight away when early reprojection is off
+            VkImageMemoryBarrier reprojectClearBarrier{};
+            reprojectClearBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            reprojectClearBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            reprojectClearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            reprojectClearBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            reprojectClearBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            reprojectClearBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            reprojectClearBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            reprojectClearBarrier.image = reprojectedPyramidImage;
+            reprojectClearBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            reprojectClearBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            reprojectClearBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &reprojectClearBarrier);
+
+            VkClearColorValue reprojectClearValue{};
+            vkCmdClearColorImage(commandBuffers[i], reprojectedPyramidImage, VK_IMAGE_LAYOUT_GENERAL, &reprojectClearValue, 1, &reprojectClearBarrier.subresourceRange);
+
+            reprojectClearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            reprojectClearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            reprojectClearBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &reprojectClearBarrier);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, depthReprojectPipeline);
+
+            mc::DescriptorInfo<VkDescriptorBufferInfo> reprojectUboInfo{
+                uniformBuffers[i],
+                0,
+                sizeof(UniformBufferObject) };
+
+            for (size_t reprojectLevel = 0; reprojectLevel < reprojectedPyramidViews.size(); ++reprojectLevel)
+            {
+                mc::DescriptorSetData reprojectDescriptors;
+                reprojectDescriptors[0] = mc::DescriptorInfo<VkDescriptorImageInfo>{ reprojectedPyramidViews[reprojectLevel], VK_IMAGE_LAYOUT_GENERAL };
+                reprojectDescriptors[1] = depthPyramidDescriptorInfo[reprojectLevel];
+                reprojectDescriptors[2] = reprojectUboInfo;
+                depthReprojectProgram->pushDescriptors(commandBuffers[i], reprojectDescriptors);
+
+                const uint32_t levelWidth = std::max(uint32_t{ 1 }, (swapChainExtent.width / 2) >> reprojectLevel);
+                const uint32_t levelHeight = std::max(uint32_t{ 1 }, (swapChainExtent.height / 2) >> reprojectLevel);
+                vkCmdDispatch(commandBuffers[i], (levelWidth + 31) / 32, (levelHeight + 31) / 32, 1);
+            }
+
+            // levels are independent, one barrier before the cull samples them
+            reprojectClearBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            reprojectClearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                0,
+                nullptr,
+                0,
+                nullptr,
+                1,
+                &reprojectClearBarrier);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cull);
             vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computeProgram->getLayout(), 0, 1,
                 &computeDescriptorSets[i], 0, nullptr);
-            vk::Bool32 cullStageConstant = true;
+            uint32_t cullStageConstant = cullStageEarly;
             vkCmdPushConstants(
                 commandBuffers[i],
                 computeProgram->getLayout(),
@@ -2971,55 +4521,13 @@ void VulkanObject::createCommandBuffers() {
         }
         // EARLY CULLING PASS COMPUTE SHADER END
 
-        /*VkRenderPassBeginInfo shadowRenderPassInfo{};
-        shadowRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-
-        shadowRenderPassInfo.renderPass = shadowPass.renderPass;
-        // assign the current framebuffer
-        shadowRenderPassInfo.framebuffer = shadowPass.frameBuffer;
-        // screen space offset
-        shadowRenderPassInfo.renderArea.offset = { 0, 0 };
-        // width and height of render
-        shadowRenderPassInfo.renderArea.extent = swapChainExtent;
-
-        std::array<VkClearValue, 1> shadowClearValues{};
-        shadowClearValues[0].depthStencil = { 1.0f, 0 };
-
-        // number of clear colour
-        shadowRenderPassInfo.clearValueCount = static_cast<uint32_t>(shadowClearValues.size());
-        // clear colour value
-        shadowRenderPassInfo.pClearValues = shadowClearValues.data();
-
-        vkCmdBeginRenderPass(commandBuffers[i], &shadowRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
-
-        vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-        vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shadowProgram->getLayout(), 0, 1, &shadowDescriptorSets[i], 0, nullptr);
-
-        vkCmdDrawIndexedIndirect(commandBuffers[i], indirectLodSSBO[i], 0, modelTransforms->modelMatricies.size(), 32);
-
-        vkCmdEndRenderPass(commandBuffers[i]);*/
-
-        std::array<VkImageMemoryBarrier, 1> renderPassOutputFormatConversions{};
-        renderPassOutputFormatConversions[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        renderPassOutputFormatConversions[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-        renderPassOutputFormatConversions[0].dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
-        renderPassOutputFormatConversions[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        renderPassOutputFormatConversions[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-        renderPassOutputFormatConversions[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        renderPassOutputFormatConversions[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        renderPassOutputFormatConversions[0].image = shadowPass.depth.image;
-        renderPassOutputFormatConversions[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-        renderPassOutputFormatConversions[0].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-        renderPassOutputFormatConversions[0].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        recordClusterCut("Early cluster cut");
+        recordDrawSort("Early draw sort", earlySortQueryIndices);
 
         std::array<VkMemoryBarrier, 1> renderPassMemoryOutputFormatConversions{};
         renderPassMemoryOutputFormatConversions[0].sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
         renderPassMemoryOutputFormatConversions[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-        renderPassMemoryOutputFormatConversions[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        renderPassMemoryOutputFormatConversions[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 
         vkCmdPipelineBarrier(
             commandBuffers[i],
@@ -3030,8 +4538,8 @@ void VulkanObject::createCommandBuffers() {
             renderPassMemoryOutputFormatConversions.data(),
             0,
             0,
-            renderPassOutputFormatConversions.size(),
-            renderPassOutputFormatConversions.data());
+            0,
+            0);
 
         // EARLY RENDER PASS BEGIN
         {
@@ -3046,6 +4554,12 @@ void VulkanObject::createCommandBuffers() {
 
             std::array<VkClearValue, 4> clearValues{};
             clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+            if (visibilityBufferActive)
+            {
+                // no instance or triangle, the resolve leaves these pixels black
+                clearValues[0].color.uint32[0] = 0xFFFFFFFF;
+                clearValues[0].color.uint32[1] = 0xFFFFFFFF;
+            }
             clearValues[1].color = { 0.0f, 0.0f, 0.0f, 1.0f };
             clearValues[2].color = { 0.0f, 0.0f, 0.0f, 1.0f };
             clearValues[3].depthStencil = { 1.0f, 0 };
@@ -3058,20 +4572,45 @@ void VulkanObject::createCommandBuffers() {
 
             vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.earlyGeometry);
 
             vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, dragon_model.getIndexType());
+
+            // set 1 is the bindless table
+            const std::array<VkDescriptorSet, 2> geometrySets = { descriptorSets[i], bindlessTable->getSet() };
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryProgram->getLayout(), 0, static_cast<uint32_t>(geometrySets.size()), geometrySets.data(), 0, nullptr);
 
-            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryProgram->getLayout(), 0, 1, &descriptorSets[i], 0, nullptr);
+            // every draw source is always recorded, the cull leaves the ones not in use empty
+            uint32_t drawSourceConstant = drawSourceCommands;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirectCount(commandBuffers[i], indirectLodSSBO[i], 0, indirectLodCountSSBO[i], 0, modelTransforms->modelMatricies.size(), indirectCommandStride);
 
-            vkCmdDrawIndexedIndirectCount(commandBuffers[i], indirectLodSSBO[i], 0, indirectLodCountSSBO[i], 0, modelTransforms->modelMatricies.size(), 32);
+            drawSourceConstant = drawSourceBuckets;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirect(commandBuffers[i], lodBucketSSBO[i], 0, static_cast<uint32_t>(emptyLodBuckets.size()), sizeof(VkDrawIndexedIndirectCommand));
+
+            // the cluster cuts of instances near enough to want LOD 0
+            drawSourceConstant = drawSourceClusters;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirectCount(commandBuffers[i], clusterDrawSSBO[i], clusterDrawHeaderSize, clusterDrawSSBO[i], 0, maxClusterDraws, indirectCommandStride);
+
+            // every impostor the early cull kept, as one instanced draw. Impostors have no
+            // triangle to resolve, so the visibility buffer mode has none
+            if (!visibilityBufferActive)
+            {
+                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, impostorPipeline);
+                vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, impostorProgram->getLayout(), 0, 1, &impostorDescriptorSets[i], 0, nullptr);
+                vkCmdDrawIndirect(commandBuffers[i], impostorSSBO[i], 0, 1, 0);
+            }
 
             vkCmdNextSubpass(commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lighting);
 
-            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingProgram->getLayout(), 0, 1, &lightingDescriptorSets[i], 0, nullptr);
+            // set 1 is the bindless table
+            const std::array<VkDescriptorSet, 2> lightingSets = { lightingDescriptorSets[i], bindlessTable->getSet() };
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingProgram->getLayout(), 0, static_cast<uint32_t>(lightingSets.size()), lightingSets.data(), 0, nullptr);
 
             vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
 
@@ -3130,76 +4669,19 @@ void VulkanObject::createCommandBuffers() {
             beginLableRegion("Depth pyramid construction", labelCol);
             vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidComputePipeline);
 
+            auto initialDepthDescInfo = mc::DescriptorInfo<VkDescriptorImageInfo>{
+                depthSampler,
+                offScreenPass.depth.view,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
             for (size_t depthPyramidLevel = 0; depthPyramidLevel < depthPyramidViews.size(); ++depthPyramidLevel)
             {
-                VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-
-                allocateInfo.descriptorPool = depthPyramidComputeDescriptorPool;
-                allocateInfo.descriptorSetCount = 1;
-                allocateInfo.pSetLayouts = &(depthPyramidComputeProgram->getSetLayout());
-
-                VkDescriptorSet set = 0;
-                if (vkAllocateDescriptorSets(device, &allocateInfo, &set) != VK_SUCCESS)
-                {
-                    std::cout << "could not allocate descriptor sets" << std::endl;
-                    throw std::runtime_error("could nto allocate descriptor sets");
-                }
+                // write this mip, reduced from the one above it or the depth buffer for mip 0
+                mc::DescriptorSetData depthPyramidDescriptors;
+                depthPyramidDescriptors[0] = depthPyramidDescriptorInfo[depthPyramidLevel];
+                depthPyramidDescriptors[1] = depthPyramidLevel == 0 ? initialDepthDescInfo : depthPyramidDescriptorInfo[depthPyramidLevel - 1];
+                depthPyramidComputeProgram->pushDescriptors(commandBuffers[i], depthPyramidDescriptors);
 
-                std::array<VkWriteDescriptorSet, 2> depthPyramidComputeDescriptorWrites{};
-
-                depthPyramidComputeDescriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                depthPyramidComputeDescriptorWrites[0].dstSet = set;
-                depthPyramidComputeDescriptorWrites[0].dstBinding = 0;
-                depthPyramidComputeDescriptorWrites[0].dstArrayElement = 0;
-                depthPyramidComputeDescriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                depthPyramidComputeDescriptorWrites[0].descriptorCount = 1;
-                depthPyramidComputeDescriptorWrites[0].pImageInfo = depthPyramidDescriptorInfo[depthPyramidLevel].getPtr();
-
-                depthPyramidComputeDescriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                depthPyramidComputeDescriptorWrites[1].dstSet = set;
-                depthPyramidComputeDescriptorWrites[1].dstBinding = 1;
-                depthPyramidComputeDescriptorWrites[1].dstArrayElement = 0;
-                depthPyramidComputeDescriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                depthPyramidComputeDescriptorWrites[1].descriptorCount = 1;
-                auto initialDepthDescInfo = mc::DescriptorInfo<VkDescriptorImageInfo>{
-                    depthSampler,
-                    offScreenPass.depth.view,
-                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
-                depthPyramidComputeDescriptorWrites[1].pImageInfo =
-                    depthPyramidLevel == 0 ? initialDepthDescInfo.getPtr() : depthPyramidDescriptorInfo[depthPyramidLevel - 1].getPtr();
-
-                //vkUpdateDescriptorSetWithTemplate(device, set, depthPyramidComputeProgram.updateTemplate, descriptors);
-
-                vkUpdateDescriptorSets(
-                    device,
-                    static_cast<uint32_t>(depthPyramidComputeDescriptorWrites.size()),
-                    depthPyramidComputeDescriptorWrites.data(),
-                    0,
-                    nullptr);
-
-                /*vkUpdateDescriptorSets(
-                    device,
-                    static_cast<uint32_t>(depthPyramidComputeDescriptorWrites.size()),
-                    depthPyramidComputeDescriptorWrites.data(),
-                    0,
-                    nullptr);*/
-                    /*vkCmdPushDescriptorSetKHR(
-                        commandBuffers[i],
-                        VK_PIPELINE_BIND_POINT_COMPUTE,
-                        depthPyramidComputeProgram->getLayout(),
-                        1,
-                        depthPyramidComputeDescriptorWrites.size(),
-                        depthPyramidComputeDescriptorWrites.data());*/
-                        // Bind descriptor set.
-                vkCmdBindDescriptorSets(
-                    commandBuffers[i],
-                    VK_PIPELINE_BIND_POINT_COMPUTE,
-                    depthPyramidComputeProgram->getLayout(),
-                    0,
-                    1,
-                    &set,
-                    0,
-                    nullptr);
                 glm::vec2 reduceData;
                 if (depthPyramidLevel == 0)
                 {
@@ -3262,6 +4744,7 @@ void VulkanObject::createCommandBuffers() {
         // DEPTH PYRAMID CONSTRUCTION END
 
         // CLEAR CULLING DEBUG VIEW BEGIN
+        if (cullInstrumentationActive)
         {
             std::array<float, 4> labelCol = { 1.0f, 1.0f, 0.6f, 1.0f };
             beginLableRegion("Debug image clear", labelCol);
@@ -3310,7 +4793,7 @@ void VulkanObject::createCommandBuffers() {
         finalPyramidBarriers[1].subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
         finalPyramidBarriers[1].subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
-        // Barrier between compute and vertex shading.
+        // Barrier between compute and vertex shading. The debug image one only when it exists
         vkCmdPipelineBarrier(
             commandBuffers[i],
             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -3320,9 +4803,88 @@ void VulkanObject::createCommandBuffers() {
             0,
             0,
             0,
-            finalPyramidBarriers.size(),
+            cullInstrumentationActive ? 2 : 1,
             finalPyramidBarriers.data());
 
+        // LIGHT BINNING COMPUTE SHADER BEGIN
+        {
+            std::array<float, 4> labelCol = { 1.0f, 0.9f, 0.4f, 1.0f };
+            beginLableRegion("Light binning", labelCol);
+
+            lightCullQueryIndices.first = queryPoolIndex;
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
+
+            // the early lighting subpass shades against the lists binned for this image's
+            // previous frame, the late one is the only pass to use this frame's
+            VkMemoryBarrier tileListReadBarrier{};
+            tileListReadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            tileListReadBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            tileListReadBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                1,
+                &tileListReadBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            const glm::uvec2 lightTileCount = getLightTileCount();
+            vkCmdFillBuffer(commandBuffers[i], lightTileSSBO[i], 0, lightTileCount.x * lightTileCount.y * sizeof(uint32_t), 0);
+
+            VkMemoryBarrier tileCountClearBarrier{};
+            tileCountClearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            tileCountClearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            tileCountClearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &tileCountClearBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCullPipeline);
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCullProgram->getLayout(), 0, 1,
+                &lightCullDescriptorSets[i], 0, nullptr);
+
+            // sized for the largest preset so the light count can change without re-recording,
+            // threads past ubo.point_light_count return straight away
+            vkCmdDispatch(commandBuffers[i], (maxPointLights + 63) / 64, 1, 1);
+
+            VkMemoryBarrier tileListWriteBarrier{};
+            tileListWriteBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            tileListWriteBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            tileListWriteBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0,
+                1,
+                &tileListWriteBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            lightCullQueryIndices.second = queryPoolIndex;
+            vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
+
+            endLableRegion();
+        }
+        // LIGHT BINNING COMPUTE SHADER END
+
         // LATE CULLING PASS COMPUTE SHADER BEGIN
         {
             std::array<float, 4> labelCol = { 1.0f, 0.2f, 0.2f, 1.0f };
@@ -3331,10 +4893,10 @@ void VulkanObject::createCommandBuffers() {
             lateCullQueryIndices.first = queryPoolIndex;
             vkCmdWriteTimestamp(commandBuffers[i], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[i], queryPoolIndex); ++queryPoolIndex;
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.cull);
             vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, computeProgram->getLayout(), 0, 1,
                 &computeDescriptorSets[i], 0, nullptr);
-            vk::Bool32 cullStageConstant = false;
+            uint32_t cullStageConstant = cullStageLate;
             vkCmdPushConstants(
                 commandBuffers[i],
                 computeProgram->getLayout(),
@@ -3345,6 +4907,29 @@ void VulkanObject::createCommandBuffers() {
 
             vkCmdFillBuffer(commandBuffers[i], indirectLodCountSSBO[i], 0, sizeof(uint32_t), 0);
 
+            // empty splat draw, one instance of zero vertices. The late cull appends to it
+            const std::array<uint32_t, 4> pointSplatDrawHeader = { 0, 1, 0, 0 };
+            vkCmdUpdateBuffer(commandBuffers[i], pointSplatSSBO[i], 0, sizeof(pointSplatDrawHeader), pointSplatDrawHeader.data());
+            vkCmdUpdateBuffer(commandBuffers[i], lodBucketSSBO[i], 0, lodBucketsSize, emptyLodBuckets.data());
+            vkCmdUpdateBuffer(commandBuffers[i], clusterDrawSSBO[i], 0, sizeof(clusterDrawHeader), clusterDrawHeader.data());
+
+            VkMemoryBarrier resetBarrier{};
+            resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &resetBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
             vkCmdDispatch(commandBuffers[i], modelTransforms->modelMatricies.size(), 1, 1);
 
             lateCullQueryIndices.second = queryPoolIndex;
@@ -3354,9 +4939,86 @@ void VulkanObject::createCommandBuffers() {
         }
         // LATE CULLING PASS COMPUTE SHADER END
 
+        recordClusterCut("Late cluster cut");
+
+        // SSAABB BINNING COMPUTE SHADER BEGIN
+        // only for the overlay modes, which re-record the command buffers when chosen
+        if (cullInstrumentationActive && displayModeActive >= 20 && displayModeActive < 23)
+        {
+            std::array<float, 4> labelCol = { 0.4f, 0.9f, 1.0f, 1.0f };
+            beginLableRegion("SSAABB binning", labelCol);
+
+            // the early lighting subpass outlines this image's previous frame's rectangles
+            VkMemoryBarrier aabbTileReadBarrier{};
+            aabbTileReadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            aabbTileReadBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            aabbTileReadBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0,
+                1,
+                &aabbTileReadBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            const glm::uvec2 aabbTileCount = getLightTileCount();
+            vkCmdFillBuffer(commandBuffers[i], aabbTileSSBO[i], 0, aabbTileCount.x * aabbTileCount.y * sizeof(uint32_t), 0);
+
+            // the tile counts are cleared and the late cull has written the rectangles
+            VkMemoryBarrier aabbBinInputBarrier{};
+            aabbBinInputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            aabbBinInputBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            aabbBinInputBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1,
+                &aabbBinInputBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, aabbBinPipeline);
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, aabbBinProgram->getLayout(), 0, 1,
+                &aabbBinDescriptorSets[i], 0, nullptr);
+
+            vkCmdDispatch(commandBuffers[i], static_cast<uint32_t>((modelTransforms->modelMatricies.size() + 63) / 64), 1, 1);
+
+            VkMemoryBarrier aabbTileWriteBarrier{};
+            aabbTileWriteBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            aabbTileWriteBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            aabbTileWriteBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(
+                commandBuffers[i],
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0,
+                1,
+                &aabbTileWriteBarrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+
+            endLableRegion();
+        }
+        // SSAABB BINNING COMPUTE SHADER END
+
+        recordDrawSort("Late draw sort", lateSortQueryIndices);
+
         std::array<VkImageMemoryBarrier, 3> lateRenderPassImageBarriers{};
         size_t lateRenderPassImageIdx = 0;
-        for (const auto& image : {offScreenPass.albedo.image,
+        for (const auto& image : {visibilityBufferActive ? offScreenPass.visibility.image : offScreenPass.albedo.image,
                                               offScreenPass.normal.image,
                                               offScreenPass.depth.image})
         {
@@ -3380,13 +5042,14 @@ void VulkanObject::createCommandBuffers() {
         std::array<VkMemoryBarrier, 1> lateRenderPassMemoryBarriers{};
         lateRenderPassMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
         lateRenderPassMemoryBarriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-        lateRenderPassMemoryBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        // the point splat vertex shader also reads the mesh ids the late cull appended
+        lateRenderPassMemoryBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 
         // Barrier between compute and vertex shading.
         vkCmdPipelineBarrier(
             commandBuffers[i],
             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
             VK_DEPENDENCY_BY_REGION_BIT,
             lateRenderPassMemoryBarriers.size(),
             lateRenderPassMemoryBarriers.data(),
@@ -3421,20 +5084,49 @@ void VulkanObject::createCommandBuffers() {
 
             vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lateGraphicsPipeline);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lateGeometry);
 
             vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, dragon_model.getIndexType());
+
+            // set 1 is the bindless table
+            const std::array<VkDescriptorSet, 2> geometrySets = { descriptorSets[i], bindlessTable->getSet() };
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryProgram->getLayout(), 0, static_cast<uint32_t>(geometrySets.size()), geometrySets.data(), 0, nullptr);
+
+            // every draw source is always recorded, the cull leaves the ones not in use empty
+            uint32_t drawSourceConstant = drawSourceCommands;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirectCount(commandBuffers[i], indirectLodSSBO[i], 0, indirectLodCountSSBO[i], 0, modelTransforms->modelMatricies.size(), indirectCommandStride);
+
+            drawSourceConstant = drawSourceBuckets;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirect(commandBuffers[i], lodBucketSSBO[i], 0, static_cast<uint32_t>(emptyLodBuckets.size()), sizeof(VkDrawIndexedIndirectCommand));
 
-            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, geometryProgram->getLayout(), 0, 1, &descriptorSets[i], 0, nullptr);
+            // the cluster cuts of instances near enough to want LOD 0
+            drawSourceConstant = drawSourceClusters;
+            vkCmdPushConstants(commandBuffers[i], geometryProgram->getLayout(), geometryProgram->getPushConstantStages(), 0, sizeof(drawSourceConstant), &drawSourceConstant);
+            vkCmdDrawIndexedIndirectCount(commandBuffers[i], clusterDrawSSBO[i], clusterDrawHeaderSize, clusterDrawSSBO[i], 0, maxClusterDraws, indirectCommandStride);
 
-            vkCmdDrawIndexedIndirectCount(commandBuffers[i], indirectLodSSBO[i], 0, indirectLodCountSSBO[i], 0, modelTransforms->modelMatricies.size(), 32);
+            // meshes below the contribution threshold. The vertex count is zero unless the late
+            // cull is in point splat mode, which the visibility buffer mode never uses
+            if (!visibilityBufferActive)
+            {
+                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pointSplatPipeline);
+                vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pointSplatProgram->getLayout(), 0, 1, &pointSplatDescriptorSets[i], 0, nullptr);
+                vkCmdDrawIndirect(commandBuffers[i], pointSplatSSBO[i], 0, 1, 0);
+
+                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lateImpostorPipeline);
+                vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, impostorProgram->getLayout(), 0, 1, &impostorDescriptorSets[i], 0, nullptr);
+                vkCmdDrawIndirect(commandBuffers[i], impostorSSBO[i], 4 * sizeof(uint32_t), 1, 0);
+            }
 
             vkCmdNextSubpass(commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
 
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.lighting);
 
-            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingProgram->getLayout(), 0, 1, &lightingDescriptorSets[i], 0, nullptr);
+            // set 1 is the bindless table
+            const std::array<VkDescriptorSet, 2> lightingSets = { lightingDescriptorSets[i], bindlessTable->getSet() };
+            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, lightingProgram->getLayout(), 0, static_cast<uint32_t>(lightingSets.size()), lightingSets.data(), 0, nullptr);
 
             vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
 
@@ -3468,6 +5160,212 @@ void VulkanObject::createCommandBuffers() {
     }
 }
 
+void VulkanObject::recordShadowCommandBuffer(uint32_t imageIndex, uint64_t dirtyTiles)
+{
+    VkCommandBuffer commandBuffer = shadowCommandBuffers[imageIndex];
+
+    auto beginLableRegion = [&](std::string_view labelName, std::span<float, 4> color)
+    {
+        PFN_vkCmdBeginDebugUtilsLabelEXT pfnCmdBeginDebugUtilsLabelEXT = (PFN_vkCmdBeginDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+
+        if (!pfnCmdBeginDebugUtilsLabelEXT)
+        {
+            return;
+        }
+
+        VkDebugUtilsLabelEXT label{};
+        label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+        label.pNext = nullptr;
+        label.pLabelName = labelName.data();
+        label.color[0] = color[0];
+        label.color[1] = color[1];
+        label.color[2] = color[2];
+        label.color[3] = color[3];
+        pfnCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+    };
+
+    auto endLableRegion = [&]()
+    {
+        PFN_vkCmdEndDebugUtilsLabelEXT pfnCmdEndDebugUtilsLabelEXT = (PFN_vkCmdEndDebugUtilsLabelEXT)vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+
+        if (!pfnCmdEndDebugUtilsLabelEXT)
+        {
+            return;
+        }
+
+        pfnCmdEndDebugUtilsLabelEXT(commandBuffer);
+    };
+
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording shadow command buffer!");
+    }
+
+    // the main command buffer resets the first 50 queries, the shadow pass owns the two after
+    shadowQueryIndices = { 50, 51 };
+    vkCmdResetQueryPool(commandBuffer, queryPools[imageIndex], shadowQueryIndices.first, 2);
+
+    VkBuffer vertexBuffers[] = { vertexBuffer };
+    VkDeviceSize offsets[] = { 0 };
+
+    // SHADOW PASS BEGIN
+    {
+        std::array<float, 4> labelCol = { 0.2f, 1.0f, 1.0f, 1.0f };
+        beginLableRegion("Shadow cull compute", labelCol);
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPools[imageIndex], shadowQueryIndices.first);
+
+        // cull against the light frustum in to the shadow draw list
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, getDisplayModePipelines(displayModeActive).cull);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computeProgram->getLayout(), 0, 1,
+            &shadowComputeDescriptorSets[imageIndex], 0, nullptr);
+        uint32_t cullStageConstant = cullStageShadow;
+        vkCmdPushConstants(
+            commandBuffer,
+            computeProgram->getLayout(),
+            computeProgram->getPushConstantStages(),
+            0,
+            sizeof(cullStageConstant),
+            &cullStageConstant);
+
+        vkCmdFillBuffer(commandBuffer, shadowIndirectCountSSBO[imageIndex], 0, sizeof(uint32_t), 0);
+
+        vkCmdDispatch(commandBuffer, modelTransforms->modelMatricies.size(), 1, 1);
+
+        endLableRegion();
+
+        std::array<VkMemoryBarrier, 1> shadowCullBarrier{};
+        shadowCullBarrier[0].sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        shadowCullBarrier[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        shadowCullBarrier[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0,
+            shadowCullBarrier.size(),
+            shadowCullBarrier.data(),
+            0,
+            0,
+            0,
+            0);
+
+        beginLableRegion("Shadow render", labelCol);
+
+        VkRenderPassBeginInfo shadowRenderPassInfo{};
+        shadowRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+
+        shadowRenderPassInfo.renderPass = shadowPass.renderPass;
+        // assign the current framebuffer
+        shadowRenderPassInfo.framebuffer = shadowPass.frameBuffer;
+        // screen space offset
+        shadowRenderPassInfo.renderArea.offset = { 0, 0 };
+        // width and height of render
+        shadowRenderPassInfo.renderArea.extent = swapChainExtent;
+
+        // the shadow pass loads the cached map, only the dirty tiles are cleared
+        shadowRenderPassInfo.clearValueCount = 0;
+        shadowRenderPassInfo.pClearValues = nullptr;
+
+        vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        std::vector<VkClearRect> dirtyTileRects;
+        for (uint32_t tile = 0; tile < shadowCacheTilesPerSide * shadowCacheTilesPerSide; ++tile)
+        {
+            if ((dirtyTiles & (uint64_t(1) << tile)) == 0)
+            {
+                continue;
+            }
+
+            uint32_t tileX = tile % shadowCacheTilesPerSide;
+            uint32_t tileY = tile / shadowCacheTilesPerSide;
+
+            VkClearRect rect{};
+            rect.rect.offset.x = static_cast<int32_t>(tileX * swapChainExtent.width / shadowCacheTilesPerSide);
+            rect.rect.offset.y = static_cast<int32_t>(tileY * swapChainExtent.height / shadowCacheTilesPerSide);
+            rect.rect.extent.width = (tileX + 1) * swapChainExtent.width / shadowCacheTilesPerSide - rect.rect.offset.x;
+            rect.rect.extent.height = (tileY + 1) * swapChainExtent.height / shadowCacheTilesPerSide - rect.rect.offset.y;
+            rect.baseArrayLayer = 0;
+            rect.layerCount = 1;
+            dirtyTileRects.push_back(rect);
+        }
+
+        VkClearAttachment depthClear{};
+        depthClear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        depthClear.clearValue.depthStencil = { 1.0f, 0 };
+
+        vkCmdClearAttachments(commandBuffer, 1, &depthClear, static_cast<uint32_t>(dirtyTileRects.size()), dirtyTileRects.data());
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, dragon_model.getIndexType());
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowProgram->getLayout(), 0, 1, &shadowDescriptorSets[imageIndex], 0, nullptr);
+
+        vkCmdDrawIndexedIndirectCount(commandBuffer, shadowIndirectSSBO[imageIndex], 0, shadowIndirectCountSSBO[imageIndex], 0, modelTransforms->modelMatricies.size(), indirectCommandStride);
+
+        vkCmdEndRenderPass(commandBuffer);
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPools[imageIndex], shadowQueryIndices.second);
+
+        endLableRegion();
+    }
+    // SHADOW PASS END
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record shadow command buffer!");
+    }
+}
+
+uint64_t VulkanObject::shadowTileMask(const glm::vec3& center, float radius) const
+{
+    // project the corners of the sphere's bounding cube, as touchesDirtyShadowTile does in lod_indirect.glsl
+    glm::vec2 ndcMin(1.0f);
+    glm::vec2 ndcMax(-1.0f);
+
+    for (uint32_t corner = 0; corner < 8; ++corner)
+    {
+        glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+        glm::vec4 clip = ubo.lightVP * glm::vec4(center + offset, 1.0f);
+
+        if (clip.w <= 0.0f)
+        {
+            return shadowCacheAllTiles;
+        }
+
+        ndcMin = glm::min(ndcMin, glm::vec2(clip) / clip.w);
+        ndcMax = glm::max(ndcMax, glm::vec2(clip) / clip.w);
+    }
+
+    // entirely outside the shadow map
+    if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+    {
+        return 0;
+    }
+
+    const float tiles = static_cast<float>(shadowCacheTilesPerSide);
+    glm::uvec2 tileMin(glm::clamp((ndcMin * 0.5f + 0.5f) * tiles, glm::vec2(0.0f), glm::vec2(tiles - 1.0f)));
+    glm::uvec2 tileMax(glm::clamp((ndcMax * 0.5f + 0.5f) * tiles, glm::vec2(0.0f), glm::vec2(tiles - 1.0f)));
+
+    uint64_t mask = 0;
+    for (uint32_t y = tileMin.y; y <= tileMax.y; ++y)
+    {
+        for (uint32_t x = tileMin.x; x <= tileMax.x; ++x)
+        {
+            mask |= uint64_t(1) << (y * shadowCacheTilesPerSide + x);
+        }
+    }
+
+    return mask;
+}
+
 void VulkanObject::createSyncObjects() {
     // resize semaphore and fence vector to appropriate sizes
     imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -3503,6 +5401,36 @@ void VulkanObject::drawFrame() {
     // wait for all (VK_TRUE) fences before continueing.
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+    // anything streamed in since the last frame goes to the transfer queue now, this frame's
+    // graphics submit is ordered behind it
+    uploadService->flush();
+
+    // the attachments, pipelines and pre-recorded command buffers all depend on the mode
+    if (visibility_buffer != visibilityBufferActive || gbuffer_profile != gbufferProfileActive ||
+        wantsCullInstrumentation() != cullInstrumentationActive)
+    {
+        applyModeChange();
+        return;
+    }
+
+    // every frame in flight reads the one light buffer, wait for them before rewriting it
+    if (static_cast<uint32_t>(point_light_count) != pointLightCount)
+    {
+        vkDeviceWaitIdle(device);
+        updateLightSSBO();
+    }
+
+    // only the command buffers bind the display mode's pipelines, so re-record them with the
+    // new variant rather than rebuilding the swap chain
+    if (display_mode != displayModeActive)
+    {
+        vkDeviceWaitIdle(device);
+        displayModeActive = display_mode;
+        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+        createCommandBuffers(commandBuffers.data(), static_cast<uint32_t>(commandBuffers.size()), commandPool);
+        recordCommandBuffers();
+    }
+
     // variable to store the index of an available swap chain image
     uint32_t imageIndex;
     // aquire a swap chain image. This takes the device, swap chain, no timeout, semaphore to trigger, and the variable to store the index in
@@ -3528,7 +5456,6 @@ void VulkanObject::drawFrame() {
     imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
     updateUniformBuffer(imageIndex);
-    updateLODSSBO();
 
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -3563,20 +5490,7 @@ void VulkanObject::drawFrame() {
     ImGui::ColorEdit3("diffuse (Kd)", (float*)&dragon_model.Kd[0], flags);
     ImGui::ColorEdit3("specular (Ks)", (float*)&dragon_model.Ks[0], flags);
     ImGui::ColorEdit3("emission (Ke)", (float*)&dragon_model.Ke[0], flags);
-    auto& max_dists = dragon_model.getMaxDistances();
-    if (ImGui::GetFrameCount() <= 3)
-    {
-        max_dists[0] = 1.0f;
-        max_dists[1] = 0.175f;
-        max_dists[2] = 0.05f;
-        max_dists[3] = 0.0f;
-        max_dists[4] = 0.0f;
-    }
-    ImGui::SliderFloat("LOD level 0 max dist", &max_dists[0], 0.0f, 1.0f);// max_dists[1]);
-    ImGui::SliderFloat("LOD level 1 max dist", &max_dists[1], max_dists[0], max_dists[2]);
-    ImGui::SliderFloat("LOD level 2 max dist", &max_dists[2], max_dists[1], max_dists[3]);
-    ImGui::SliderFloat("LOD level 3 max dist", &max_dists[3], max_dists[2], max_dists[4]);
-    ImGui::SliderFloat("LOD level 4 max dist", &max_dists[4], max_dists[3], 1.0f);
+    ImGui::SliderFloat("LOD error (px)", &lod_error_pixels, 0.1f, 16.0f);
     ImGui::RadioButton("normals", &display_mode, 0);
     ImGui::RadioButton("depth", &display_mode, 1);
     ImGui::RadioButton("specularity", &display_mode, 2);
@@ -3666,22 +5580,62 @@ void VulkanObject::drawFrame() {
         earlyRenderTimeHistory.back() = static_cast<float>(queryResults[earlyRenderQueryIndices.second] - queryResults[earlyRenderQueryIndices.first]) / timestampPeriod / 1000000.0f;
         std::rotate(depthPyramidTimeHistory.begin(), depthPyramidTimeHistory.begin() + 1, depthPyramidTimeHistory.end());
         depthPyramidTimeHistory.back() = static_cast<float>(queryResults[depthPyramidQueryIndices.second] - queryResults[depthPyramidQueryIndices.first]) / timestampPeriod / 1000000.0f;
+        std::rotate(lightCullTimeHistory.begin(), lightCullTimeHistory.begin() + 1, lightCullTimeHistory.end());
+        lightCullTimeHistory.back() = static_cast<float>(queryResults[lightCullQueryIndices.second] - queryResults[lightCullQueryIndices.first]) / timestampPeriod / 1000000.0f;
         std::rotate(lateCullTimeHistory.begin(), lateCullTimeHistory.begin() + 1, lateCullTimeHistory.end());
         lateCullTimeHistory.back() = static_cast<float>(queryResults[lateCullQueryIndices.second] - queryResults[lateCullQueryIndices.first]) / timestampPeriod / 1000000.0f;
+        std::rotate(drawSortTimeHistory.begin(), drawSortTimeHistory.begin() + 1, drawSortTimeHistory.end());
+        drawSortTimeHistory.back() = static_cast<float>(
+            (queryResults[earlySortQueryIndices.second] - queryResults[earlySortQueryIndices.first]) +
+            (queryResults[lateSortQueryIndices.second] - queryResults[lateSortQueryIndices.first])) / timestampPeriod / 1000000.0f;
         std::rotate(lateRenderTimeHistory.begin(), lateRenderTimeHistory.begin() + 1, lateRenderTimeHistory.end());
         lateRenderTimeHistory.back() = static_cast<float>(queryResults[lateRenderQueryIndices.second] - queryResults[lateRenderQueryIndices.first]) / timestampPeriod / 1000000.0f;
+
+        // the shadow pass is only submitted when the cache was invalidated, a cache hit costs nothing
+        std::array<uint64_t, 2> shadowQueryResults{};
+        std::rotate(shadowTimeHistory.begin(), shadowTimeHistory.begin() + 1, shadowTimeHistory.end());
+        shadowTimeHistory.back() = 0.0f;
+        if (shadowRenderedForImage[imageIndex] &&
+            vkGetQueryPoolResults(device, queryPools[imageIndex], shadowQueryIndices.first, 2, sizeof(shadowQueryResults), shadowQueryResults.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            shadowTimeHistory.back() = static_cast<float>(shadowQueryResults[1] - shadowQueryResults[0]) / timestampPeriod / 1000000.0f;
+        }
     }
 
     ImGui::Text("Early cull: %.3f ms", earlyCullTimeHistory.back());
     ImGui::Text("Early render: %.3f ms", earlyRenderTimeHistory.back());
     ImGui::Text("Depth pyramid: %.3f ms", depthPyramidTimeHistory.back());
+    ImGui::Text("Light binning: %.3f ms (%u lights)", lightCullTimeHistory.back(), pointLightCount);
     ImGui::Text("Late cull: %.3f ms", lateCullTimeHistory.back());
+    ImGui::Text("Draw sort: %.3f ms", drawSortTimeHistory.back());
     ImGui::Text("Late render: %.3f ms", lateRenderTimeHistory.back());
+    ImGui::Text("Shadow: %.3f ms", shadowTimeHistory.back());
+    ImGui::Text("Shadow cache: %zu hits, %zu invalidations (%u/%u tiles last)", shadowCacheHits, shadowCacheInvalidations,
+        shadowCacheLastDirtyTileCount, shadowCacheTilesPerSide * shadowCacheTilesPerSide);
+
+    CullStatsData cullStats{};
+    void* cullStatsData;
+    vkMapMemory(device, cullStatsSSBOMemory[imageIndex], 0, sizeof(CullStatsData), 0, &cullStatsData);
+    memcpy(&cullStats, cullStatsData, sizeof(CullStatsData));
+    vkUnmapMemory(device, cullStatsSSBOMemory[imageIndex]);
+
+    ImGui::Text("Contribution culled: %u (%u point splats)", cullStats.contributionCulled, cullStats.pointSplats);
+    if (overdraw_stats)
+    {
+        // fragments that passed the depth test per pixel, 1.0 would be a perfect front to back order
+        ImGui::Text("G-buffer fragments: %u (%.2f per pixel)", cullStats.gbufferFragments,
+            static_cast<float>(cullStats.gbufferFragments) / static_cast<float>(swapChainExtent.width * swapChainExtent.height));
+    }
     ImGui::Text("Total measured: %.3f ms", earlyCullTimeHistory.back() +
         earlyRenderTimeHistory.back() +
         depthPyramidTimeHistory.back() +
+        lightCullTimeHistory.back() +
         lateCullTimeHistory.back() +
-        lateRenderTimeHistory.back());
+        drawSortTimeHistory.back() +
+        lateRenderTimeHistory.back() +
+        shadowTimeHistory.back());
+    ImGui::Text("Startup: %.1f ms, pipelines %.1f ms (%s pipeline cache)", startupTimeMs, pipelineCreationTimeMs,
+        pipelineCache->isWarm() ? "warm" : "cold");
 
     std::array<float, queryHistorySamples> frameCountNums;
     std::iota(frameCountNums.begin(), frameCountNums.end(), 0);
@@ -3697,8 +5651,19 @@ void VulkanObject::drawFrame() {
         std::transform(earlyCullTimeHistory.begin(), earlyCullTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
         std::transform(earlyRenderTimeHistory.begin(), earlyRenderTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
         std::transform(depthPyramidTimeHistory.begin(), depthPyramidTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
+        std::transform(lightCullTimeHistory.begin(), lightCullTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
         std::transform(lateCullTimeHistory.begin(), lateCullTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
+        std::transform(drawSortTimeHistory.begin(), drawSortTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
         std::transform(lateRenderTimeHistory.begin(), lateRenderTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
+        std::transform(shadowTimeHistory.begin(), shadowTimeHistory.end(), rollingTotals.begin(), rollingTotals.begin(), std::plus<float>());
+
+        {
+            ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(0.0f, 1.0f, 1.0f, 1.0f));
+            ImPlot::PlotShaded("Shadow", frameCountNums.data(), rollingTotals.data(), queryHistorySamples);
+            ImPlot::PopStyleColor();
+        }
+
+        std::transform(rollingTotals.begin(), rollingTotals.end(), shadowTimeHistory.begin(), rollingTotals.begin(), std::minus<float>());
         
         {
             ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(1.0f, 0.0f, 0.0f, 1.0f));
@@ -3708,6 +5673,14 @@ void VulkanObject::drawFrame() {
 
         std::transform(rollingTotals.begin(), rollingTotals.end(), lateRenderTimeHistory.begin(), rollingTotals.begin(), std::minus<float>());
         
+        {
+            ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(1.0f, 0.6f, 0.2f, 1.0f));
+            ImPlot::PlotShaded("Draw sort", frameCountNums.data(), rollingTotals.data(), queryHistorySamples);
+            ImPlot::PopStyleColor();
+        }
+
+        std::transform(rollingTotals.begin(), rollingTotals.end(), drawSortTimeHistory.begin(), rollingTotals.begin(), std::minus<float>());
+        
         {
             ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(0.0f, 1.0f, 0.0f, 1.0f));
             ImPlot::PlotShaded("Late cull", frameCountNums.data(), rollingTotals.data(), queryHistorySamples);
@@ -3716,6 +5689,14 @@ void VulkanObject::drawFrame() {
 
         std::transform(rollingTotals.begin(), rollingTotals.end(), lateCullTimeHistory.begin(), rollingTotals.begin(), std::minus<float>());
         
+        {
+            ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(1.0f, 0.9f, 0.4f, 1.0f));
+            ImPlot::PlotShaded("Light binning", frameCountNums.data(), rollingTotals.data(), queryHistorySamples);
+            ImPlot::PopStyleColor();
+        }
+
+        std::transform(rollingTotals.begin(), rollingTotals.end(), lightCullTimeHistory.begin(), rollingTotals.begin(), std::minus<float>());
+        
         {
             ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(0.0f, 0.0f, 1.0f, 1.0f));
             ImPlot::PlotShaded("Depth pyramid", frameCountNums.data(), rollingTotals.data(), queryHistorySamples);
@@ -3743,9 +5724,43 @@ void VulkanObject::drawFrame() {
         ImPlot::EndPlot();
     }
 
-    ImGui::Image((void*)meshesDrawnDebugViewImageViewImGUITexID, ImVec2(250, 250));
+    // switching it loads the instrumented cull, see applyModeChange
+    ImGui::Checkbox("Top down cull view", &cull_debug_view);
+    if (cullInstrumentationActive && cull_debug_view)
+    {
+        ImGui::Image((void*)meshesDrawnDebugViewImageViewImGUITexID, ImVec2(250, 250));
+    }
 
     ImGui::Checkbox("Updating pod", &updating_pos);
+    ImGui::Checkbox("Early pass reprojected occlusion", &early_reprojection);
+    ImGui::SliderFloat("Bootstrap occluder size (px)", &bootstrap_occluder_size, 1.0f, 512.0f);
+    if (ImGui::Button("Bootstrap occluders"))
+    {
+        bootstrapOcclusion = true;
+    }
+    ImGui::SliderInt("Shadow LOD bias", &shadow_lod_bias, 0, static_cast<int>(dragon_model.getTotalLodLevels()) - 1);
+    ImGui::RadioButton("Contribution cull off", &contribution_cull_mode, contributionCullOff); ImGui::SameLine();
+    ImGui::RadioButton("Drop", &contribution_cull_mode, contributionCullDrop); ImGui::SameLine();
+    ImGui::RadioButton("Point splat", &contribution_cull_mode, contributionCullPointSplat);
+    ImGui::SliderFloat("Contribution cull (px)", &contribution_cull_pixels, 0.0f, 16.0f);
+    ImGui::SliderFloat("Impostor screen size", &impostor_screen_size, 0.0f, 0.1f);
+    ImGui::Checkbox("Instanced LOD buckets", &instance_bucketing);
+    ImGui::Checkbox("Cluster LOD for near chickens", &cluster_lod);
+    ImGui::Checkbox("Front to back draw sort", &depth_sort); ImGui::SameLine();
+    ImGui::Checkbox("Count G-buffer overdraw", &overdraw_stats);
+    ImGui::Checkbox("Visibility buffer", &visibility_buffer);
+    for (int profile = 0; profile < static_cast<int>(gbufferProfiles.size()); ++profile)
+    {
+        ImGui::SameLine();
+        ImGui::RadioButton(std::format("{} G-buffer", gbufferProfiles[profile].name).c_str(), &gbuffer_profile, profile);
+    }
+    ImGui::Text("G-buffer colour: %u bytes per pixel", visibilityBufferActive ? 4u : gbufferProfiles[gbufferProfileActive].bytesPerPixel);
+    ImGui::Text("Point lights:");
+    ImGui::SameLine();
+    ImGui::RadioButton("None", &point_light_count, 0); ImGui::SameLine();
+    ImGui::RadioButton("1k", &point_light_count, 1000); ImGui::SameLine();
+    ImGui::RadioButton("10k", &point_light_count, 10000); ImGui::SameLine();
+    ImGui::RadioButton("100k", &point_light_count, 100000);
 
     save_path.resize(1024);
     ImGui::InputText("Save Path", save_path.data(), save_path.size());
@@ -3873,11 +5888,17 @@ void VulkanObject::drawFrame() {
             getline(open_file, line);
             mod_mat[3][3] = std::stof(line);
 
-            modelTransforms->modelMatricies[idx] = mod_mat;
-
             getline(open_file, line);
             float mod_scale = std::stof(line);
 
+            // only the shadow map tiles under a chicken's old and new positions need re-rendering
+            if (mod_mat != modelTransforms->modelMatricies[idx] || mod_scale != modelScales->operator[](idx))
+            {
+                shadowDirtyTiles |= shadowTileMask(glm::vec3(modelTransforms->modelMatricies[idx][3]), 0.351285f * modelScales->operator[](idx));
+                shadowDirtyTiles |= shadowTileMask(glm::vec3(mod_mat[3]), 0.351285f * mod_scale);
+            }
+
+            modelTransforms->modelMatricies[idx] = mod_mat;
             modelScales->operator[](idx) = mod_scale;
 
             ++idx;
@@ -3904,6 +5925,11 @@ void VulkanObject::drawFrame() {
         vkMapMemory(device, drawnLastFrameSSBOMemory, 0, chickenCount * sizeof(vk::Bool32), 0, &data);
         memcpy(data, zerodVisibility.get(), chickenCount * sizeof(vk::Bool32));
         vkUnmapMemory(device, drawnLastFrameSSBOMemory);
+
+        // this frame's uniforms were written before loading, redo them so this frame already
+        // uses the loaded camera and bootstraps its occluders
+        bootstrapOcclusion = true;
+        updateUniformBuffer(imageIndex);
     }
 
     std::string camera_pos = std::format("Camera pos: ({}, {}, {})", camera->Position.x, camera->Position.y, camera->Position.z);
@@ -3991,7 +6017,26 @@ void VulkanObject::drawFrame() {
     endLableRegion();
     vkEndCommandBuffer(imgui_command_buffers[imageIndex]);
 
-    std::array<VkCommandBuffer, 2> submitCommandBuffers = { commandBuffers[imageIndex], imgui_command_buffers[imageIndex] };
+    // only re-render the shadow map when part of it is dirty. The tiles come from this frame's
+    // uniforms so the cull and the clear agree. While lighting is off the map is never sampled,
+    // so the dirty tiles are kept until it is turned back on
+    uint64_t shadowTilesToRender = static_cast<uint64_t>(ubo.shadow_dirty_tiles_lo) | (static_cast<uint64_t>(ubo.shadow_dirty_tiles_hi) << 32);
+    bool renderShadows = lighting_stage_on && shadowTilesToRender != 0;
+    if (renderShadows)
+    {
+        recordShadowCommandBuffer(imageIndex, shadowTilesToRender);
+        shadowDirtyTiles &= ~shadowTilesToRender;
+        shadowCacheLastDirtyTileCount = static_cast<uint32_t>(std::popcount(shadowTilesToRender));
+        ++shadowCacheInvalidations;
+    }
+    else if (lighting_stage_on)
+    {
+        ++shadowCacheHits;
+    }
+    shadowRenderedForImage[imageIndex] = renderShadows;
+
+    std::array<VkCommandBuffer, 3> submitCommandBuffers = { shadowCommandBuffers[imageIndex], commandBuffers[imageIndex], imgui_command_buffers[imageIndex] };
+    uint32_t firstSubmitCommandBuffer = renderShadows ? 0 : 1;
     // struct to hold info about queue submissions
     VkSubmitInfo submitInfo{};
     // assign type
@@ -4009,9 +6054,9 @@ void VulkanObject::drawFrame() {
     submitInfo.pWaitDstStageMask = waitStages;
 
     // number of command buffers
-    submitInfo.commandBufferCount = static_cast<uint32_t>(submitCommandBuffers.size());
+    submitInfo.commandBufferCount = static_cast<uint32_t>(submitCommandBuffers.size()) - firstSubmitCommandBuffer;
     // c array of command buffers
-    submitInfo.pCommandBuffers = submitCommandBuffers.data();
+    submitInfo.pCommandBuffers = submitCommandBuffers.data() + firstSubmitCommandBuffer;
 
     // which semaphores to signal when we are done with image
     VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
@@ -4065,6 +6110,8 @@ void VulkanObject::drawFrame() {
         throw std::runtime_error("failed to present swap chain image!");
     }
 
+    depthPyramidHistoryValid = true;
+
     // update current frame
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
@@ -4080,6 +6127,10 @@ void VulkanObject::updateUniformBuffer(uint32_t currentImage) {
     camera_rotation_matrix *= glm::rotate(camera_y_rotation, glm::vec3(0.0, 1.0, 0.0));
     camera_rotation_matrix *= glm::rotate(camera_z_rotation, glm::vec3(0.0, 0.0, 1.0));
 
+    // the depth pyramid sampled by the early pass was built from last frame's view
+    ubo.prev_view = ubo.view;
+    ubo.prev_proj = ubo.proj;
+
     ubo.model = translation_matrix * rotation_matrix * scale_matrix;
     ubo.view = camera->GetViewMatrix();
     ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 1.0f, 250.0f);
@@ -4103,6 +6154,24 @@ void VulkanObject::updateUniformBuffer(uint32_t currentImage) {
         ubo.culling_updating = 0;
     }
 
+    // a large jump in camera position or direction leaves last frame's visible set useless
+    if (glm::distance(camera->Position, lastCameraPosition) > cameraCutDistance ||
+        glm::dot(camera->Front, lastCameraFront) < cameraCutMinCosAngle)
+    {
+        bootstrapOcclusion = true;
+    }
+    lastCameraPosition = camera->Position;
+    lastCameraFront = camera->Front;
+
+    ubo.bootstrap_occluders = bootstrapOcclusion && updating_pos;
+    ubo.bootstrap_occluder_size = bootstrap_occluder_size;
+    if (updating_pos)
+    {
+        bootstrapOcclusion = false;
+    }
+
+    ubo.early_reprojection = early_reprojection && updating_pos && depthPyramidHistoryValid && !ubo.bootstrap_occluders;
+
     ubo.zNear = 1.0f;
 
     ubo.light = glm::rotate(x_light_rotation, glm::vec3(1.0, 0.0, 0.0));
@@ -4119,6 +6188,36 @@ void VulkanObject::updateUniformBuffer(uint32_t currentImage) {
     ubo.specular = dragon_model.specular;
 
     ubo.shadow_bias = shadow_bias;
+    ubo.shadow_lod_bias = shadow_lod_bias;
+    ubo.contribution_cull_pixels = contribution_cull_pixels;
+    ubo.contribution_cull_mode = contribution_cull_mode;
+    ubo.impostor_screen_size = impostor_screen_size;
+    ubo.lod_error_pixels = lod_error_pixels;
+    ubo.cluster_lod = cluster_lod;
+    ubo.instance_bucketing = instance_bucketing;
+    ubo.depth_sort = depth_sort;
+    ubo.overdraw_stats = overdraw_stats;
+    ubo.point_light_count = pointLightCount;
+    const glm::uvec2 lightTileCount = getLightTileCount();
+    ubo.light_tile_count_x = lightTileCount.x;
+    ubo.light_tile_count_y = lightTileCount.y;
+    ubo.material_buffer = materialBufferSlot;
+    ubo.instance_material_buffer = instanceMaterialBufferSlot;
+    if (visibilityBufferActive)
+    {
+        // impostors and splats have no triangle for the resolve to fetch. Small instances are
+        // drawn as meshes or dropped instead
+        ubo.impostor_screen_size = 0.0f;
+        if (contribution_cull_mode == contributionCullPointSplat)
+        {
+            ubo.contribution_cull_mode = contributionCullDrop;
+        }
+    }
+    // splats clamped to one pixel no longer cover the chicken they stand in for, drop instead
+    if (!largePointsSupported && contribution_cull_mode == contributionCullPointSplat)
+    {
+        ubo.contribution_cull_mode = contributionCullDrop;
+    }
 
     ubo.model_stage_on = model_stage_on;
     ubo.texture_stage_on = texture_stage_on;
@@ -4132,11 +6231,24 @@ void VulkanObject::updateUniformBuffer(uint32_t currentImage) {
     ubo.top_down_model_bounds = glm::vec4(glm::vec2(-5.0f, -5.0f), glm::vec2(5.0f, 5.0f));
 
     glm::mat4 light_view = glm::lookAt(glm::vec3(ubo.light * glm::vec4(-2.5f, 0.0f, 0.0f, 1.0f)), glm::vec3(0.0), glm::vec3(0.0, 1.0, 0.0));
-    glm::mat4 light_proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.001f, 4.0f);
+    // far enough to cover the whole herd, matching the linearisation in the shadow debug view
+    glm::mat4 light_proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 1.0f, 250.0f);
     light_proj[1][1] *= -1;
 
     ubo.lightVP = light_proj * light_view;
 
+    // a moved light or new shadow settings leave nothing in the cached shadow map usable
+    if (ubo.lightVP != shadowCacheLightVP || shadow_lod_bias != shadowCacheLodBias || lod_error_pixels != shadowCacheLodErrorPixels)
+    {
+        shadowDirtyTiles = shadowCacheAllTiles;
+        shadowCacheLightVP = ubo.lightVP;
+        shadowCacheLodBias = shadow_lod_bias;
+        shadowCacheLodErrorPixels = lod_error_pixels;
+    }
+
+    ubo.shadow_dirty_tiles_lo = static_cast<uint32_t>(shadowDirtyTiles);
+    ubo.shadow_dirty_tiles_hi = static_cast<uint32_t>(shadowDirtyTiles >> 32);
+
     void* data;
     vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
     memcpy(data, &ubo, sizeof(ubo));
@@ -4144,14 +6256,17 @@ void VulkanObject::updateUniformBuffer(uint32_t currentImage) {
 
     ShadowUniformBufferObject subo{};
 
-    subo.depthMVP = ubo.lightVP * ubo.model;
+    // the model matrix of each chicken is applied per draw in shadow_pass.vert
+    subo.depthMVP = ubo.lightVP;
 
     vkMapMemory(device, shadowUniformBuffersMemory[currentImage], 0, sizeof(subo), 0, &data);
     memcpy(data, &subo, sizeof(subo));
     vkUnmapMemory(device, shadowUniformBuffersMemory[currentImage]);
 }
 
-void VulkanObject::updateSSBO() {
+// places the big chicken and scatters the rest. Only run at startup, so resizing or switching
+// modes keeps the same scene
+void VulkanObject::randomiseInstances() {
     modelTransforms = std::make_unique<ModelTransforms>();
     modelScales = std::make_unique<decltype(modelScales)::element_type>();
 
@@ -4202,6 +6317,12 @@ void VulkanObject::updateSSBO() {
         }
     }
 
+    // every caster may have moved
+    shadowDirtyTiles = shadowCacheAllTiles;
+}
+
+// uploads the instances to the freshly made buffers and clears the previous frame's visibility
+void VulkanObject::updateSSBO() {
     void* data;
     vkMapMemory(device, SSBOMemory, 0, sizeof(ModelTransforms), 0, &data);
     memcpy(data, modelTransforms.get(), sizeof(ModelTransforms));
@@ -4224,6 +6345,8 @@ void VulkanObject::updateSSBO() {
     vkMapMemory(device, drawnLastFrameSSBOMemory, 0, chickenCount * sizeof(vk::Bool32), 0, &data);
     memcpy(data, zerodVisibility.get(), chickenCount * sizeof(vk::Bool32));
     vkUnmapMemory(device, drawnLastFrameSSBOMemory);
+
+    bootstrapOcclusion = true;
 }
 
 void VulkanObject::updateLODSSBO()
@@ -4238,6 +6361,39 @@ void VulkanObject::updateLODSSBO()
     }
 }
 
+void VulkanObject::updateLightSSBO()
+{
+    pointLightCount = static_cast<uint32_t>(std::clamp(point_light_count, 0, static_cast<int>(maxPointLights)));
+    point_light_count = static_cast<int>(pointLightCount);
+
+    if (pointLightCount == 0)
+    {
+        return;
+    }
+
+    // fixed seed so a preset lights the same scene every run. Lights fill the chickens' box and
+    // their radii shrink as the count grows, keeping about as many lights over each chicken at
+    // every preset
+    std::mt19937 rng(36);
+    std::uniform_real_distribution<float> position_dist(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> radius_dist(0.5f, 1.5f);
+    std::uniform_real_distribution<float> color_dist(0.1f, 1.0f);
+    const float radiusScale = std::cbrt(1000.0f / static_cast<float>(pointLightCount));
+
+    std::vector<PointLight> lights(pointLightCount);
+    for (auto& light : lights)
+    {
+        const glm::vec3 position = glm::vec3(17.0f, 0.0f, 0.0f) + glm::vec3(position_dist(rng), position_dist(rng), position_dist(rng));
+        light.positionRadius = glm::vec4(position, radius_dist(rng) * radiusScale);
+        light.color = glm::vec4(color_dist(rng), color_dist(rng), color_dist(rng), 1.0f);
+    }
+
+    void* data;
+    vkMapMemory(device, pointLightSSBOMemory, 0, lights.size() * sizeof(PointLight), 0, &data);
+    memcpy(data, lights.data(), lights.size() * sizeof(PointLight));
+    vkUnmapMemory(device, pointLightSSBOMemory);
+}
+
 // create a VkShaderModule to encapsulate our shaders
 VkShaderModule VulkanObject::createShaderModule(const std::vector<char>& code) {
 
@@ -4440,6 +6596,22 @@ QueueFamilyIndices VulkanObject::findQueueFamilies(VkPhysicalDevice device) {
     // populate that vector
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+    // prefer a family that only transfers, the copy engine runs alongside graphics work. Then
+    // any family without graphics, and the graphics family last
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        const VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily = family;
+            break;
+        }
+        if (!indices.transferFamily.has_value()) {
+            indices.transferFamily = family;
+        }
+    }
+
     // loop over all available queue families
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
@@ -4468,6 +6640,10 @@ QueueFamilyIndices VulkanObject::findQueueFamilies(VkPhysicalDevice device) {
         i++;
     }
 
+    if (!indices.transferFamily.has_value()) {
+        indices.transferFamily = indices.graphicsFamily;
+    }
+
     return indices;
 }
 
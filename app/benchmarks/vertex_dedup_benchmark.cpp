@@ -0,0 +1,142 @@
+// times the ways the model loader has turned an OBJ's triangle corners in to an indexed mesh,
+// on the bundled assets or on the OBJ files given as arguments. Run from the build directory
+// like the app, so the default asset paths resolve the same way:
+//
+//   legacy       - std::unordered_map<Vertex, uint32_t> per corner, then meshopt_generateVertexRemap
+//                  and the remap calls again over its output, as Model::loadModel used to
+//   meshopt      - one meshopt_generateVertexRemap over the unindexed corner stream
+//   VertexDedup  - the sharded open addressed tables of VertexDedup.h on the job system
+//
+// the last two must agree exactly, the check below fails the run if they don't
+
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "app/JobSystem.h"
+#include "app/ObjLoader.h"
+#include "app/Vertex.h"
+#include "app/VertexDedup.h"
+
+namespace
+{
+	constexpr int runs = 7;
+
+	struct Indexed
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+
+	Indexed legacyDedup(const std::vector<Vertex>& stream)
+	{
+		Indexed result;
+		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+		result.indices.reserve(stream.size());
+		for (const Vertex& vertex : stream) {
+			if (uniqueVertices.count(vertex) == 0) {
+				uniqueVertices[vertex] = static_cast<uint32_t>(result.vertices.size());
+				result.vertices.push_back(vertex);
+			}
+			result.indices.push_back(uniqueVertices[vertex]);
+		}
+
+		// the second pass generateLOD used to make over the already indexed mesh
+		std::vector<unsigned int> remap(result.indices.size());
+		const size_t vertexCount = meshopt_generateVertexRemap(remap.data(), result.indices.data(), result.indices.size(),
+			result.vertices.data(), result.vertices.size(), sizeof(Vertex));
+		meshopt_remapIndexBuffer(result.indices.data(), result.indices.data(), result.indices.size(), remap.data());
+		meshopt_remapVertexBuffer(result.vertices.data(), result.vertices.data(), result.vertices.size(), sizeof(Vertex), remap.data());
+		result.vertices.resize(vertexCount);
+		return result;
+	}
+
+	Indexed meshoptDedup(const std::vector<Vertex>& stream)
+	{
+		Indexed result;
+		std::vector<unsigned int> remap(stream.size());
+		const size_t vertexCount = meshopt_generateVertexRemap(remap.data(), nullptr, stream.size(), stream.data(), stream.size(), sizeof(Vertex));
+		result.vertices.resize(vertexCount);
+		result.indices.resize(stream.size());
+		meshopt_remapVertexBuffer(result.vertices.data(), stream.data(), stream.size(), sizeof(Vertex), remap.data());
+		meshopt_remapIndexBuffer(result.indices.data(), nullptr, stream.size(), remap.data());
+		return result;
+	}
+
+	Indexed vertexDedup(const std::vector<Vertex>& stream, mc::JobSystem& jobSystem)
+	{
+		Indexed result;
+		const std::vector<uint32_t> firstUses = mc::VertexDedup::findFirstUses(stream, jobSystem);
+		mc::VertexDedup::compact(stream, firstUses, jobSystem, result.vertices, result.indices);
+		return result;
+	}
+
+	// median of runs, in milliseconds, and the result of the last run
+	template<typename Function>
+	double time(Function&& function, Indexed& result)
+	{
+		std::vector<double> samples;
+		for (int run = 0; run < runs; ++run) {
+			const auto start = std::chrono::steady_clock::now();
+			result = function();
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::sort(samples.begin(), samples.end());
+		return samples[samples.size() / 2];
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::filesystem::path> paths;
+	for (int i = 1; i < argc; ++i) {
+		paths.emplace_back(argv[i]);
+	}
+	if (paths.empty()) {
+		for (const char* path : { "../assets/chicken/chicken.obj", "../assets/duck/object.obj", "../assets/cube/cube.obj" }) {
+			if (std::filesystem::exists(path)) {
+				paths.emplace_back(path);
+			}
+		}
+	}
+	if (paths.empty()) {
+		std::fprintf(stderr, "no models found, pass OBJ paths as arguments\n");
+		return 1;
+	}
+
+	mc::JobSystem& jobSystem = mc::JobSystem::get();
+	std::printf("%u workers, median of %d runs\n\n", jobSystem.getWorkerCount() + 1, runs);
+	std::printf("%-32s %10s %10s %12s %12s %12s %9s\n", "model", "corners", "vertices", "legacy ms", "meshopt ms", "dedup ms", "speedup");
+
+	int failures = 0;
+	for (const std::filesystem::path& path : paths) {
+		const mc::ObjMesh mesh = mc::ObjLoader::parse(path, jobSystem);
+
+		// building the stream is part of every path, the legacy loader made each vertex as it went
+		Indexed legacy, meshopt, dedup;
+		const double legacyMs = time([&] { return legacyDedup(mc::ObjLoader::buildCornerStream(mesh, jobSystem)); }, legacy);
+		const double meshoptMs = time([&] { return meshoptDedup(mc::ObjLoader::buildCornerStream(mesh, jobSystem)); }, meshopt);
+		const double dedupMs = time([&] { return vertexDedup(mc::ObjLoader::buildCornerStream(mesh, jobSystem), jobSystem); }, dedup);
+
+		const bool same = meshopt.indices == dedup.indices &&
+			meshopt.vertices.size() == dedup.vertices.size() &&
+			std::equal(meshopt.vertices.begin(), meshopt.vertices.end(), dedup.vertices.begin(),
+				[](const Vertex& a, const Vertex& b) { return std::memcmp(&a, &b, sizeof(Vertex)) == 0; });
+		if (!same) {
+			std::fprintf(stderr, "%s: VertexDedup disagrees with meshopt_generateVertexRemap\n", path.string().c_str());
+			++failures;
+		}
+
+		std::printf("%-32s %10zu %10zu %12.2f %12.2f %12.2f %8.1fx\n", path.string().c_str(),
+			mesh.corners.size(), dedup.vertices.size(), legacyMs, meshoptMs, dedupMs, legacyMs / dedupMs);
+	}
+
+	return failures == 0 ? 0 : 1;
+}
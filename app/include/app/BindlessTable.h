@@ -0,0 +1,169 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace mc
+{
+	// every texture and asset buffer in the scene in one descriptor set, bound as set 1 next to
+	// a program's own set 0. Shaders index textures and buffers by the slot add returned, so a
+	// new asset is a new slot rather than a new binding and pipeline. Slots are written with
+	// update after bind and the arrays are partially bound, so they can be filled while command
+	// buffers that use the set are pending and unfilled slots are never read
+	class BindlessTable
+	{
+		VkDevice device = nullptr;
+		VkDescriptorSetLayout setLayout = nullptr;
+		VkDescriptorPool pool = nullptr;
+		VkDescriptorSet set = nullptr;
+
+		uint32_t maxTextures = 0;
+		uint32_t maxBuffers = 0;
+		uint32_t textureCount = 0;
+		uint32_t bufferCount = 0;
+
+	public:
+		// layout(set = 1, binding = 0) uniform sampler2D textures[]
+		static constexpr uint32_t textureBinding = 0;
+		// layout(set = 1, binding = 1) buffer ... { } buffers[], any block type may alias it
+		static constexpr uint32_t bufferBinding = 1;
+		static constexpr uint32_t setIndex = 1;
+
+		BindlessTable() = delete;
+		BindlessTable(BindlessTable const&) = delete;
+		BindlessTable& operator=(BindlessTable const&) = delete;
+
+		// the array sizes are capped at what the device allows per update after bind set
+		BindlessTable(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t textureCapacity = 4096, uint32_t bufferCapacity = 1024) :
+			device(device)
+		{
+			VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+			indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+			VkPhysicalDeviceProperties2 properties{};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &indexingProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+			maxTextures = std::min({ textureCapacity,
+				indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+				indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+			maxBuffers = std::min({ bufferCapacity,
+				indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+				indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+
+			std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+			bindings[0].binding = textureBinding;
+			bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[0].descriptorCount = maxTextures;
+			bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+			bindings[1].binding = bufferBinding;
+			bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[1].descriptorCount = maxBuffers;
+			bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+			const VkDescriptorBindingFlags bindingFlag =
+				VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+				VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+				VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+			const std::array<VkDescriptorBindingFlags, 2> bindingFlags = { bindingFlag, bindingFlag };
+
+			VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+			bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+			bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+			bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+			VkDescriptorSetLayoutCreateInfo layoutInfo{};
+			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			layoutInfo.pNext = &bindingFlagsInfo;
+			layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+			layoutInfo.pBindings = bindings.data();
+
+			if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create bindless descriptor set layout!");
+			}
+
+			std::array<VkDescriptorPoolSize, 2> poolSizes{};
+			poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			poolSizes[0].descriptorCount = maxTextures;
+			poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			poolSizes[1].descriptorCount = maxBuffers;
+
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+			poolInfo.maxSets = 1;
+			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+			poolInfo.pPoolSizes = poolSizes.data();
+
+			if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create bindless descriptor pool!");
+			}
+
+			VkDescriptorSetAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+			allocInfo.descriptorPool = pool;
+			allocInfo.descriptorSetCount = 1;
+			allocInfo.pSetLayouts = &setLayout;
+
+			if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate bindless descriptor set!");
+			}
+		}
+
+		~BindlessTable()
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+			vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		}
+
+		VkDescriptorSetLayout getSetLayout() const { return setLayout; }
+		VkDescriptorSet getSet() const { return set; }
+
+		// returns the slot shaders sample the texture through
+		uint32_t addTexture(VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout)
+		{
+			if (textureCount == maxTextures) {
+				throw std::runtime_error("bindless texture table is full!");
+			}
+
+			VkDescriptorImageInfo imageInfo{ sampler, imageView, imageLayout };
+
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = textureBinding;
+			write.dstArrayElement = textureCount;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			write.descriptorCount = 1;
+			write.pImageInfo = &imageInfo;
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+			return textureCount++;
+		}
+
+		// returns the slot shaders read the buffer through
+		uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE)
+		{
+			if (bufferCount == maxBuffers) {
+				throw std::runtime_error("bindless buffer table is full!");
+			}
+
+			VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+
+			VkWriteDescriptorSet write{};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = bufferBinding;
+			write.dstArrayElement = bufferCount;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			write.descriptorCount = 1;
+			write.pBufferInfo = &bufferInfo;
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+			return bufferCount++;
+		}
+	};
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <meshoptimizer.h>
+
+#include "app/JobSystem.h"
+
+namespace mc
+{
+	// a sphere around some geometry, and how far in model units that geometry may lie from
+	// the full detail surface
+	struct ClusterBounds
+	{
+		glm::vec3 center{ 0.0f };
+		float radius = 0.0f;
+		float error = 0.0f;
+	};
+
+	// a continuous LOD hierarchy over one mesh. The full detail triangles are split in to
+	// clusters, then level by level neighbouring clusters are grouped, each group is merged,
+	// simplified to about half its triangles with its outline locked, and split in to clusters
+	// again. A group's bounds are both the parent bounds of the clusters that went in and the
+	// own bounds of the clusters that came out.
+	//
+	// Drawing every cluster whose own projected error is within budget and whose parent's is
+	// not then covers the mesh exactly once. Clusters that went in to the same group share their
+	// parent bounds and so always agree on which side of the cut they are, and the locked
+	// outlines meet whichever level the neighbouring group picked without cracks. Errors only
+	// grow towards the roots and each group's sphere holds its children's, so projected errors
+	// do as well from any viewpoint. A group never splits in to more clusters than went in to it,
+	// so neither does a cut hold more than the full detail clusters
+	class ClusterDag
+	{
+	public:
+		// meshoptimizer's recommended meshlet size, small enough for a fine cut and big enough
+		// that a cluster is still worth a draw
+		static constexpr size_t maxVertices = 64;
+		static constexpr size_t maxTriangles = 124;
+		static constexpr size_t groupSize = 4;
+		static constexpr size_t maxDepth = 24;
+
+		struct Cluster
+		{
+			// in to the vertex array the hierarchy was built over
+			std::vector<uint32_t> indices;
+			ClusterBounds self;
+			// the group this cluster was simplified in to. Roots were never simplified further
+			// and keep an error no budget allows, so they are drawn whenever their own error is
+			// within it
+			ClusterBounds parent;
+			// 0 for the full detail clusters
+			uint32_t depth = 0;
+		};
+
+		// positions are stride bytes apart. Groups of one level are simplified in parallel
+		static std::vector<Cluster> build(std::vector<uint32_t> const& indices, float const* positions, size_t vertexCount, size_t stride, JobSystem& jobSystem)
+		{
+			// clusters either side of a texture or normal seam share positions but not vertices,
+			// so adjacency is found through the first vertex at each position
+			std::vector<uint32_t> positionRemap(vertexCount);
+			const meshopt_Stream positionStream{ positions, sizeof(float) * 3, stride };
+			meshopt_generateVertexRemapMulti(positionRemap.data(), nullptr, vertexCount, vertexCount, &positionStream, 1);
+
+			// meshopt_simplify's errors are relative to the mesh's extent
+			const float errorScale = meshopt_simplifyScale(positions, vertexCount, stride);
+
+			std::vector<Cluster> clusters = split(indices, positions, vertexCount, stride);
+			for (Cluster& cluster : clusters) {
+				cluster.self = sphereAround(cluster.indices, positions, vertexCount, stride);
+				cluster.parent.error = std::numeric_limits<float>::max();
+			}
+
+			std::vector<size_t> pending(clusters.size());
+			std::iota(pending.begin(), pending.end(), size_t(0));
+
+			for (uint32_t depth = 1; pending.size() > 1 && depth <= maxDepth; ++depth) {
+				const std::vector<std::vector<size_t>> groups = groupNeighbours(clusters, pending, positionRemap);
+
+				// empty where the simplifier could not reduce a group, whose clusters stay roots
+				std::vector<std::vector<Cluster>> simplified(groups.size());
+				jobSystem.parallelFor(groups.size(), 1, [&](size_t begin, size_t end) {
+					for (size_t group = begin; group < end; ++group) {
+						simplified[group] = simplifyGroup(clusters, groups[group], positions, vertexCount, stride, errorScale);
+					}
+				});
+
+				std::vector<size_t> next;
+				for (size_t group = 0; group < groups.size(); ++group) {
+					if (simplified[group].empty()) {
+						continue;
+					}
+					for (size_t child : groups[group]) {
+						clusters[child].parent = simplified[group].front().self;
+					}
+					for (Cluster& cluster : simplified[group]) {
+						cluster.depth = depth;
+						next.push_back(clusters.size());
+						clusters.push_back(std::move(cluster));
+					}
+				}
+				pending = std::move(next);
+			}
+
+			return clusters;
+		}
+
+	private:
+		static std::vector<Cluster> split(std::vector<uint32_t> const& indices, float const* positions, size_t vertexCount, size_t stride)
+		{
+			const size_t bound = meshopt_buildMeshletsBound(indices.size(), maxVertices, maxTriangles);
+			std::vector<meshopt_Meshlet> meshlets(bound);
+			std::vector<unsigned int> meshletVertices(bound * maxVertices);
+			std::vector<unsigned char> meshletTriangles(bound * maxTriangles * 3);
+			meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(),
+				indices.data(), indices.size(), positions, vertexCount, stride, maxVertices, maxTriangles, 0.0f));
+
+			std::vector<Cluster> clusters(meshlets.size());
+			for (size_t i = 0; i < meshlets.size(); ++i) {
+				const meshopt_Meshlet& meshlet = meshlets[i];
+				clusters[i].indices.resize(meshlet.triangle_count * 3);
+				for (size_t corner = 0; corner < meshlet.triangle_count * 3; ++corner) {
+					clusters[i].indices[corner] = meshletVertices[meshlet.vertex_offset + meshletTriangles[meshlet.triangle_offset + corner]];
+				}
+			}
+			return clusters;
+		}
+
+		static ClusterBounds sphereAround(std::vector<uint32_t> const& indices, float const* positions, size_t vertexCount, size_t stride)
+		{
+			const meshopt_Bounds bounds = meshopt_computeClusterBounds(indices.data(), indices.size(), positions, vertexCount, stride);
+			ClusterBounds sphere;
+			sphere.center = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+			sphere.radius = bounds.radius;
+			return sphere;
+		}
+
+		// grows a sphere just enough to hold another
+		static void enclose(ClusterBounds& sphere, ClusterBounds const& other)
+		{
+			const float distance = glm::length(other.center - sphere.center);
+			if (distance + other.radius <= sphere.radius) {
+				return;
+			}
+			if (distance + sphere.radius <= other.radius) {
+				sphere.center = other.center;
+				sphere.radius = other.radius;
+				return;
+			}
+			const float radius = (sphere.radius + distance + other.radius) * 0.5f;
+			sphere.center += (other.center - sphere.center) * ((radius - sphere.radius) / distance);
+			sphere.radius = radius;
+		}
+
+		// greedy partition of the pending clusters in to groups of up to groupSize, each grown
+		// from a seed by the ungrouped neighbour sharing the most positions with the group.
+		// Clusters are visited in the order they were made, which keeps a seed near the group it
+		// came from. Far from the graph partitioning a production build would use, but groups
+		// stay connected, which is what the locked outlines need to leave room to simplify
+		static std::vector<std::vector<size_t>> groupNeighbours(std::vector<Cluster> const& clusters, std::vector<size_t> const& pending,
+			std::vector<uint32_t> const& positionRemap)
+		{
+			// which pending clusters use each position, once each
+			std::unordered_map<uint32_t, std::vector<uint32_t>> users;
+			for (size_t local = 0; local < pending.size(); ++local) {
+				for (uint32_t index : clusters[pending[local]].indices) {
+					std::vector<uint32_t>& positionUsers = users[positionRemap[index]];
+					if (positionUsers.empty() || positionUsers.back() != local) {
+						positionUsers.push_back(static_cast<uint32_t>(local));
+					}
+				}
+			}
+
+			std::vector<std::unordered_map<uint32_t, uint32_t>> shared(pending.size());
+			for (auto const& [position, positionUsers] : users) {
+				for (uint32_t a : positionUsers) {
+					for (uint32_t b : positionUsers) {
+						if (a != b) {
+							++shared[a][b];
+						}
+					}
+				}
+			}
+
+			std::vector<bool> grouped(pending.size(), false);
+			std::vector<std::vector<size_t>> groups;
+			for (size_t seed = 0; seed < pending.size(); ++seed) {
+				if (grouped[seed]) {
+					continue;
+				}
+				std::vector<uint32_t> members{ static_cast<uint32_t>(seed) };
+				grouped[seed] = true;
+
+				while (members.size() < groupSize) {
+					uint32_t best = 0;
+					uint32_t bestShared = 0;
+					for (uint32_t member : members) {
+						for (auto const& [neighbour, count] : shared[member]) {
+							if (!grouped[neighbour] && count > bestShared) {
+								best = neighbour;
+								bestShared = count;
+							}
+						}
+					}
+					if (bestShared == 0) {
+						break;
+					}
+					members.push_back(best);
+					grouped[best] = true;
+				}
+
+				std::vector<size_t>& group = groups.emplace_back();
+				for (uint32_t member : members) {
+					group.push_back(pending[member]);
+				}
+			}
+			return groups;
+		}
+
+		static std::vector<Cluster> simplifyGroup(std::vector<Cluster> const& clusters, std::vector<size_t> const& group,
+			float const* positions, size_t vertexCount, size_t stride, float errorScale)
+		{
+			std::vector<uint32_t> merged;
+			ClusterBounds bounds = clusters[group.front()].self;
+			for (size_t child : group) {
+				merged.insert(merged.end(), clusters[child].indices.begin(), clusters[child].indices.end());
+				enclose(bounds, clusters[child].self);
+				bounds.error = std::max(bounds.error, clusters[child].self.error);
+			}
+
+			// only the triangle count stops the simplifier, the error it reaches is recorded
+			float error = 0.0f;
+			std::vector<uint32_t> simplified(merged.size());
+			simplified.resize(meshopt_simplify(simplified.data(), merged.data(), merged.size(), positions, vertexCount, stride,
+				merged.size() / 6 * 3, std::numeric_limits<float>::max(), meshopt_SimplifyLockBorder, &error));
+
+			// a group that keeps more than five sixths of its triangles would add a level of
+			// draws for almost nothing
+			if (simplified.empty() || simplified.size() * 6 > merged.size() * 5) {
+				return {};
+			}
+
+			// on top of the children's, so no parent is ever more accurate than its children
+			bounds.error += error * errorScale;
+
+			// never more clusters out than went in, so no cut has more clusters than the full
+			// detail level and a draw list sized for that always holds one
+			std::vector<Cluster> result = split(simplified, positions, vertexCount, stride);
+			if (result.size() > group.size()) {
+				return {};
+			}
+			for (Cluster& cluster : result) {
+				cluster.self = bounds;
+				cluster.parent.error = std::numeric_limits<float>::max();
+			}
+			return result;
+		}
+	};
+}
@@ -0,0 +1,314 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <stb_dxt.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace mc
+{
+	enum class TextureEncoding : uint32_t
+	{
+		RGBA8 = 0,
+		BC1 = 1,
+	};
+
+	// a texture cooked from its source image in to the layout the GPU samples, with the full mip
+	// chain already built and compressed. The cooked file sits next to the source and is reused
+	// until the source is newer, so the PNG is decoded and filtered once rather than every start.
+	// Mip data is stored in the order and alignment vkCmdCopyBufferToImage wants, so it can be
+	// read straight in to a mapped staging buffer and copied to the image in one go
+	class CookedTexture
+	{
+	public:
+		static constexpr uint32_t maxMips = 16;
+
+		struct Mip
+		{
+			uint32_t width;
+			uint32_t height;
+			// from the start of the mip data, not the file
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			TextureEncoding encoding;
+			uint32_t width;
+			uint32_t height;
+			uint32_t mipCount;
+			uint64_t dataSize;
+			Mip mips[maxMips];
+		};
+
+	private:
+		static constexpr uint32_t fileMagic = 0x5854434d; // "MCTX"
+		static constexpr uint32_t fileVersion = 1;
+		// a multiple of every block size used, so each mip is a valid copy offset
+		static constexpr uint64_t mipAlignment = 16;
+
+		FileHeader header{};
+		std::filesystem::path path;
+		// only filled when the cooked file could not be written, the data is then served from here
+		std::vector<char> cookedData;
+		bool cooked = false;
+
+	public:
+		CookedTexture() = delete;
+		CookedTexture(CookedTexture const&) = delete;
+		CookedTexture& operator=(CookedTexture const&) = delete;
+
+		// opens the cooked file for source, cooking it first if it is missing, older than the
+		// source or was written by another version
+		CookedTexture(const std::filesystem::path& source, TextureEncoding encoding) :
+			path(cachePath(source, encoding))
+		{
+			if (!load(source, encoding)) {
+				cook(source, encoding);
+				cooked = true;
+			}
+		}
+
+		static std::filesystem::path cachePath(const std::filesystem::path& source, TextureEncoding encoding)
+		{
+			std::filesystem::path result = source;
+			result += encoding == TextureEncoding::BC1 ? ".bc1.mctx" : ".rgba8.mctx";
+			return result;
+		}
+
+		static VkFormat getFormat(TextureEncoding encoding)
+		{
+			return encoding == TextureEncoding::BC1 ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_R8G8B8A8_SRGB;
+		}
+
+		VkFormat getFormat() const { return getFormat(header.encoding); }
+		uint32_t getWidth() const { return header.width; }
+		uint32_t getHeight() const { return header.height; }
+		uint32_t getMipCount() const { return header.mipCount; }
+		uint64_t getDataSize() const { return header.dataSize; }
+		// whether this run had to cook the texture rather than finding it on disk
+		bool wasCooked() const { return cooked; }
+
+		// reads every mip in to destination, which must hold getDataSize() bytes
+		void readData(void* destination) const
+		{
+			if (!cookedData.empty()) {
+				std::memcpy(destination, cookedData.data() + sizeof(FileHeader), static_cast<size_t>(header.dataSize));
+				return;
+			}
+
+			std::ifstream file(path, std::ios::binary);
+			file.seekg(sizeof(FileHeader));
+			file.read(static_cast<char*>(destination), static_cast<std::streamsize>(header.dataSize));
+			if (!file) {
+				throw std::runtime_error("failed to read cooked texture: " + path.string());
+			}
+		}
+
+		// one region per mip, for a buffer holding readData's output at bufferOffset
+		std::vector<VkBufferImageCopy> getCopyRegions(VkDeviceSize bufferOffset = 0) const
+		{
+			std::vector<VkBufferImageCopy> regions(header.mipCount);
+			for (uint32_t mip = 0; mip < header.mipCount; ++mip) {
+				VkBufferImageCopy& region = regions[mip];
+				region.bufferOffset = bufferOffset + header.mips[mip].offset;
+				region.bufferRowLength = 0;
+				region.bufferImageHeight = 0;
+				region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				region.imageSubresource.mipLevel = mip;
+				region.imageSubresource.baseArrayLayer = 0;
+				region.imageSubresource.layerCount = 1;
+				region.imageOffset = { 0, 0, 0 };
+				region.imageExtent = { header.mips[mip].width, header.mips[mip].height, 1 };
+			}
+			return regions;
+		}
+
+	private:
+		bool load(const std::filesystem::path& source, TextureEncoding encoding)
+		{
+			std::error_code error;
+			if (!std::filesystem::exists(path, error)) {
+				return false;
+			}
+			// a cooked file without its source is still usable, so only a newer source rejects it
+			if (std::filesystem::exists(source, error) &&
+				std::filesystem::last_write_time(source, error) > std::filesystem::last_write_time(path, error)) {
+				return false;
+			}
+
+			std::ifstream file(path, std::ios::ate | std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+			const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+			if (fileSize < sizeof(FileHeader)) {
+				return false;
+			}
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+			return file &&
+				header.magic == fileMagic &&
+				header.version == fileVersion &&
+				header.encoding == encoding &&
+				header.mipCount >= 1 && header.mipCount <= maxMips &&
+				header.dataSize == fileSize - sizeof(FileHeader);
+		}
+
+		void cook(const std::filesystem::path& source, TextureEncoding encoding)
+		{
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load(source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+			if (!pixels) {
+				throw std::runtime_error("failed to load texture image: " + source.string());
+			}
+
+			std::vector<std::vector<uint8_t>> levels;
+			levels.emplace_back(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			stbi_image_free(pixels);
+
+			header = FileHeader{};
+			header.magic = fileMagic;
+			header.version = fileVersion;
+			header.encoding = encoding;
+			header.width = static_cast<uint32_t>(width);
+			header.height = static_cast<uint32_t>(height);
+			header.mipCount = std::min(static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1, maxMips);
+
+			uint32_t levelWidth = header.width;
+			uint32_t levelHeight = header.height;
+			for (uint32_t mip = 1; mip < header.mipCount; ++mip) {
+				levels.push_back(downsample(levels.back(), levelWidth, levelHeight));
+				levelWidth = std::max(levelWidth / 2, 1u);
+				levelHeight = std::max(levelHeight / 2, 1u);
+			}
+
+			std::vector<std::vector<uint8_t>> encoded(header.mipCount);
+			uint64_t offset = 0;
+			for (uint32_t mip = 0; mip < header.mipCount; ++mip) {
+				Mip& entry = header.mips[mip];
+				entry.width = std::max(header.width >> mip, 1u);
+				entry.height = std::max(header.height >> mip, 1u);
+
+				encoded[mip] = encoding == TextureEncoding::BC1 ?
+					compressBC1(levels[mip], entry.width, entry.height) :
+					std::move(levels[mip]);
+
+				entry.offset = offset;
+				entry.size = encoded[mip].size();
+				offset = (offset + entry.size + mipAlignment - 1) / mipAlignment * mipAlignment;
+			}
+			header.dataSize = offset;
+
+			cookedData.assign(sizeof(FileHeader) + header.dataSize, 0);
+			std::memcpy(cookedData.data(), &header, sizeof(header));
+			for (uint32_t mip = 0; mip < header.mipCount; ++mip) {
+				std::memcpy(cookedData.data() + sizeof(FileHeader) + header.mips[mip].offset, encoded[mip].data(), encoded[mip].size());
+			}
+
+			// the cooked data is still used this run if it can't be saved, only the next start pays
+			// for the cook again
+			std::filesystem::path tempPath = path;
+			tempPath += ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				file.write(cookedData.data(), static_cast<std::streamsize>(cookedData.size()));
+				if (!file) {
+					std::cerr << "failed to write cooked texture: " << tempPath.string() << std::endl;
+					return;
+				}
+			}
+			std::error_code error;
+			std::filesystem::rename(tempPath, path, error);
+			if (error) {
+				std::cerr << "failed to replace cooked texture: " << path.string() << std::endl;
+				return;
+			}
+			cookedData.clear();
+		}
+
+		// 2x2 box filter in linear space, the source is sRGB. Odd edges repeat the last texel
+		static std::vector<uint8_t> downsample(const std::vector<uint8_t>& level, uint32_t width, uint32_t height)
+		{
+			static const std::array<float, 256> toLinear = [] {
+				std::array<float, 256> table{};
+				for (size_t i = 0; i < table.size(); ++i) {
+					const float c = static_cast<float>(i) / 255.0f;
+					table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+				}
+				return table;
+			}();
+			auto toSrgb = [](float c) {
+				c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+				return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+			};
+
+			const uint32_t outWidth = std::max(width / 2, 1u);
+			const uint32_t outHeight = std::max(height / 2, 1u);
+			std::vector<uint8_t> result(static_cast<size_t>(outWidth) * outHeight * 4);
+
+			for (uint32_t y = 0; y < outHeight; ++y) {
+				for (uint32_t x = 0; x < outWidth; ++x) {
+					const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+					const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+					const std::array<const uint8_t*, 4> texels = {
+						&level[(static_cast<size_t>(y0) * width + x0) * 4],
+						&level[(static_cast<size_t>(y0) * width + x1) * 4],
+						&level[(static_cast<size_t>(y1) * width + x0) * 4],
+						&level[(static_cast<size_t>(y1) * width + x1) * 4] };
+
+					uint8_t* out = &result[(static_cast<size_t>(y) * outWidth + x) * 4];
+					for (int channel = 0; channel < 3; ++channel) {
+						float sum = 0.0f;
+						for (const uint8_t* texel : texels) {
+							sum += toLinear[texel[channel]];
+						}
+						out[channel] = toSrgb(sum * 0.25f);
+					}
+					uint32_t alpha = 0;
+					for (const uint8_t* texel : texels) {
+						alpha += texel[3];
+					}
+					out[3] = static_cast<uint8_t>((alpha + 2) / 4);
+				}
+			}
+			return result;
+		}
+
+		// 8 bytes per 4x4 block, mips smaller than a block repeat their edge texels to fill it
+		static std::vector<uint8_t> compressBC1(const std::vector<uint8_t>& level, uint32_t width, uint32_t height)
+		{
+			const uint32_t blocksX = (width + 3) / 4;
+			const uint32_t blocksY = (height + 3) / 4;
+			std::vector<uint8_t> result(static_cast<size_t>(blocksX) * blocksY * 8);
+
+			std::array<uint8_t, 16 * 4> block{};
+			for (uint32_t by = 0; by < blocksY; ++by) {
+				for (uint32_t bx = 0; bx < blocksX; ++bx) {
+					for (uint32_t y = 0; y < 4; ++y) {
+						for (uint32_t x = 0; x < 4; ++x) {
+							const uint32_t sx = std::min(bx * 4 + x, width - 1);
+							const uint32_t sy = std::min(by * 4 + y, height - 1);
+							std::memcpy(&block[(y * 4 + x) * 4], &level[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+						}
+					}
+					stb_compress_dxt_block(&result[(static_cast<size_t>(by) * blocksX + bx) * 8], block.data(), 0, STB_DXT_HIGHQUAL);
+				}
+			}
+			return result;
+		}
+	};
+}
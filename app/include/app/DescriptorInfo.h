@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <type_traits>
 #include <vulkan/vulkan.h>
 
@@ -47,4 +48,19 @@ namespace mc
 		VulkanDescriptorType get() { return info; }
 		VulkanDescriptorType* getPtr() { return &info; }
 	};
+
+	// one binding's worth of descriptor data, in the layout an update template reads
+	union DescriptorData
+	{
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+
+		DescriptorData() : buffer{} {}
+		DescriptorData(DescriptorInfo<VkDescriptorImageInfo> info) : image(info.get()) {}
+		DescriptorData(DescriptorInfo<VkDescriptorBufferInfo> info) : buffer(info.get()) {}
+	};
+
+	// the data for a whole set indexed by binding, see ShaderProgram::updateDescriptorSet. Only
+	// the bindings the program's shaders declare are read, the rest can be left empty
+	using DescriptorSetData = std::array<DescriptorData, 32>;
 }
\ No newline at end of file
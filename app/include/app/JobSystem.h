@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mc
+{
+	// a fixed pool of worker threads, each with its own job queue. A worker takes the newest
+	// job from its own queue and, when that is empty, steals the oldest job from another's, so
+	// a job that fans out keeps its children close while idle workers spread the rest. Waiting
+	// on a counter runs jobs rather than blocking, which lets jobs wait on jobs they started
+	class JobSystem
+	{
+	public:
+		using Job = std::function<void()>;
+
+		// the jobs of one group still to finish, and the first exception any of them threw
+		class Counter
+		{
+			std::atomic<uint32_t> pending{ 0 };
+			std::mutex errorMutex;
+			std::exception_ptr error;
+			friend class JobSystem;
+
+		public:
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+		};
+
+	private:
+		struct Entry
+		{
+			Job job;
+			Counter* counter;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Entry> entries;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> threads;
+		std::atomic<uint32_t> queued{ 0 };
+		std::atomic<uint32_t> nextQueue{ 0 };
+		std::atomic<bool> stopping{ false };
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+
+		// the queue of the worker running on this thread, -1 on threads outside the pool
+		static inline thread_local int workerIndex = -1;
+
+	public:
+		JobSystem(JobSystem const&) = delete;
+		JobSystem& operator=(JobSystem const&) = delete;
+
+		// the calling thread helps while it waits, so one core is left to it by default
+		explicit JobSystem(uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1)
+		{
+			threadCount = std::max(threadCount, 1u);
+			for (uint32_t i = 0; i < threadCount; ++i) {
+				queues.push_back(std::make_unique<Queue>());
+			}
+			for (uint32_t i = 0; i < threadCount; ++i) {
+				threads.emplace_back([this, i] { workerLoop(static_cast<int>(i)); });
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				std::lock_guard lock(sleepMutex);
+				stopping = true;
+			}
+			wake.notify_all();
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+		}
+
+		// shared by everything that loads or builds assets, started on first use
+		static JobSystem& get()
+		{
+			static JobSystem jobSystem;
+			return jobSystem;
+		}
+
+		uint32_t getWorkerCount() const { return static_cast<uint32_t>(threads.size()); }
+
+		void run(Counter& counter, Job job)
+		{
+			counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+			const size_t queueIndex = workerIndex >= 0 ?
+				static_cast<size_t>(workerIndex) :
+				nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+			{
+				std::lock_guard lock(queues[queueIndex]->mutex);
+				queues[queueIndex]->entries.push_back({ std::move(job), &counter });
+			}
+			{
+				std::lock_guard lock(sleepMutex);
+				queued.fetch_add(1, std::memory_order_release);
+			}
+			wake.notify_one();
+		}
+
+		// returns once every job run against counter has finished, rethrowing the first error
+		void wait(Counter& counter)
+		{
+			while (!counter.done()) {
+				if (!runOne()) {
+					std::this_thread::yield();
+				}
+			}
+			if (counter.error) {
+				std::exception_ptr error = counter.error;
+				counter.error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+
+		// calls body(begin, end) over [0, count) in ranges of at most grain and waits for them
+		template<typename Body>
+		void parallelFor(size_t count, size_t grain, Body&& body)
+		{
+			grain = std::max<size_t>(grain, 1);
+			if (count <= grain) {
+				if (count > 0) {
+					body(size_t(0), count);
+				}
+				return;
+			}
+
+			Counter counter;
+			for (size_t begin = 0; begin < count; begin += grain) {
+				const size_t end = std::min(begin + grain, count);
+				run(counter, [&body, begin, end] { body(begin, end); });
+			}
+			wait(counter);
+		}
+
+	private:
+		bool tryPop(Entry& entry)
+		{
+			const size_t queueCount = queues.size();
+			const size_t home = workerIndex >= 0 ? static_cast<size_t>(workerIndex) : 0;
+
+			if (workerIndex >= 0) {
+				Queue& own = *queues[home];
+				std::lock_guard lock(own.mutex);
+				if (!own.entries.empty()) {
+					entry = std::move(own.entries.back());
+					own.entries.pop_back();
+					return true;
+				}
+			}
+			for (size_t offset = 1; offset <= queueCount; ++offset) {
+				Queue& victim = *queues[(home + offset) % queueCount];
+				std::lock_guard lock(victim.mutex);
+				if (!victim.entries.empty()) {
+					entry = std::move(victim.entries.front());
+					victim.entries.pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool runOne()
+		{
+			Entry entry;
+			if (!tryPop(entry)) {
+				return false;
+			}
+			queued.fetch_sub(1, std::memory_order_relaxed);
+
+			try {
+				entry.job();
+			}
+			catch (...) {
+				std::lock_guard lock(entry.counter->errorMutex);
+				if (!entry.counter->error) {
+					entry.counter->error = std::current_exception();
+				}
+			}
+			entry.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+			return true;
+		}
+
+		void workerLoop(int index)
+		{
+			workerIndex = index;
+			for (;;) {
+				if (runOne()) {
+					continue;
+				}
+				std::unique_lock lock(sleepMutex);
+				wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+				if (stopping) {
+					return;
+				}
+			}
+		}
+	};
+}
@@ -1,7 +1,16 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <unordered_map>
 #include <glm/glm.hpp>
 
@@ -9,28 +18,113 @@
 
 #include <meshoptimizer.h>
 
+#include "app/ClusterDag.h"
+#include "app/JobSystem.h"
+#include "app/ObjLoader.h"
+#include "app/VertexDedup.h"
 #include "app/Vertex.h"
 
 struct LodConfigData
 {
-    float maxDist;
+    // how far, in model units, the simplified surface may lie from the full detail one. Never
+    // less than the previous LOD's, so the cull can take the last LOD within its error budget
+    float error;
     uint32_t offset;
     uint32_t size;
-    const uint32_t padding = 0;
+    // each LOD indexes its own range of the vertex buffer, this is where the range starts
+    int32_t vertexOffset;
+};
+
+// one cluster of the continuous LOD hierarchy, see mc::ClusterDag. Spheres are in model space,
+// xyz the centre and w the radius, around the geometry the error beside them is for
+struct ClusterData
+{
+    glm::vec4 selfSphere;
+    // the group the cluster was simplified in to, which a root never was
+    glm::vec4 parentSphere;
+    float selfError;
+    float parentError;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// how Model::generateLOD builds its chain. Each level aims for fewer triangles and allows
+// more error than the one before, and the chain ends at whichever budget runs out first. Errors
+// are relative to the mesh's extent, as meshopt_simplify takes them
+struct LodSchedule
+{
+    // LOD 1's error, every level after multiplies it by error_growth
+    float first_error = 0.0025f;
+    float error_growth = 2.0f;
+    // no level is planned past this error
+    float max_error = 0.2f;
+    // each level aims for this fraction of the previous level's triangles
+    float triangle_ratio = 0.5f;
+    // or stops at this many
+    size_t min_triangles = 64;
+    size_t max_levels = 16;
+    // texture coordinates and normals hold the simplifier back, by less at every level. A far
+    // LOD is a few pixels across, where seams and shading matter far less than silhouette
+    float attribute_weight = 1.0f;
+    float attribute_weight_falloff = 0.5f;
+};
+
+// what Model::loadModel is doing, for a loading screen or log on another thread
+enum class ModelLoadStage : uint32_t
+{
+    Idle,
+    Parse,
+    Dedup,
+    Remap,
+    Lod,
+    Done,
+};
+
+// wall time of each loadModel stage
+struct ModelLoadTimings
+{
+    double parseMs = 0.0;
+    double dedupMs = 0.0;
+    double remapMs = 0.0;
+    double lodMs = 0.0;
 };
 
-template<uint32_t total_lod_levels>
 class Model
 {
-    //constexpr static uint32_t total_lod_levels = 5;
+    LodSchedule lod_schedule;
 
 	std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    // indices again, packed to 16 bits when every LOD's vertex range is small enough. Padded to
+    // a whole number of 32 bit words for the shaders that read it as a storage buffer
+    std::vector<uint16_t> indices_16;
     std::vector<uint32_t> lod_indices_offsets;
     std::vector<uint32_t> lod_indices_sizes;
-    std::vector<float> lod_max_distances;
+    std::vector<int32_t> lod_vertex_offsets;
+    std::vector<float> lod_errors;
+    // the cluster hierarchy's indices follow every LOD's in indices, from here
+    uint32_t cluster_indices_offset = 0;
+    std::vector<ClusterData> clusters;
+    // the full detail clusters
+    uint32_t max_cluster_cut = 0;
+
+    std::atomic<ModelLoadStage> load_stage{ ModelLoadStage::Idle };
+    // how far through the parse the chunks are, 0 to 1
+    std::atomic<float> parse_progress{ 0.0f };
+    ModelLoadTimings load_timings;
+
+    using clock = std::chrono::steady_clock;
+
+    static double elapsedMs(clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
 
 public:
+    explicit Model(LodSchedule schedule = {}) :
+        lod_schedule(schedule)
+    {
+    }
 
     float Ns;
     float Ni;
@@ -46,116 +140,60 @@ public:
     float diffuse = 0.5f;
     float ambient = 0.2f;
 
+    // the OBJ is parsed and its vertices deduplicated across the job system's workers, see
+    // ObjLoader.h and VertexDedup.h. Safe to run for several models at once, see loadModels
 	void loadModel(std::filesystem::path const & model_path)
     {
-        tinyobj::ObjReaderConfig reader_config;
-        //reader_config.mtl_search_path = "..\\assets"; // Path to material files
+        mc::JobSystem& jobSystem = mc::JobSystem::get();
+
+        load_stage = ModelLoadStage::Parse;
+        parse_progress = 0.0f;
+        auto stage_start = clock::now();
+        mc::ObjMesh const mesh = mc::ObjLoader::parse(model_path, jobSystem, &parse_progress);
+        loadMaterial(model_path, mesh);
+        load_timings.parseMs = elapsedMs(stage_start);
+
+        load_stage = ModelLoadStage::Dedup;
+        stage_start = clock::now();
+        std::vector<Vertex> const stream = mc::ObjLoader::buildCornerStream(mesh, jobSystem);
+        std::vector<uint32_t> const first_uses = mc::VertexDedup::findFirstUses(stream, jobSystem);
+        load_timings.dedupMs = elapsedMs(stage_start);
+
+        load_stage = ModelLoadStage::Remap;
+        stage_start = clock::now();
+        mc::VertexDedup::compact(stream, first_uses, jobSystem, vertices, indices);
+        load_timings.remapMs = elapsedMs(stage_start);
 
-        tinyobj::ObjReader reader;
+        generateLOD();
 
-        if (!reader.ParseFromFile(model_path.generic_string(), reader_config)) {
-            if (!reader.Error().empty()) {
-                std::cerr << "TinyObjReader: " << reader.Error();
-            }
-            exit(1);
-        }
+        load_stage = ModelLoadStage::Done;
+    }
 
-        if (!reader.Warning().empty()) {
-            std::cout << "TinyObjReader: " << reader.Warning();
+    // each model loads on its own job and the stages inside share the same workers
+    static void loadModels(std::vector<std::pair<Model*, std::filesystem::path>> const& models)
+    {
+        mc::JobSystem& jobSystem = mc::JobSystem::get();
+        mc::JobSystem::Counter counter;
+        for (auto const& [model, model_path] : models)
+        {
+            jobSystem.run(counter, [model, model_path] { model->loadModel(model_path); });
         }
+        jobSystem.wait(counter);
+    }
 
-        auto& attrib = reader.GetAttrib();
-        auto& shapes = reader.GetShapes();
-        auto& materials = reader.GetMaterials();
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-        for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                Vertex vertex{};
-
-                vertex.pos = {
-                    attrib.vertices[3 * index.vertex_index + 0] * 1.0,
-                    attrib.vertices[3 * index.vertex_index + 1] * 1.0,
-                    attrib.vertices[3 * index.vertex_index + 2] * 1.0
-                };
-
-                if (index.texcoord_index >= 0)
-                {
-                    vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    attrib.texcoords[2 * index.texcoord_index + 1]
-                    };
-
-                }
-                else
-                {
-                    vertex.texCoord = { 0, 0 };
-                }
-
-                vertex.color = { 1.0f, 1.0f, 1.0f };
-
-
-                vertex.norm = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-                };
-
-                vertex.norm = glm::normalize(vertex.norm);
-
-                if (uniqueVertices.count(vertex) == 0) {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                    vertices.push_back(vertex);
-                }
-
-                indices.push_back(uniqueVertices[vertex]);
-            }
-
-            if (!materials.empty())
-            {
-                Ns = materials[shape.mesh.material_ids[0]].shininess;
-                Ni = 1.0f;
-                d = materials[shape.mesh.material_ids[0]].dissolve;
-                Tr = 1.0f - d;
-                Tf = glm::vec3(1.0f, 1.0f, 1.0f);
-                illum = static_cast<float>(materials[shape.mesh.material_ids[0]].illum);
-                Ka = glm::vec3(materials[shape.mesh.material_ids[0]].ambient[0],
-                    materials[shape.mesh.material_ids[0]].ambient[1],
-                    materials[shape.mesh.material_ids[0]].ambient[2]);
-                Kd = glm::vec3(materials[shape.mesh.material_ids[0]].diffuse[0],
-                    materials[shape.mesh.material_ids[0]].diffuse[1],
-                    materials[shape.mesh.material_ids[0]].diffuse[2]);
-                Ks = glm::vec3(materials[shape.mesh.material_ids[0]].specular[0],
-                    materials[shape.mesh.material_ids[0]].specular[1],
-                    materials[shape.mesh.material_ids[0]].specular[2]);
-                Ke = glm::vec3(materials[shape.mesh.material_ids[0]].emission[0],
-                    materials[shape.mesh.material_ids[0]].emission[1],
-                    materials[shape.mesh.material_ids[0]].emission[2]);
-            }
-            else
-            {
-                Ns = 0.0;
-                Ni = 1.0f;
-                d = 0.0;
-                Tr = 1.0f - d;
-                Tf = glm::vec3(1.0f, 1.0f, 1.0f);
-                illum = 0.0;
-                Ka = glm::vec3(0.2, 0.2, 0.2);
-                Kd = glm::vec3(0.7, 0.7, 0.7);
-                Ks = glm::vec3(0.2, 0.2, 0.2);
-                Ke = glm::vec3(0.0, 0.0, 0.0);
-            }
-        }
+    ModelLoadStage getLoadStage() const
+    {
+        return load_stage;
+    }
 
-        float maxDist = 0.0f;
-        for (auto const& vertex : vertices)
-        {
-            maxDist = std::max(maxDist, glm::length(vertex.pos));
-        }
-        std::cout << "MAX DISTTTTTT: " << maxDist << std::endl;
+    float getParseProgress() const
+    {
+        return parse_progress;
+    }
 
-        generateLOD();
+    ModelLoadTimings const& getLoadTimings() const
+    {
+        return load_timings;
     }
 
 	std::vector<Vertex> const& getVertices() const
@@ -163,122 +201,346 @@ public:
         return vertices;
 	}
 
+    // relative to each LOD's vertex offset, see LodConfigData. Always 32 bit, for counting
+    // and CPU side use. The GPU copy is getIndexData
     std::vector<uint32_t> const& getIndices() const
     {
         return indices;
     }
 
-    constexpr uint32_t getTotalLodLevels() const
+    VkIndexType getIndexType() const
+    {
+        return indices_16.empty() ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    }
+
+    // the index buffer as uploaded, in getIndexType's format
+    void const* getIndexData() const
+    {
+        return indices_16.empty() ? static_cast<void const*>(indices.data()) : static_cast<void const*>(indices_16.data());
+    }
+
+    size_t getIndexDataSize() const
+    {
+        return indices_16.empty() ? indices.size() * sizeof(uint32_t) : indices_16.size() * sizeof(uint16_t);
+    }
+
+    // however long the schedule made the chain, at least 1
+    uint32_t getTotalLodLevels() const
     {
-        return total_lod_levels;
+        return static_cast<uint32_t>(lod_errors.size());
     }
 
     std::vector<LodConfigData> getLodConfigData() const
     {
         std::vector<LodConfigData> lodConfigDataTempVec;
 
-        for (size_t i = 0; i < total_lod_levels; ++i)
+        for (size_t i = 0; i < lod_errors.size(); ++i)
         {
-            lodConfigDataTempVec.emplace_back(lod_max_distances[i], lod_indices_offsets[i], lod_indices_sizes[i]);
+            lodConfigDataTempVec.emplace_back(lod_errors[i], lod_indices_offsets[i], lod_indices_sizes[i], lod_vertex_offsets[i]);
         }
 
         return lodConfigDataTempVec;
     }
 
-    std::vector<float>& getMaxDistances()
+    std::vector<float> const& getLodErrors() const
     {
-        return lod_max_distances;
+        return lod_errors;
     }
 
-    template<size_t lod_level>
-    uint32_t getIndicesOffset() const
+    uint32_t getIndicesOffset(size_t lod_level) const
 	{
-        //return lod_indices[lod_level];
-        return lod_indices_offsets[total_lod_levels - 1];
+        return lod_indices_offsets[lod_level];
 	}
 
-    template<size_t lod_level>
-    uint32_t const& getIndicesSize() const
+    uint32_t getIndicesSize(size_t lod_level) const
+    {
+        return lod_indices_sizes[lod_level];
+    }
+
+    // everything before it is the discrete LOD chain
+    uint32_t getClusterIndicesOffset() const
+    {
+        return cluster_indices_offset;
+    }
+
+    std::vector<ClusterData> const& getClusterData() const
+    {
+        return clusters;
+    }
+
+    // the most clusters any cut through the hierarchy draws, see mc::ClusterDag
+    uint32_t getMaxClusterCut() const
     {
-        //return lod_indices[lod_level];
-        return lod_indices_sizes[total_lod_levels - 1];
+        return max_cluster_cut;
     }
 private:
-    void generateLOD()
+    // the mtllib files are small, so tinyobjloader's own reader is kept for them. The material
+    // of the first usemtl is used, as the first shape's was before
+    void loadMaterial(std::filesystem::path const& model_path, mc::ObjMesh const& mesh)
     {
-        std::array<std::vector<uint32_t>, total_lod_levels> lod_indices;
-        lod_indices[0] = indices;
+        std::vector<tinyobj::material_t> materials;
+        std::map<std::string, int> material_map;
+        for (auto const& library : mesh.materialLibraries)
+        {
+            std::ifstream material_file(model_path.parent_path() / library);
+            if (!material_file.is_open())
+            {
+                std::cout << "TinyObjReader: material library not found: " << library << std::endl;
+                continue;
+            }
+            std::string warning;
+            std::string error;
+            tinyobj::LoadMtl(&material_map, &materials, &material_file, &warning, &error);
+            if (!warning.empty())
+            {
+                std::cout << "TinyObjReader: " << warning;
+            }
+        }
 
-        size_t index_count = lod_indices[0].size();
-        std::vector<unsigned int> remap(index_count); // allocate temporary memory for the remap table
-        size_t vertex_count = meshopt_generateVertexRemap(remap.data(), lod_indices[0].data(), index_count, vertices.data(), vertices.size(), sizeof(Vertex));
+        if (!materials.empty())
+        {
+            auto const named = material_map.find(mesh.material);
+            auto const& material = materials[named != material_map.end() ? named->second : 0];
+            Ns = material.shininess;
+            Ni = 1.0f;
+            d = material.dissolve;
+            Tr = 1.0f - d;
+            Tf = glm::vec3(1.0f, 1.0f, 1.0f);
+            illum = static_cast<float>(material.illum);
+            Ka = glm::vec3(material.ambient[0], material.ambient[1], material.ambient[2]);
+            Kd = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+            Ks = glm::vec3(material.specular[0], material.specular[1], material.specular[2]);
+            Ke = glm::vec3(material.emission[0], material.emission[1], material.emission[2]);
+        }
+        else
+        {
+            Ns = 0.0;
+            Ni = 1.0f;
+            d = 0.0;
+            Tr = 1.0f - d;
+            Tf = glm::vec3(1.0f, 1.0f, 1.0f);
+            illum = 0.0;
+            Ka = glm::vec3(0.2, 0.2, 0.2);
+            Kd = glm::vec3(0.7, 0.7, 0.7);
+            Ks = glm::vec3(0.2, 0.2, 0.2);
+            Ke = glm::vec3(0.0, 0.0, 0.0);
+        }
+    }
 
-        meshopt_remapIndexBuffer(lod_indices[0].data(), lod_indices[0].data(), index_count, remap.data());
-        meshopt_remapVertexBuffer(vertices.data(), vertices.data(), vertex_count, sizeof(Vertex), remap.data());
+    // the chain is planned from lod_schedule up front, so every LOD can still be simplified
+    // from the full mesh on its own job. Levels the simplifier could not reduce much below the
+    // level before are dropped. Each kept LOD then gets its own vertex range, holding only the
+    // vertices it uses in the order it first uses them, so a far LOD reads a few kilobytes of
+    // vertices rather than picking its way through the whole buffer. Triangles are ordered for
+    // the post transform cache and then for overdraw before the vertices are, as meshoptimizer
+    // recommends. LOD 0 is also built in to a cluster hierarchy, whose indices are appended
+    // after the chain's
+    void generateLOD()
+    {
+        // loadModel already left the vertices unique and in first use order
+        std::vector<uint32_t> const source_indices = std::move(indices);
+        size_t index_count = source_indices.size();
+        size_t vertex_count = vertices.size();
 
-        std::cout << "| lod_level | threshold | target_index_count | target_error | new_index_count | lod_error |" << std::endl;
+        load_stage = ModelLoadStage::Lod;
+        auto stage_start = clock::now();
 
-        for (size_t lod_level = 0; lod_level < static_cast<float>(lod_indices.size()) - 1; ++lod_level)
+        struct LodTarget
         {
-            size_t lod_index = lod_indices.size() - 1 - lod_level;
+            size_t index_count;
+            float error;
+            float attribute_weight;
+        };
+
+        std::vector<LodTarget> targets{ { index_count, 0.0f, lod_schedule.attribute_weight } };
+        for (size_t lod_level = 1; lod_level < lod_schedule.max_levels; ++lod_level)
+        {
+            float const target_error = lod_schedule.first_error * std::pow(lod_schedule.error_growth, static_cast<float>(lod_level - 1));
+            size_t const target_triangles = static_cast<size_t>(static_cast<float>(index_count / 3) * std::pow(lod_schedule.triangle_ratio, static_cast<float>(lod_level)));
+            if (target_error > lod_schedule.max_error || target_triangles < lod_schedule.min_triangles)
+            {
+                break;
+            }
+            targets.push_back({
+                target_triangles * 3,
+                target_error,
+                lod_schedule.attribute_weight * std::pow(lod_schedule.attribute_weight_falloff, static_cast<float>(lod_level - 1)) });
+        }
+
+        // texture coordinates then normals, which sit next to each other in Vertex
+        static_assert(offsetof(Vertex, norm) == offsetof(Vertex, texCoord) + sizeof(glm::vec2));
+        constexpr size_t attribute_count = 5;
 
-            float threshold_lower_bound = 3000.0f / static_cast<float>(index_count);
-            float threshold = threshold_lower_bound + (((1.0f / static_cast<float>(lod_indices.size())) * static_cast<float>(lod_level)) * (1.0f - threshold_lower_bound));
-            size_t target_index_count = size_t(index_count * threshold);
-            float target_error = 0.02f;
+        std::vector<std::vector<uint32_t>> planned_indices(targets.size());
+        std::vector<float> planned_errors(targets.size(), 0.0f);
 
-            lod_indices[lod_index].resize(lod_indices[0].size());
-            float lod_error = 0.f;
-            lod_indices[lod_index].resize(
+        mc::JobSystem& jobSystem = mc::JobSystem::get();
+        jobSystem.parallelFor(targets.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t lod_level = begin; lod_level < end; ++lod_level)
+            {
+                std::vector<uint32_t>& curr_lod_indices = planned_indices[lod_level];
+                if (lod_level == 0)
+                {
+                    curr_lod_indices = source_indices;
+                    continue;
+                }
+
+                LodTarget const& target = targets[lod_level];
+                float const texcoord_weight = target.attribute_weight;
+                float const normal_weight = target.attribute_weight * 0.5f;
+                std::array<float, attribute_count> const attribute_weights = {
+                    texcoord_weight, texcoord_weight, normal_weight, normal_weight, normal_weight };
+
+                curr_lod_indices.resize(index_count);
+                curr_lod_indices.resize(
+                    meshopt_simplifyWithAttributes(
+                        curr_lod_indices.data(),
+                        source_indices.data(),
+                        index_count,
+                        &(vertices[0].pos.x),
+                        vertex_count,
+                        sizeof(Vertex),
+                        &(vertices[0].texCoord.x),
+                        sizeof(Vertex),
+                        attribute_weights.data(),
+                        attribute_count,
+                        nullptr,
+                        target.index_count,
+                        target.error,
+                        0,
+                        nullptr));
+
+                // the error the attribute aware pass reports includes how far the texture
+                // coordinates and normals moved, which is not a distance on the surface and
+                // would push every level's switch out. The cull's budget is in pixels of surface
+                // movement, so the error kept is what a position only pass reaches at the same
+                // triangle count
+                std::vector<uint32_t> position_only_indices(index_count);
                 meshopt_simplify(
-                    lod_indices[lod_index].data(),
-                    lod_indices[0].data(),
-                    lod_indices[0].size(),
+                    position_only_indices.data(),
+                    source_indices.data(),
+                    index_count,
                     &(vertices[0].pos.x),
                     vertex_count,
                     sizeof(Vertex),
-                    target_index_count,
-                    target_error,
+                    curr_lod_indices.size(),
+                    std::numeric_limits<float>::max(),
                     0,
-                    &lod_error));
+                    &planned_errors[lod_level]);
+            }
+        });
 
-            /*
-            std::cout << std::format("| {:^9} | {:.7f} | {:>18} | {:.10f} | {:>15} | {:.7f} |",
-                lod_index,
-                threshold,
-                target_index_count,
-                target_error,
-                lod_indices[lod_index].size(),
-                lod_error) << std::endl;
-            */
+        std::vector<size_t> kept_levels{ 0 };
+        for (size_t lod_level = 1; lod_level < targets.size(); ++lod_level)
+        {
+            // a level with nine tenths of the last one's triangles costs a draw and saves nothing
+            if (planned_indices[lod_level].size() * 10 < planned_indices[kept_levels.back()].size() * 9)
+            {
+                kept_levels.push_back(lod_level);
+            }
         }
 
-        /*
-        std::cout << std::format("| {:^9} | {:.7f} | {:>18} | {:.10f} | {:>15} | {:.7f} |",
-            0,
-            1.0f,
-            index_count,
-            0.0f,
-            index_count,
-            0.0f) << std::endl;
-        */
+        std::vector<std::vector<uint32_t>> lod_indices(kept_levels.size());
+        std::vector<std::vector<Vertex>> lod_vertices(kept_levels.size());
+        std::vector<float> lod_relative_errors(kept_levels.size());
+        for (size_t lod_index = 0; lod_index < kept_levels.size(); ++lod_index)
+        {
+            lod_indices[lod_index] = std::move(planned_indices[kept_levels[lod_index]]);
+            lod_relative_errors[lod_index] = planned_errors[kept_levels[lod_index]];
+        }
+
+        jobSystem.parallelFor(lod_indices.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t lod_index = begin; lod_index < end; ++lod_index)
+            {
+                std::vector<uint32_t>& curr_lod_indices = lod_indices[lod_index];
+
+                meshopt_optimizeVertexCache(curr_lod_indices.data(), curr_lod_indices.data(), curr_lod_indices.size(), vertex_count);
+                meshopt_optimizeOverdraw(curr_lod_indices.data(), curr_lod_indices.data(), curr_lod_indices.size(),
+                    &(vertices[0].pos.x), vertex_count, sizeof(Vertex), 1.05f);
+
+                // rewrites the indices to count from the start of the LOD's own range
+                lod_vertices[lod_index].resize(vertex_count);
+                lod_vertices[lod_index].resize(
+                    meshopt_optimizeVertexFetch(
+                        lod_vertices[lod_index].data(),
+                        curr_lod_indices.data(),
+                        curr_lod_indices.size(),
+                        vertices.data(),
+                        vertex_count,
+                        sizeof(Vertex)));
+            }
+        });
+
+        // refines LOD 0, so its clusters index LOD 0's vertex range, which always starts at 0
+        std::vector<mc::ClusterDag::Cluster> const cluster_dag = mc::ClusterDag::build(
+            lod_indices[0], &(lod_vertices[0][0].pos.x), lod_vertices[0].size(), sizeof(Vertex), jobSystem);
+
+        // meshopt_simplify's error is relative to the mesh's extent
+        float const error_scale = meshopt_simplifyScale(&(vertices[0].pos.x), vertex_count, sizeof(Vertex));
+
+        vertices.clear();
         indices.clear();
 
-        float cuur_max_dist = 8.0f;
+        std::cout << "| lod_level | index_count | vertex_count | error |" << std::endl;
+
+        lod_indices_offsets.clear();
+        lod_indices_sizes.clear();
+        lod_vertex_offsets.clear();
+        lod_errors.clear();
 
-        for (auto const& curr_lod_indices : lod_indices)
+        for (size_t lod_index = 0; lod_index < lod_indices.size(); ++lod_index)
         {
             lod_indices_offsets.push_back(indices.size());
-            lod_indices_sizes.push_back(curr_lod_indices.size());
-            lod_max_distances.push_back(cuur_max_dist);
+            lod_indices_sizes.push_back(lod_indices[lod_index].size());
+            lod_vertex_offsets.push_back(static_cast<int32_t>(vertices.size()));
+            lod_errors.push_back(std::max(lod_relative_errors[lod_index] * error_scale, lod_index > 0 ? lod_errors.back() : 0.0f));
 
-            cuur_max_dist += 2.0f;
+            std::cout << std::format("| {:^9} | {:>11} | {:>12} | {:.5f} |",
+                lod_index,
+                lod_indices[lod_index].size(),
+                lod_vertices[lod_index].size(),
+                lod_errors.back()) << std::endl;
 
-            indices.insert(indices.end(), curr_lod_indices.begin(), curr_lod_indices.end());
+            indices.insert(indices.end(), lod_indices[lod_index].begin(), lod_indices[lod_index].end());
+            vertices.insert(vertices.end(), lod_vertices[lod_index].begin(), lod_vertices[lod_index].end());
+        }
+
+        cluster_indices_offset = static_cast<uint32_t>(indices.size());
+        clusters.clear();
+        max_cluster_cut = 0;
+        uint32_t cluster_levels = 0;
+        for (auto const& cluster : cluster_dag)
+        {
+            clusters.push_back({
+                glm::vec4(cluster.self.center, cluster.self.radius),
+                glm::vec4(cluster.parent.center, cluster.parent.radius),
+                cluster.self.error,
+                cluster.parent.error,
+                static_cast<uint32_t>(indices.size()),
+                static_cast<uint32_t>(cluster.indices.size()) });
+            indices.insert(indices.end(), cluster.indices.begin(), cluster.indices.end());
+            cluster_levels = std::max(cluster_levels, cluster.depth + 1);
+            max_cluster_cut += cluster.depth == 0 ? 1 : 0;
+        }
+
+        std::cout << "cluster hierarchy: " << clusters.size() << " clusters over " << cluster_levels << " levels, "
+            << (indices.size() - cluster_indices_offset) / 3 << " triangles" << std::endl;
+
+        // the ranges are indexed from their own start, so usually only the full detail LOD of a
+        // big mesh can need more than 16 bits
+        bool const fits_16 = std::all_of(lod_vertices.begin(), lod_vertices.end(),
+            [](std::vector<Vertex> const& range) { return range.size() <= std::numeric_limits<uint16_t>::max() + size_t(1); });
+        indices_16.clear();
+        if (fits_16)
+        {
+            indices_16.assign(indices.begin(), indices.end());
+            indices_16.resize((indices_16.size() + 1) & ~size_t(1), 0);
         }
 
-        lod_max_distances.back() = 50.0f;
+        load_timings.lodMs = elapsedMs(stage_start);
 
-        std::cout << "total indices: " << indices.size() << std::endl;;
+        std::cout << "total indices: " << indices.size() << " (" << (fits_16 ? 16 : 32) << " bit), total vertices: " << vertices.size() << std::endl;
     }
 };
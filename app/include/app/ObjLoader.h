@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "app/JobSystem.h"
+#include "app/Vertex.h"
+
+namespace mc
+{
+	// the parts of an OBJ file the renderer uses, faces already split in to triangles
+	struct ObjMesh
+	{
+		// indices in to the attribute arrays for one triangle corner, -1 where the face gave none
+		struct Corner
+		{
+			int32_t position;
+			int32_t texcoord;
+			int32_t normal;
+		};
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texcoords;
+		std::vector<glm::vec3> normals;
+		std::vector<Corner> corners;
+		std::vector<std::string> materialLibraries;
+		// the first usemtl in the file, empty if there is none
+		std::string material;
+	};
+
+	// parses an OBJ in chunks of whole lines on the job system. Each chunk collects its own
+	// attributes and faces, and a prefix sum over the chunk counts then places them in the
+	// merged arrays, turning relative (negative) face indices in to absolute ones on the way.
+	// A face index outside the merged arrays throws with the file and line it was on. progress,
+	// if given, rises from 0 to 1 as chunks finish
+	class ObjLoader
+	{
+		static constexpr size_t chunkSize = 1 << 20;
+
+		struct Chunk
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec2> texcoords;
+			std::vector<glm::vec3> normals;
+			std::vector<ObjMesh::Corner> corners;
+			// per corner, which of position, texcoord and normal count back from this chunk's
+			// start and still need the earlier chunks' counts adding
+			std::vector<uint8_t> relative;
+			// per triangle, the line in this chunk its face was on, for errors
+			std::vector<uint32_t> triangleLines;
+			size_t lineCount = 0;
+			std::vector<std::string> materialLibraries;
+			std::string material;
+		};
+
+	public:
+		static ObjMesh parse(const std::filesystem::path& path, JobSystem& jobSystem, std::atomic<float>* progress = nullptr)
+		{
+			std::ifstream file(path, std::ios::ate | std::ios::binary);
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to open model: " + path.string());
+			}
+			std::string text(static_cast<size_t>(file.tellg()), '\0');
+			file.seekg(0);
+			file.read(text.data(), static_cast<std::streamsize>(text.size()));
+
+			// chunk boundaries pushed forward to the next line start
+			std::vector<size_t> bounds{ 0 };
+			while (bounds.back() < text.size()) {
+				size_t end = std::min(bounds.back() + chunkSize, text.size());
+				while (end < text.size() && text[end - 1] != '\n') {
+					++end;
+				}
+				bounds.push_back(end);
+			}
+			const size_t chunkCount = bounds.size() - 1;
+
+			std::vector<Chunk> chunks(chunkCount);
+			std::atomic<size_t> chunksDone{ 0 };
+			jobSystem.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					parseChunk(std::string_view(text).substr(bounds[i], bounds[i + 1] - bounds[i]), chunks[i]);
+					if (progress) {
+						*progress = static_cast<float>(++chunksDone) / static_cast<float>(chunkCount);
+					}
+				}
+			});
+
+			// where each chunk's attributes, corners and lines start in the merged arrays and file
+			std::vector<std::array<size_t, 5>> starts(chunkCount + 1, { 0, 0, 0, 0, 0 });
+			for (size_t i = 0; i < chunkCount; ++i) {
+				starts[i + 1] = {
+					starts[i][0] + chunks[i].positions.size(),
+					starts[i][1] + chunks[i].texcoords.size(),
+					starts[i][2] + chunks[i].normals.size(),
+					starts[i][3] + chunks[i].corners.size(),
+					starts[i][4] + chunks[i].lineCount };
+			}
+
+			ObjMesh mesh;
+			mesh.positions.resize(starts[chunkCount][0]);
+			mesh.texcoords.resize(starts[chunkCount][1]);
+			mesh.normals.resize(starts[chunkCount][2]);
+			mesh.corners.resize(starts[chunkCount][3]);
+
+			jobSystem.parallelFor(chunkCount, 1, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					const Chunk& chunk = chunks[i];
+					std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + starts[i][0]);
+					std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh.texcoords.begin() + starts[i][1]);
+					std::copy(chunk.normals.begin(), chunk.normals.end(), mesh.normals.begin() + starts[i][2]);
+
+					for (size_t c = 0; c < chunk.corners.size(); ++c) {
+						ObjMesh::Corner corner = chunk.corners[c];
+						const uint8_t relative = chunk.relative[c];
+						corner.position += (relative & 1) ? static_cast<int32_t>(starts[i][0]) : 0;
+						corner.texcoord += (relative & 2) ? static_cast<int32_t>(starts[i][1]) : 0;
+						corner.normal += (relative & 4) ? static_cast<int32_t>(starts[i][2]) : 0;
+						if (!inRange(corner.position, mesh.positions.size(), true) ||
+							!inRange(corner.texcoord, mesh.texcoords.size(), relative & 2) ||
+							!inRange(corner.normal, mesh.normals.size(), relative & 4)) {
+							const size_t line = starts[i][4] + chunk.triangleLines[c / 3] + 1;
+							throw std::runtime_error(path.string() + ":" + std::to_string(line) + ": face index out of range");
+						}
+						mesh.corners[starts[i][3] + c] = corner;
+					}
+				}
+			});
+
+			for (const Chunk& chunk : chunks) {
+				mesh.materialLibraries.insert(mesh.materialLibraries.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+				if (mesh.material.empty()) {
+					mesh.material = chunk.material;
+				}
+			}
+
+			return mesh;
+		}
+
+		// the unindexed vertex of every triangle corner, for VertexDedup to index
+		static std::vector<Vertex> buildCornerStream(const ObjMesh& mesh, JobSystem& jobSystem)
+		{
+			std::vector<Vertex> stream(mesh.corners.size());
+			jobSystem.parallelFor(stream.size(), 1 << 16, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					stream[i] = makeVertex(mesh, mesh.corners[i]);
+				}
+			});
+			return stream;
+		}
+
+	private:
+		static Vertex makeVertex(const ObjMesh& mesh, const ObjMesh::Corner& corner)
+		{
+			Vertex vertex{};
+			vertex.pos = mesh.positions[corner.position];
+			vertex.texCoord = corner.texcoord >= 0 ? mesh.texcoords[corner.texcoord] : glm::vec2(0.0f);
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+			vertex.norm = corner.normal >= 0 ? glm::normalize(mesh.normals[corner.normal]) : glm::vec3(0.0f, 1.0f, 0.0f);
+			return vertex;
+		}
+
+		static void skipSpaces(const char*& it, const char* end)
+		{
+			while (it < end && (*it == ' ' || *it == '\t')) {
+				++it;
+			}
+		}
+
+		static float parseFloat(const char*& it, const char* end)
+		{
+			skipSpaces(it, end);
+			float value = 0.0f;
+			const auto result = std::from_chars(it, end, value);
+			it = result.ptr;
+			return value;
+		}
+
+		static std::string_view parseName(const char*& it, const char* end)
+		{
+			skipSpaces(it, end);
+			const char* begin = it;
+			while (it < end && *it != '\r' && *it != '\n') {
+				++it;
+			}
+			const char* last = it;
+			while (last > begin && (last[-1] == ' ' || last[-1] == '\t')) {
+				--last;
+			}
+			return std::string_view(begin, static_cast<size_t>(last - begin));
+		}
+
+		// OBJ indices start at 1 and count back from the latest attribute when negative.
+		// Relative ones are resolved against this chunk and marked for the merge to finish. 0
+		// is no index at all, and is marked relative from far enough below any start that the
+		// merge still finds it out of range
+		static int32_t resolveIndex(int32_t index, size_t chunkCount, uint8_t bit, uint8_t& relative)
+		{
+			if (index > 0) {
+				return index - 1;
+			}
+			relative |= bit;
+			if (index == 0) {
+				return std::numeric_limits<int32_t>::min();
+			}
+			return static_cast<int32_t>(chunkCount) + index;
+		}
+
+		// -1 is also a texcoord or normal the face left out, unless the face gave one that
+		// resolved there
+		static bool inRange(int32_t index, size_t count, bool given)
+		{
+			return index >= 0 ? static_cast<size_t>(index) < count : index == -1 && !given;
+		}
+
+		static void parseChunk(std::string_view text, Chunk& chunk)
+		{
+			const char* it = text.data();
+			const char* end = text.data() + text.size();
+
+			std::vector<ObjMesh::Corner> face;
+			std::vector<uint8_t> faceRelative;
+
+			while (it < end) {
+				skipSpaces(it, end);
+				const char* lineEnd = static_cast<const char*>(std::memchr(it, '\n', static_cast<size_t>(end - it)));
+				lineEnd = lineEnd ? lineEnd : end;
+
+				const std::string_view line(it, static_cast<size_t>(lineEnd - it));
+				if (line.starts_with("v ") || line.starts_with("v\t")) {
+					it += 2;
+					const float x = parseFloat(it, lineEnd);
+					const float y = parseFloat(it, lineEnd);
+					const float z = parseFloat(it, lineEnd);
+					chunk.positions.emplace_back(x, y, z);
+				}
+				else if (line.starts_with("vt ") || line.starts_with("vt\t")) {
+					it += 3;
+					const float u = parseFloat(it, lineEnd);
+					const float v = parseFloat(it, lineEnd);
+					chunk.texcoords.emplace_back(u, v);
+				}
+				else if (line.starts_with("vn ") || line.starts_with("vn\t")) {
+					it += 3;
+					const float x = parseFloat(it, lineEnd);
+					const float y = parseFloat(it, lineEnd);
+					const float z = parseFloat(it, lineEnd);
+					chunk.normals.emplace_back(x, y, z);
+				}
+				else if (line.starts_with("f ") || line.starts_with("f\t")) {
+					it += 2;
+					face.clear();
+					faceRelative.clear();
+					for (;;) {
+						skipSpaces(it, lineEnd);
+						if (it >= lineEnd || *it == '\r') {
+							break;
+						}
+
+						ObjMesh::Corner corner{ -1, -1, -1 };
+						uint8_t relative = 0;
+						int32_t index = 0;
+						auto result = std::from_chars(it, lineEnd, index);
+						if (result.ec != std::errc{}) {
+							break;
+						}
+						it = result.ptr;
+						corner.position = resolveIndex(index, chunk.positions.size(), 1, relative);
+
+						if (it < lineEnd && *it == '/') {
+							++it;
+							result = std::from_chars(it, lineEnd, index);
+							if (result.ec == std::errc{}) {
+								it = result.ptr;
+								corner.texcoord = resolveIndex(index, chunk.texcoords.size(), 2, relative);
+							}
+							if (it < lineEnd && *it == '/') {
+								++it;
+								result = std::from_chars(it, lineEnd, index);
+								if (result.ec == std::errc{}) {
+									it = result.ptr;
+									corner.normal = resolveIndex(index, chunk.normals.size(), 4, relative);
+								}
+							}
+						}
+						face.push_back(corner);
+						faceRelative.push_back(relative);
+					}
+
+					// fan triangulation, as tinyobjloader does by default
+					for (size_t i = 2; i < face.size(); ++i) {
+						for (size_t corner : { size_t(0), i - 1, i }) {
+							chunk.corners.push_back(face[corner]);
+							chunk.relative.push_back(faceRelative[corner]);
+						}
+						chunk.triangleLines.push_back(static_cast<uint32_t>(chunk.lineCount));
+					}
+				}
+				else if (line.starts_with("mtllib")) {
+					it += 6;
+					chunk.materialLibraries.emplace_back(parseName(it, lineEnd));
+				}
+				else if (line.starts_with("usemtl") && chunk.material.empty()) {
+					it += 6;
+					chunk.material = parseName(it, lineEnd);
+				}
+
+				it = lineEnd < end ? lineEnd + 1 : end;
+				++chunk.lineCount;
+			}
+		}
+	};
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace mc
+{
+	// a VkPipelineCache that is seeded from a file on disk and written back on shutdown.
+	// the driver's own header only names the device, so the file carries a prefix with the
+	// driver version as well - a cache left behind by a different driver build is thrown away
+	// instead of being handed to the new one
+	class PipelineCache
+	{
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+		};
+		static constexpr uint32_t fileMagic = 0x4350434d; // "MCPC"
+
+		VkDevice device = nullptr;
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties properties{};
+		std::filesystem::path path;
+		bool warm = false;
+
+	public:
+		PipelineCache() = delete;
+		PipelineCache(PipelineCache const&) = delete;
+		PipelineCache& operator=(PipelineCache const&) = delete;
+
+		PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, std::filesystem::path path) :
+			device(device),
+			path(std::move(path))
+		{
+			vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+			const std::vector<char> initialData = load();
+			warm = !initialData.empty();
+
+			VkPipelineCacheCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			createInfo.initialDataSize = initialData.size();
+			createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+			if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create pipeline cache!");
+			}
+		}
+
+		~PipelineCache()
+		{
+			vkDestroyPipelineCache(device, cache, nullptr);
+		}
+
+		VkPipelineCache get() const { return cache; }
+		// whether a cache from a previous run on this device and driver was loaded
+		bool isWarm() const { return warm; }
+
+		// write everything the driver has gathered so far, failing to save only costs the next
+		// start its warm cache so it is reported rather than thrown
+		void save() const
+		{
+			size_t dataSize = 0;
+			if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+				return;
+			}
+			std::vector<char> data(dataSize);
+			if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS) {
+				return;
+			}
+
+			FileHeader header{};
+			header.magic = fileMagic;
+			header.vendorID = properties.vendorID;
+			header.deviceID = properties.deviceID;
+			header.driverVersion = properties.driverVersion;
+			std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+			header.dataSize = dataSize;
+
+			// written beside the real file and renamed over it so a crash mid write never leaves
+			// a truncated cache behind
+			std::filesystem::path tempPath = path;
+			tempPath += ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				file.write(data.data(), static_cast<std::streamsize>(dataSize));
+				if (!file) {
+					std::cerr << "failed to write pipeline cache: " << tempPath.string() << std::endl;
+					return;
+				}
+			}
+			std::error_code error;
+			std::filesystem::rename(tempPath, path, error);
+			if (error) {
+				std::cerr << "failed to replace pipeline cache: " << path.string() << std::endl;
+			}
+		}
+
+	private:
+		// returns the cache data if the file exists and was written by this device and driver,
+		// otherwise nothing and the cache starts cold
+		std::vector<char> load() const
+		{
+			std::ifstream file(path, std::ios::ate | std::ios::binary);
+			if (!file.is_open()) {
+				return {};
+			}
+
+			const size_t fileSize = static_cast<size_t>(file.tellg());
+			if (fileSize < sizeof(FileHeader)) {
+				return {};
+			}
+			file.seekg(0);
+
+			FileHeader header{};
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+			if (!file ||
+				header.magic != fileMagic ||
+				header.vendorID != properties.vendorID ||
+				header.deviceID != properties.deviceID ||
+				header.driverVersion != properties.driverVersion ||
+				std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+				header.dataSize != fileSize - sizeof(FileHeader)) {
+				return {};
+			}
+
+			std::vector<char> data(static_cast<size_t>(header.dataSize));
+			file.read(data.data(), static_cast<std::streamsize>(data.size()));
+			if (!file) {
+				return {};
+			}
+
+			// the driver checks its own header too, but a mismatch there is allowed to fail
+			// vkCreatePipelineCache on some implementations
+			VkPipelineCacheHeaderVersionOne driverHeader{};
+			if (data.size() < sizeof(driverHeader)) {
+				return {};
+			}
+			std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+			if (driverHeader.headerSize < sizeof(driverHeader) ||
+				driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+				driverHeader.vendorID != properties.vendorID ||
+				driverHeader.deviceID != properties.deviceID ||
+				std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+				return {};
+			}
+
+			return data;
+		}
+	};
+}
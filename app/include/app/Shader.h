@@ -1,5 +1,7 @@
 #pragma once
 #include <filesystem>
+#include <mutex>
+#include <unordered_map>
 #include <variant>
 #include <vulkan/vulkan.h>
 #ifdef __linux__
@@ -79,20 +81,34 @@ namespace mc
 {
 	class Shader
 	{
+		// everything parseShader pulls out of the SPIR-V
+		struct Reflection
+		{
+			std::array<VkDescriptorType, 32> resourceTypes{};
+			uint32_t resourceMask = 0;
+
+			uint32_t localSizeX = 0;
+			uint32_t localSizeY = 0;
+			uint32_t localSizeZ = 0;
+
+			bool usesPushConstants = false;
+			// whether anything is read from set 1, the mc::BindlessTable
+			bool usesBindlessTable = false;
+		};
+
+		// the same binaries are loaded by several programs and again on every swap chain
+		// recreation, so each one is only parsed the first time. shaders are loaded from
+		// the pipeline worker threads, hence the lock
+		inline static std::mutex reflectionCacheMutex;
+		inline static std::unordered_map<std::string, Reflection> reflectionCache;
+
         VkDevice const device;
 
-		std::array<VkDescriptorType, 32> resourceTypes;
-		uint32_t resourceMask;
+		Reflection reflection;
 
 		VkShaderStageFlagBits const shaderStage;
         VkShaderModule const shaderModule;
 
-		uint32_t localSizeX;
-		uint32_t localSizeY;
-		uint32_t localSizeZ;
-
-		bool usesPushConstants;
-
 	public:
 		Shader() = delete;
 
@@ -101,10 +117,8 @@ namespace mc
             requires std::convertible_to<pathType, std::string> :
                 device(device),
                 shaderStage(stage),
-				resourceMask(0),
-                shaderModule(createShaderModule(readFile(std::filesystem::path(path))))
+                shaderModule(createShaderModule(std::filesystem::path(path)))
         {
-			std::cout << path << std::endl;
 		}
 
         ~Shader()
@@ -114,13 +128,15 @@ namespace mc
 
         VkShaderModule get() { return shaderModule; }
         VkShaderStageFlagBits getShaderStage() const { return shaderStage; }
-		std::array<VkDescriptorType, 32> getResourceTypes() const { return resourceTypes; }
-		uint32_t getResourceMask() const { return resourceMask; }
-		bool getUsesPushConstants() const { return usesPushConstants; }
+		std::array<VkDescriptorType, 32> getResourceTypes() const { return reflection.resourceTypes; }
+		uint32_t getResourceMask() const { return reflection.resourceMask; }
+		bool getUsesPushConstants() const { return reflection.usesPushConstants; }
+		bool getUsesBindlessTable() const { return reflection.usesBindlessTable; }
 
 	private:
         // create a VkShaderModule to encapsulate our shaders
-        VkShaderModule createShaderModule(const std::vector<char>& code) {
+        VkShaderModule createShaderModule(const std::filesystem::path& path) {
+            const std::vector<char> code = readFile(path);
 
             // create struct to hold shader module info
             VkShaderModuleCreateInfo createInfo{};
@@ -140,15 +156,27 @@ namespace mc
                 throw std::runtime_error("failed to create shader module!");
             }
 
-			parseShader(reinterpret_cast<const uint32_t*>(code.data()), code.size() / 4);
+			{
+				std::lock_guard<std::mutex> lock(reflectionCacheMutex);
+				auto cached = reflectionCache.find(path.string());
+				if (cached == reflectionCache.end())
+				{
+					cached = reflectionCache.emplace(path.string(), parseShader(reinterpret_cast<const uint32_t*>(code.data()), code.size() / 4)).first;
+				}
+				reflection = cached->second;
+			}
 
             //return shader module
             return shaderModule;
         }
 
-		void parseShader(const uint32_t* code, uint32_t codeSize)
+		Reflection parseShader(const uint32_t* code, uint32_t codeSize) const
 		{
-			resourceMask = 0;
+			Reflection result;
+			uint32_t& resourceMask = result.resourceMask;
+			uint32_t& localSizeX = result.localSizeX;
+			uint32_t& localSizeY = result.localSizeY;
+			uint32_t& localSizeZ = result.localSizeZ;
 			assert(code[0] == SpvMagicNumber);
 
 			uint32_t idBound = code[3];
@@ -289,61 +317,28 @@ namespace mc
 			{
 				if (id.opcode == SpvOpVariable && (id.storageClass == SpvStorageClassUniform || id.storageClass == SpvStorageClassUniformConstant || id.storageClass == SpvStorageClassStorageBuffer))
 				{
-					assert(id.set == 0);
+					// set 1 is the bindless table, whose layout is shared rather than reflected
+					if (id.set != 0)
+					{
+						assert(id.set == 1);
+						result.usesBindlessTable = true;
+						continue;
+					}
 					assert(id.binding < 32);
 					assert(ids[id.typeId].opcode == SpvOpTypePointer);
 
 					uint32_t typeKind = ids[ids[id.typeId].typeId].opcode;
-					std::cout << "=========" << std::endl;
-					std::cout << typeKind << std::endl;
-					std::cout << id.opcode << std::endl;
-					std::cout << id.typeId << std::endl;
-					std::cout << id.storageClass << std::endl;
-					std::cout << id.binding << std::endl;
-					std::cout << id.set << std::endl;
-					std::cout << id.constant << std::endl;
-					std::cout << id.bufferBlock << std::endl;
-					std::cout << ids[id.typeId].bufferBlock << std::endl;
-					std::cout << ids[ids[id.typeId].typeId].bufferBlock << std::endl;
 					VkDescriptorType resourceType = getDescriptorType(SpvOp(typeKind), SpvStorageClass(id.storageClass), id.inputAttachment, ids[ids[id.typeId].typeId].bufferBlock);
 
 					//assert((resourceMask & (1 << id.binding)) == 0 || resourceTypes[id.binding] == resourceType);
 
-					resourceTypes[id.binding] = resourceType;
-					std::cout << "Binding: " << id.binding << " | ";
+					result.resourceTypes[id.binding] = resourceType;
 					resourceMask |= 1 << id.binding;
-					switch (resourceType)
-					{
-					case VK_DESCRIPTOR_TYPE_SAMPLER:
-						std::cout << "VK_DESCRIPTOR_TYPE_SAMPLER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-						std::cout << "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-						std::cout << "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER" << std::endl;
-						break;
-					}
 				}
 
 				if (id.opcode == SpvOpVariable && id.storageClass == SpvStorageClassPushConstant)
 				{
-					usesPushConstants = true;
+					result.usesPushConstants = true;
 				}
 			}
 
@@ -369,6 +364,8 @@ namespace mc
 
 				assert(localSizeX && localSizeY && localSizeZ);
 			}
+
+			return result;
 		}
 	};
 
@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 
 #include "app/Shader.h"
+#include "app/DescriptorInfo.h"
 
 namespace mc
 {
@@ -11,29 +12,60 @@ namespace mc
 		VkPipelineLayout layout = nullptr;
 		VkDescriptorSetLayout setLayout = nullptr;
 		VkShaderStageFlags pushConstantStages = 0;
+		// writes every binding the shaders declare from a DescriptorSetData, built from the same
+		// reflection as the set layout so the two always agree
+		VkDescriptorUpdateTemplate updateTemplate = nullptr;
+		PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate = nullptr;
 
 	public:
 		ShaderProgram() {};
 
+		// with pushDescriptors the set layout is a VK_KHR_push_descriptor one, its bindings are
+		// recorded straight in to the command buffer with pushDescriptors instead of being
+		// allocated from a pool and bound. bindlessSetLayout becomes set 1 of the pipeline
+		// layout, and is required when the shaders read from set 1
 		ShaderProgram(
 			VkDevice device,
 			mc::Shaders shaders,
-			size_t pushConstantSize = 0) :
+			size_t pushConstantSize = 0,
+			bool pushDescriptors = false,
+			VkDescriptorSetLayout bindlessSetLayout = nullptr) :
 			device(device)
 		{
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 			for (const auto shader : shaders)
 			{
 				if (shader->getUsesPushConstants())
 				{
 					pushConstantStages |= shader->getShaderStage();
 				}
+				if (shader->getShaderStage() == VK_SHADER_STAGE_COMPUTE_BIT)
+				{
+					bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+				}
+				if (shader->getUsesBindlessTable() && !bindlessSetLayout)
+				{
+					throw std::runtime_error("shader reads the bindless table but the program was not given its layout!");
+				}
 			}
 
-			setLayout = createSetLayout(shaders);
+			setLayout = createSetLayout(shaders, pushDescriptors);
 			assert(setLayout);
 
-			layout = createPipelineLayout(pushConstantSize);
+			layout = createPipelineLayout(pushConstantSize, bindlessSetLayout);
 			assert(layout);
+
+			updateTemplate = createUpdateTemplate(shaders, bindPoint, pushDescriptors);
+
+			if (pushDescriptors)
+			{
+				cmdPushDescriptorSetWithTemplate = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+					vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+				if (!cmdPushDescriptorSetWithTemplate)
+				{
+					throw std::runtime_error("failed to load vkCmdPushDescriptorSetWithTemplateKHR!");
+				}
+			}
 		}
 
 		ShaderProgram& operator=(ShaderProgram&& other)
@@ -42,11 +74,17 @@ namespace mc
 			std::swap(other.layout, this->layout);
 			std::swap(other.setLayout, this->setLayout);
 			std::swap(other.pushConstantStages, this->pushConstantStages);
+			std::swap(other.updateTemplate, this->updateTemplate);
+			std::swap(other.cmdPushDescriptorSetWithTemplate, this->cmdPushDescriptorSetWithTemplate);
 			return *this;
 		}
 
 		~ShaderProgram()
 		{
+			if (updateTemplate)
+			{
+				vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
+			}
 			if (layout)
 			{
 				vkDestroyPipelineLayout(device, layout, nullptr);
@@ -60,6 +98,21 @@ namespace mc
 		const VkPipelineLayout& getLayout() const { return layout; }
 		const VkDescriptorSetLayout& getSetLayout() const { return setLayout; }
 		const VkShaderStageFlags& getPushConstantStages() const { return pushConstantStages; }
+
+		// fill a set allocated with this program's layout
+		void updateDescriptorSet(VkDescriptorSet set, DescriptorSetData const& descriptors) const
+		{
+			assert(updateTemplate && !cmdPushDescriptorSetWithTemplate);
+			vkUpdateDescriptorSetWithTemplate(device, set, updateTemplate, descriptors.data());
+		}
+
+		// record the bindings in to commandBuffer as set 0, no set or pool involved. The data is
+		// copied in, so descriptors only has to live for the call
+		void pushDescriptors(VkCommandBuffer commandBuffer, DescriptorSetData const& descriptors) const
+		{
+			assert(updateTemplate && cmdPushDescriptorSetWithTemplate);
+			cmdPushDescriptorSetWithTemplate(commandBuffer, updateTemplate, layout, 0, descriptors.data());
+		}
 	private:
 		uint32_t gatherResources(Shaders shaders, VkDescriptorType(&resourceTypes)[32])
 		{
@@ -87,7 +140,7 @@ namespace mc
 			return resourceMask;
 		}
 
-		VkDescriptorSetLayout createSetLayout(Shaders shaders)
+		VkDescriptorSetLayout createSetLayout(Shaders shaders, bool pushDescriptors)
 		{
 			std::vector<VkDescriptorSetLayoutBinding> setBindings;
 
@@ -113,56 +166,11 @@ namespace mc
 					}
 
 					setBindings.push_back(binding);
-					std::cout << "------------" << std::endl;
-					std::cout << binding.binding << std::endl;
-					switch (binding.descriptorType)
-					{
-					case VK_DESCRIPTOR_TYPE_SAMPLER:
-						std::cout << "VK_DESCRIPTOR_TYPE_SAMPLER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-						std::cout << "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-						std::cout << "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER" << std::endl;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
-						std::cout << "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER" << std::endl;
-						break;
-					}
-					std::cout << binding.descriptorCount << std::endl;
-					switch (binding.stageFlags)
-					{
-					case VK_SHADER_STAGE_VERTEX_BIT:
-						std::cout << "VK_SHADER_STAGE_VERTEX_BIT" << std::endl;
-						break;
-					case VK_SHADER_STAGE_FRAGMENT_BIT:
-						std::cout << "VK_SHADER_STAGE_FRAGMENT_BIT" << std::endl;
-						break;
-					case VK_SHADER_STAGE_GEOMETRY_BIT:
-						std::cout << "VK_SHADER_STAGE_GEOMETRY_BIT" << std::endl;
-						break;
-					case VK_SHADER_STAGE_COMPUTE_BIT:
-						std::cout << "VK_SHADER_STAGE_COMPUTE_BIT" << std::endl;
-						break;
-					}
 				}
 			}
 
 			VkDescriptorSetLayoutCreateInfo setCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-			setCreateInfo.flags = 0;
+			setCreateInfo.flags = pushDescriptors ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR : 0;
 			setCreateInfo.bindingCount = uint32_t(setBindings.size());
 			setCreateInfo.pBindings = setBindings.data();
 
@@ -175,12 +183,61 @@ namespace mc
 			return setLayout;
 		}
 
-		VkPipelineLayout createPipelineLayout(size_t pushConstantSize)
+		VkDescriptorUpdateTemplate createUpdateTemplate(Shaders shaders, VkPipelineBindPoint bindPoint, bool pushDescriptors)
 		{
+			VkDescriptorType resourceTypes[32] = {};
+			uint32_t resourceMask = gatherResources(shaders, resourceTypes);
+
+			// a program without any resources has nothing to write
+			if (resourceMask == 0)
+			{
+				return nullptr;
+			}
+
+			// binding i reads the i'th DescriptorData, so callers index by binding and bindings
+			// this program does not have are skipped over
+			std::vector<VkDescriptorUpdateTemplateEntry> entries;
+			for (uint32_t i = 0; i < 32; ++i)
+			{
+				if (resourceMask & (1 << i))
+				{
+					VkDescriptorUpdateTemplateEntry entry = {};
+					entry.dstBinding = i;
+					entry.dstArrayElement = 0;
+					entry.descriptorCount = 1;
+					entry.descriptorType = resourceTypes[i];
+					entry.offset = sizeof(DescriptorData) * i;
+					entry.stride = sizeof(DescriptorData);
+					entries.push_back(entry);
+				}
+			}
+
+			VkDescriptorUpdateTemplateCreateInfo createInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
+			createInfo.descriptorUpdateEntryCount = uint32_t(entries.size());
+			createInfo.pDescriptorUpdateEntries = entries.data();
+			createInfo.templateType = pushDescriptors ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+			createInfo.descriptorSetLayout = setLayout;
+			createInfo.pipelineBindPoint = bindPoint;
+			createInfo.pipelineLayout = layout;
+			createInfo.set = 0;
+
+			VkDescriptorUpdateTemplate updateTemplate = 0;
+			if (vkCreateDescriptorUpdateTemplate(device, &createInfo, 0, &updateTemplate) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create descriptor update template!");
+			}
+
+			return updateTemplate;
+		}
+
+		VkPipelineLayout createPipelineLayout(size_t pushConstantSize, VkDescriptorSetLayout bindlessSetLayout)
+		{
+			const std::array<VkDescriptorSetLayout, 2> setLayouts = { setLayout, bindlessSetLayout };
+
 			VkPipelineLayoutCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
 			createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			createInfo.setLayoutCount = 1;
-			createInfo.pSetLayouts = &setLayout;
+			createInfo.setLayoutCount = bindlessSetLayout ? 2 : 1;
+			createInfo.pSetLayouts = setLayouts.data();
 			createInfo.pushConstantRangeCount = 0;
 
 			VkPushConstantRange pushConstantRange = {};
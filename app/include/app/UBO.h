@@ -12,6 +12,8 @@ struct UniformBufferObject {
 	glm::mat4 culling_model;
 	glm::mat4 culling_view;
 	glm::mat4 culling_proj;
+	glm::mat4 prev_view;
+	glm::mat4 prev_proj;
 	glm::mat4 light;
 	glm::mat4 lightVP;
 	glm::vec4 Ka;
@@ -36,6 +38,53 @@ struct UniformBufferObject {
 	glm::float32 zNear;
 	glm::int32 display_mode;
 	glm::int32 culling_updating;
+	glm::int32 early_reprojection;
+	glm::int32 bootstrap_occluders;
+	glm::float32 bootstrap_occluder_size;
+	glm::int32 shadow_lod_bias;
+	glm::uint32 shadow_dirty_tiles_lo;
+	glm::uint32 shadow_dirty_tiles_hi;
+	glm::float32 contribution_cull_pixels;
+	glm::int32 contribution_cull_mode;
+	glm::float32 impostor_screen_size;
+	glm::int32 instance_bucketing;
+	glm::int32 depth_sort;
+	glm::int32 overdraw_stats;
+	glm::uint32 point_light_count;
+	glm::uint32 light_tile_count_x;
+	glm::uint32 light_tile_count_y;
+	// bindless buffer slots of the material table and the per instance material indices
+	glm::uint32 material_buffer;
+	glm::uint32 instance_material_buffer;
+	// on screen simplification error the LOD selection allows, in pixels
+	glm::float32 lod_error_pixels;
+	// non zero to draw instances that want LOD 0 as a cut through the cluster hierarchy
+	glm::int32 cluster_lod;
+};
+
+// one entry of the GPU material table, picked per instance through the instance material
+// buffer. Textures are bindless slots, see mc::BindlessTable
+struct MaterialData
+{
+	glm::vec4 baseColour;
+	glm::uint32 albedoTexture;
+	glm::uint32 padding[3];
+};
+
+// a local light for the tiled lighting pass, world space position and radius of influence,
+// linear colour scaled by intensity
+struct PointLight
+{
+	glm::vec4 positionRadius;
+	glm::vec4 color;
+};
+
+// counters written by the late cull and the geometry passes, read back for the overlay
+struct CullStatsData
+{
+	glm::uint32 contributionCulled;
+	glm::uint32 pointSplats;
+	glm::uint32 gbufferFragments;
 };
 
 struct ShadowUniformBufferObject
@@ -0,0 +1,470 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace mc
+{
+	// streams buffer and image contents to device local memory without stalling the graphics
+	// queue. Data is copied in to a persistently mapped staging ring and the copies are recorded
+	// in to a batch, which flush submits to the transfer queue. Each submitted batch signals a
+	// timeline semaphore, that value is what the upload calls return and what frees its part of
+	// the ring again.
+	//
+	// When the transfer queue is in its own family the batch releases what it wrote and a small
+	// command buffer on the graphics queue acquires it, waiting on the timeline on the GPU. Work
+	// submitted to the graphics queue after flush is therefore ordered after the uploads without
+	// the CPU waiting on anything
+	class UploadService
+	{
+		struct Batch
+		{
+			uint64_t timelineValue = 0;
+			// ring bytes the batch used, returned once it completes
+			VkDeviceSize ringBytes = 0;
+			VkCommandBuffer transferCommandBuffer = nullptr;
+			VkCommandBuffer acquireCommandBuffer = nullptr;
+			// run once the batch completes, for objects its commands use
+			std::vector<std::function<void()>> releases;
+		};
+
+		VkDevice device = nullptr;
+		uint32_t graphicsFamily = 0;
+		uint32_t transferFamily = 0;
+		VkQueue graphicsQueue = nullptr;
+		VkQueue transferQueue = nullptr;
+
+		VkCommandPool transferPool = nullptr;
+		VkCommandPool acquirePool = nullptr;
+		VkSemaphore timeline = nullptr;
+		uint64_t lastSubmittedValue = 0;
+
+		VkBuffer ring = nullptr;
+		VkDeviceMemory ringMemory = nullptr;
+		char* ringData = nullptr;
+		VkDeviceSize ringSize = 0;
+		VkDeviceSize ringHead = 0;
+		VkDeviceSize ringTail = 0;
+		VkDeviceSize ringUsed = 0;
+
+		// being recorded, submitted by the next flush
+		Batch recording;
+		std::deque<Batch> inFlight;
+
+	public:
+		UploadService() = delete;
+		UploadService(UploadService const&) = delete;
+		UploadService& operator=(UploadService const&) = delete;
+
+		// transferQueue may be the graphics queue itself when the device has no separate family
+		UploadService(VkDevice device, VkPhysicalDevice physicalDevice,
+			uint32_t graphicsFamily, VkQueue graphicsQueue,
+			uint32_t transferFamily, VkQueue transferQueue,
+			VkDeviceSize ringSize = 64 * 1024 * 1024) :
+			device(device),
+			graphicsFamily(graphicsFamily),
+			transferFamily(transferFamily),
+			graphicsQueue(graphicsQueue),
+			transferQueue(transferQueue),
+			ringSize(ringSize)
+		{
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			poolInfo.queueFamilyIndex = transferFamily;
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload command pool!");
+			}
+			if (separateFamilies()) {
+				poolInfo.queueFamilyIndex = graphicsFamily;
+				if (vkCreateCommandPool(device, &poolInfo, nullptr, &acquirePool) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create upload command pool!");
+				}
+			}
+
+			VkSemaphoreTypeCreateInfo timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			timelineInfo.initialValue = 0;
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			semaphoreInfo.pNext = &timelineInfo;
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload timeline semaphore!");
+			}
+
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = ringSize;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &ring) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload staging ring!");
+			}
+
+			VkMemoryRequirements memRequirements;
+			vkGetBufferMemoryRequirements(device, ring, &memRequirements);
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = memRequirements.size;
+			allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &ringMemory) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate upload staging ring memory!");
+			}
+			vkBindBufferMemory(device, ring, ringMemory, 0);
+
+			void* data;
+			vkMapMemory(device, ringMemory, 0, ringSize, 0, &data);
+			ringData = static_cast<char*>(data);
+		}
+
+		~UploadService()
+		{
+			flush();
+			wait(lastSubmittedValue);
+			collect();
+
+			vkUnmapMemory(device, ringMemory);
+			vkDestroyBuffer(device, ring, nullptr);
+			vkFreeMemory(device, ringMemory, nullptr);
+			vkDestroySemaphore(device, timeline, nullptr);
+			if (acquirePool) {
+				vkDestroyCommandPool(device, acquirePool, nullptr);
+			}
+			vkDestroyCommandPool(device, transferPool, nullptr);
+		}
+
+		bool separateFamilies() const { return transferFamily != graphicsFamily; }
+		VkSemaphore getTimelineSemaphore() const { return timeline; }
+
+		// copies size bytes of data in to dst at dstOffset. Uploads larger than the ring are split
+		// across several batches. Returns the timeline value the copy has finished at
+		uint64_t uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+		{
+			const char* source = static_cast<const char*>(data);
+			VkDeviceSize done = 0;
+			while (done < size) {
+				const VkDeviceSize chunk = std::min(size - done, ringSize);
+				const VkDeviceSize offset = allocate(chunk, 16);
+				std::memcpy(ringData + offset, source + done, static_cast<size_t>(chunk));
+
+				VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+				VkBufferCopy copyRegion{ offset, dstOffset + done, chunk };
+				vkCmdCopyBuffer(commandBuffer, ring, dst, 1, &copyRegion);
+
+				VkBufferMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				barrier.srcQueueFamilyIndex = separateFamilies() ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = separateFamilies() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = dst;
+				barrier.offset = dstOffset + done;
+				barrier.size = chunk;
+				recordBarrier(&barrier, nullptr);
+
+				done += chunk;
+			}
+			return recordingValue();
+		}
+
+		// writes size bytes of image data straight in to the ring through write, then copies it to
+		// every level of image, which ends up in SHADER_READ_ONLY_OPTIMAL. Region buffer offsets
+		// are relative to the written data and must keep to the format's block size
+		uint64_t uploadImage(VkImage image, uint32_t mipLevels, VkDeviceSize size,
+			const std::function<void(void*)>& write, std::vector<VkBufferImageCopy> regions)
+		{
+			if (size > ringSize) {
+				throw std::runtime_error("image upload is larger than the staging ring!");
+			}
+			const VkDeviceSize offset = allocate(size, 16);
+			write(ringData + offset);
+			for (VkBufferImageCopy& region : regions) {
+				region.bufferOffset += offset;
+			}
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+			VkCommandBuffer commandBuffer = getTransferCommandBuffer();
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+			vkCmdCopyBufferToImage(commandBuffer, ring, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(regions.size()), regions.data());
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcQueueFamilyIndex = separateFamilies() ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = separateFamilies() ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+			recordBarrier(nullptr, &barrier);
+
+			return recordingValue();
+		}
+
+		// a graphics queue command buffer in the batch being recorded, submitted with it by the
+		// next flush. It runs after the batch's copies, across families it is the one that
+		// acquires them. Layout transitions, fills and passes that go with the uploads are
+		// recorded here rather than each getting their own submit and queue wait
+		VkCommandBuffer getGraphicsCommandBuffer()
+		{
+			getTransferCommandBuffer();
+			return separateFamilies() ? recording.acquireCommandBuffer : recording.transferCommandBuffer;
+		}
+
+		// calls release once everything recorded so far has finished on the GPU
+		void releaseAfterBatch(std::function<void()> release)
+		{
+			getTransferCommandBuffer();
+			recording.releases.push_back(std::move(release));
+		}
+
+		// submits everything recorded since the last flush and frees the ring space of batches
+		// that have finished. Cheap when there is nothing to do, so it can run every frame
+		void flush()
+		{
+			collect();
+			if (!recording.transferCommandBuffer) {
+				return;
+			}
+
+			// across families the acquire waits on the transfer's value and signals the batch's
+			const uint64_t transferValue = ++lastSubmittedValue;
+			recording.timelineValue = separateFamilies() ? ++lastSubmittedValue : transferValue;
+
+			vkEndCommandBuffer(recording.transferCommandBuffer);
+			submit(transferQueue, recording.transferCommandBuffer, 0, transferValue);
+
+			if (separateFamilies()) {
+				vkEndCommandBuffer(recording.acquireCommandBuffer);
+				submit(graphicsQueue, recording.acquireCommandBuffer, transferValue, recording.timelineValue);
+			}
+
+			inFlight.push_back(recording);
+			recording = Batch{};
+		}
+
+		bool isComplete(uint64_t value) const
+		{
+			uint64_t completed = 0;
+			vkGetSemaphoreCounterValue(device, timeline, &completed);
+			return completed >= value;
+		}
+
+		// blocks the CPU until value is reached, submitting it first if it is still recording
+		void wait(uint64_t value)
+		{
+			if (value > lastSubmittedValue) {
+				flush();
+			}
+			if (value == 0) {
+				return;
+			}
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &value;
+			vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+		}
+
+	private:
+		// the value the batch being recorded will signal once flushed
+		uint64_t recordingValue() const
+		{
+			return lastSubmittedValue + (separateFamilies() ? 2 : 1);
+		}
+
+		static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
+		{
+			VkPhysicalDeviceMemoryProperties memProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+			for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+				if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+					return i;
+				}
+			}
+			throw std::runtime_error("failed to find suitable memory type!");
+		}
+
+		VkCommandBuffer beginCommandBuffer(VkCommandPool pool)
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = pool;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer;
+			vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+			return commandBuffer;
+		}
+
+		VkCommandBuffer getTransferCommandBuffer()
+		{
+			if (!recording.transferCommandBuffer) {
+				recording.transferCommandBuffer = beginCommandBuffer(transferPool);
+				if (separateFamilies()) {
+					recording.acquireCommandBuffer = beginCommandBuffer(acquirePool);
+				}
+			}
+			return recording.transferCommandBuffer;
+		}
+
+		// records the release half on the transfer queue and, across families, the matching
+		// acquire on the graphics queue. Within one family it is an ordinary barrier
+		void recordBarrier(const VkBufferMemoryBarrier* bufferBarrier, const VkImageMemoryBarrier* imageBarrier)
+		{
+			const uint32_t bufferCount = bufferBarrier ? 1 : 0;
+			const uint32_t imageCount = imageBarrier ? 1 : 0;
+
+			if (!separateFamilies()) {
+				vkCmdPipelineBarrier(recording.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+					0, nullptr, bufferCount, bufferBarrier, imageCount, imageBarrier);
+				return;
+			}
+
+			// the destination access of a release and the source access of an acquire are ignored
+			VkBufferMemoryBarrier releaseBuffer = bufferBarrier ? *bufferBarrier : VkBufferMemoryBarrier{};
+			VkImageMemoryBarrier releaseImage = imageBarrier ? *imageBarrier : VkImageMemoryBarrier{};
+			releaseBuffer.dstAccessMask = 0;
+			releaseImage.dstAccessMask = 0;
+			vkCmdPipelineBarrier(recording.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, bufferCount, &releaseBuffer, imageCount, &releaseImage);
+
+			VkBufferMemoryBarrier acquireBuffer = bufferBarrier ? *bufferBarrier : VkBufferMemoryBarrier{};
+			VkImageMemoryBarrier acquireImage = imageBarrier ? *imageBarrier : VkImageMemoryBarrier{};
+			acquireBuffer.srcAccessMask = 0;
+			acquireImage.srcAccessMask = 0;
+			vkCmdPipelineBarrier(recording.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+				0, nullptr, bufferCount, &acquireBuffer, imageCount, &acquireImage);
+		}
+
+		void submit(VkQueue queue, VkCommandBuffer commandBuffer, uint64_t waitValue, uint64_t signalValue)
+		{
+			VkTimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = waitValue ? 1 : 0;
+			timelineInfo.pWaitSemaphoreValues = &waitValue;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+			const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.waitSemaphoreCount = waitValue ? 1 : 0;
+			submitInfo.pWaitSemaphores = &timeline;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+
+			if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit uploads!");
+			}
+		}
+
+		// batches finish in submission order, so the ring tail only ever moves forward
+		void collect()
+		{
+			uint64_t completed = 0;
+			vkGetSemaphoreCounterValue(device, timeline, &completed);
+			while (!inFlight.empty() && inFlight.front().timelineValue <= completed) {
+				Batch& batch = inFlight.front();
+				ringTail = (ringTail + batch.ringBytes) % ringSize;
+				ringUsed -= batch.ringBytes;
+				vkFreeCommandBuffers(device, transferPool, 1, &batch.transferCommandBuffer);
+				if (batch.acquireCommandBuffer) {
+					vkFreeCommandBuffers(device, acquirePool, 1, &batch.acquireCommandBuffer);
+				}
+				for (const std::function<void()>& release : batch.releases) {
+					release();
+				}
+				inFlight.pop_front();
+			}
+		}
+
+		std::optional<VkDeviceSize> tryAllocate(VkDeviceSize size, VkDeviceSize alignment)
+		{
+			if (ringUsed == 0) {
+				ringHead = ringTail = 0;
+			}
+			else if (ringHead == ringTail) {
+				return std::nullopt;
+			}
+
+			const VkDeviceSize aligned = (ringHead + alignment - 1) / alignment * alignment;
+			VkDeviceSize offset;
+			if (ringHead >= ringTail) {
+				// free space is the end of the ring and then its start, up to the tail
+				if (aligned + size <= ringSize) {
+					offset = aligned;
+				}
+				else if (size <= ringTail) {
+					offset = 0;
+				}
+				else {
+					return std::nullopt;
+				}
+			}
+			else if (aligned + size <= ringTail) {
+				offset = aligned;
+			}
+			else {
+				return std::nullopt;
+			}
+
+			// bytes skipped for alignment or at the end of the ring are held until the batch finishes
+			const VkDeviceSize consumed = offset >= ringHead ? offset + size - ringHead : ringSize - ringHead + offset + size;
+			ringHead = (offset + size) % ringSize;
+			ringUsed += consumed;
+			recording.ringBytes += consumed;
+			return offset;
+		}
+
+		// when the ring is full the recorded batch is submitted and the oldest one waited on
+		VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment)
+		{
+			for (;;) {
+				if (auto offset = tryAllocate(size, alignment)) {
+					return *offset;
+				}
+				if (recording.transferCommandBuffer) {
+					flush();
+				}
+				if (inFlight.empty()) {
+					throw std::runtime_error("upload does not fit in the staging ring!");
+				}
+				wait(inFlight.front().timelineValue);
+				collect();
+			}
+		}
+	};
+}
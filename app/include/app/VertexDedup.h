@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "app/JobSystem.h"
+#include "app/Vertex.h"
+
+namespace mc
+{
+	// turns an unindexed stream of vertices, one per triangle corner, in to a vertex and index
+	// buffer. Vertices are equal when their bytes are, and come out in the order they are first
+	// used - the same result as meshopt_generateVertexRemap followed by the remap calls, so no
+	// second remap is needed afterwards. It is split in two so the stages can be timed apart:
+	//
+	// findFirstUses hashes each corner and gives it to one of shardCount shards by the top bits.
+	// Each shard deduplicates its corners on its own job with a flat open addressed table of
+	// corner indices, so there is no allocation per entry and no locking. Corners are visited in
+	// ascending order, so the corner a value maps to is always its first use.
+	//
+	// compact numbers the first uses in stream order with a prefix sum over blocks and points
+	// every corner at its first use's number
+	class VertexDedup
+	{
+		static constexpr size_t shardBits = 6;
+		static constexpr size_t shardCount = size_t(1) << shardBits;
+		static constexpr size_t blockSize = 1 << 16;
+		static constexpr uint32_t emptySlot = std::numeric_limits<uint32_t>::max();
+
+	public:
+		// per corner, the first corner with the same vertex
+		static std::vector<uint32_t> findFirstUses(const std::vector<Vertex>& stream, JobSystem& jobSystem)
+		{
+			const size_t cornerCount = stream.size();
+			const size_t blockCount = (cornerCount + blockSize - 1) / blockSize;
+
+			// counting sort of corners by shard, ascending within each shard
+			std::vector<uint64_t> hashes(cornerCount);
+			std::vector<std::array<uint32_t, shardCount>> blockCounts(blockCount);
+			jobSystem.parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+				for (size_t block = begin; block < end; ++block) {
+					blockCounts[block].fill(0);
+					for (size_t i = block * blockSize; i < std::min((block + 1) * blockSize, cornerCount); ++i) {
+						hashes[i] = hash(stream[i]);
+						++blockCounts[block][hashes[i] >> (64 - shardBits)];
+					}
+				}
+			});
+
+			std::array<size_t, shardCount + 1> shardStarts{};
+			std::vector<std::array<uint32_t, shardCount>> blockOffsets(blockCount);
+			size_t running = 0;
+			for (size_t shard = 0; shard < shardCount; ++shard) {
+				shardStarts[shard] = running;
+				for (size_t block = 0; block < blockCount; ++block) {
+					blockOffsets[block][shard] = static_cast<uint32_t>(running);
+					running += blockCounts[block][shard];
+				}
+			}
+			shardStarts[shardCount] = running;
+
+			std::vector<uint32_t> order(cornerCount);
+			jobSystem.parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+				for (size_t block = begin; block < end; ++block) {
+					std::array<uint32_t, shardCount> offsets = blockOffsets[block];
+					for (size_t i = block * blockSize; i < std::min((block + 1) * blockSize, cornerCount); ++i) {
+						order[offsets[hashes[i] >> (64 - shardBits)]++] = static_cast<uint32_t>(i);
+					}
+				}
+			});
+
+			std::vector<uint32_t> firstUses(cornerCount);
+			jobSystem.parallelFor(shardCount, 1, [&](size_t begin, size_t end) {
+				std::vector<uint32_t> table;
+				for (size_t shard = begin; shard < end; ++shard) {
+					const size_t shardSize = shardStarts[shard + 1] - shardStarts[shard];
+					// at most half full, probes stay short
+					size_t capacity = 16;
+					while (capacity < shardSize * 2) {
+						capacity *= 2;
+					}
+					table.assign(capacity, emptySlot);
+
+					for (size_t o = shardStarts[shard]; o < shardStarts[shard + 1]; ++o) {
+						const uint32_t corner = order[o];
+						size_t slot = static_cast<size_t>(hashes[corner]) & (capacity - 1);
+						for (;;) {
+							const uint32_t existing = table[slot];
+							if (existing == emptySlot) {
+								table[slot] = corner;
+								firstUses[corner] = corner;
+								break;
+							}
+							if (hashes[existing] == hashes[corner] && std::memcmp(&stream[existing], &stream[corner], sizeof(Vertex)) == 0) {
+								firstUses[corner] = existing;
+								break;
+							}
+							slot = (slot + 1) & (capacity - 1);
+						}
+					}
+				}
+			});
+
+			return firstUses;
+		}
+
+		static void compact(const std::vector<Vertex>& stream, const std::vector<uint32_t>& firstUses, JobSystem& jobSystem,
+			std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const size_t cornerCount = stream.size();
+			const size_t blockCount = (cornerCount + blockSize - 1) / blockSize;
+
+			std::vector<uint32_t> blockStarts(blockCount + 1, 0);
+			jobSystem.parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+				for (size_t block = begin; block < end; ++block) {
+					uint32_t count = 0;
+					for (size_t i = block * blockSize; i < std::min((block + 1) * blockSize, cornerCount); ++i) {
+						count += firstUses[i] == i ? 1 : 0;
+					}
+					blockStarts[block + 1] = count;
+				}
+			});
+			for (size_t block = 0; block < blockCount; ++block) {
+				blockStarts[block + 1] += blockStarts[block];
+			}
+
+			// only written at first uses, which every other corner of the value reads back
+			std::vector<uint32_t> vertexIndex(cornerCount);
+			vertices.resize(blockStarts[blockCount]);
+			jobSystem.parallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+				for (size_t block = begin; block < end; ++block) {
+					uint32_t next = blockStarts[block];
+					for (size_t i = block * blockSize; i < std::min((block + 1) * blockSize, cornerCount); ++i) {
+						if (firstUses[i] == i) {
+							vertexIndex[i] = next;
+							vertices[next++] = stream[i];
+						}
+					}
+				}
+			});
+
+			indices.resize(cornerCount);
+			jobSystem.parallelFor(cornerCount, blockSize, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; ++i) {
+					indices[i] = vertexIndex[firstUses[i]];
+				}
+			});
+		}
+
+	private:
+		// a multiply-xorshift mix per 32 bit word, then a murmur3 finaliser. Every input bit
+		// reaches the top bits that pick the shard as well as the low bits that pick the slot
+		static uint64_t hash(const Vertex& vertex)
+		{
+			static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0);
+			std::array<uint32_t, sizeof(Vertex) / sizeof(uint32_t)> words;
+			std::memcpy(words.data(), &vertex, sizeof(Vertex));
+
+			uint64_t h = 0x84222325cbf29ce4ull;
+			for (uint32_t word : words) {
+				h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+				h ^= h >> 31;
+			}
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdull;
+			h ^= h >> 33;
+			h *= 0xc4ceb9fe1a85ec53ull;
+			h ^= h >> 33;
+			return h;
+		}
+	};
+}
@@ -17,10 +17,14 @@
 
 #include <iostream>
 #include <optional>
+#include <unordered_map>
 
 #include "app/Camera.h"
 #include "app/Model.h"
 #include "app/ShaderProgram.h"
+#include "app/PipelineCache.h"
+#include "app/BindlessTable.h"
+#include "app/UploadService.h"
 #include "app/DescriptorInfo.h"
 
 class VulkanObject {
@@ -80,6 +84,8 @@ private:
     VkQueue graphicsQueue;
     // handle to graphics queue
     VkQueue presentQueue;
+    // handle to the queue uploads are submitted on, may be graphicsQueue
+    VkQueue transferQueue;
 
     // our swap chain object
     VkSwapchainKHR swapChain;
@@ -91,15 +97,17 @@ private:
     VkExtent2D swapChainExtent;
 
     struct FrameBufferAttachment {
-        VkImage image;
-        VkDeviceMemory mem;
-        VkImageView view;
-        VkFormat format;
+        VkImage image{};
+        VkDeviceMemory mem{};
+        VkImageView view{};
+        VkFormat format{};
     };
     struct FrameBuffer {
         int32_t width, height;
         VkFramebuffer frameBuffer;
-        FrameBufferAttachment position, normal, albedo;
+        FrameBufferAttachment normal, albedo;
+        // R32G32_UINT instance and triangle ids, replaces albedo in visibility buffer mode
+        FrameBufferAttachment visibility;
         FrameBufferAttachment depth;
         VkRenderPass renderPass;
     } offScreenPass;
@@ -110,6 +118,12 @@ private:
     VkImageView depthPyramidMultiMipView;
     std::vector<VkSampler> depthPyramidSamplers;
     std::vector<mc::DescriptorInfo<VkDescriptorImageInfo>> depthPyramidDescriptorInfo;
+    // last frame's depth pyramid scattered in to this frame's culling view for the early cull.
+    // R32_UINT holding float bits, same size and mips as depthPyramidImage
+    VkImage reprojectedPyramidImage;
+    VkDeviceMemory reprojectedPyramidMem;
+    std::vector<VkImageView> reprojectedPyramidViews;
+    VkImageView reprojectedPyramidMultiMipView;
 
     struct DepthFrameBuffer {
         int32_t width, height;
@@ -120,6 +134,15 @@ private:
         VkRenderPass renderPass;
     } shadowPass;
 
+    // octahedral impostor atlas, baked once from LOD 0 at load. impostorFramesPerSide x
+    // impostorFramesPerSide views of impostorFrameSize pixels each
+    static constexpr uint32_t impostorFramesPerSide = 8;
+    static constexpr uint32_t impostorFrameSize = 64;
+    struct ImpostorAtlas {
+        FrameBufferAttachment albedo, normalDepth;
+        VkSampler sampler;
+    } impostorAtlas;
+
     // vector of image views (to access our images)
     std::vector<VkImageView> swapChainImageViews;
     // vector of all frame buffers
@@ -139,15 +162,26 @@ private:
     //VkDescriptorSetLayout shadowSetLayout;
     std::shared_ptr<mc::ShaderProgram> computeProgram;
     std::shared_ptr<mc::ShaderProgram> depthPyramidComputeProgram;
+    std::shared_ptr<mc::ShaderProgram> depthReprojectProgram;
+    std::shared_ptr<mc::ShaderProgram> drawSortProgram;
+    std::shared_ptr<mc::ShaderProgram> clusterCutProgram;
+    std::shared_ptr<mc::ShaderProgram> lightCullProgram;
+    std::shared_ptr<mc::ShaderProgram> aabbBinProgram;
     std::shared_ptr<mc::ShaderProgram> geometryProgram;
     std::shared_ptr<mc::ShaderProgram> lightingProgram;
     std::shared_ptr<mc::ShaderProgram> shadowProgram;
-    VkPipeline computePipeline;
+    std::shared_ptr<mc::ShaderProgram> pointSplatProgram;
+    std::shared_ptr<mc::ShaderProgram> impostorProgram;
     VkPipeline depthPyramidComputePipeline;
-    VkPipeline graphicsPipeline;
-    VkPipeline lateGraphicsPipeline;
-    VkPipeline lightingPipeline;
-    VkPipeline shadowPipeline;
+    VkPipeline depthReprojectPipeline;
+    VkPipeline drawSortPipeline;
+    VkPipeline clusterCutPipeline;
+    VkPipeline lightCullPipeline;
+    VkPipeline aabbBinPipeline;
+    VkPipeline shadowPipeline = VK_NULL_HANDLE;
+    VkPipeline pointSplatPipeline = VK_NULL_HANDLE;
+    VkPipeline impostorPipeline = VK_NULL_HANDLE;
+    VkPipeline lateImpostorPipeline = VK_NULL_HANDLE;
 
     // create a command pool to manage the memory required for our command buffers
     VkCommandPool commandPool;
@@ -157,6 +191,12 @@ private:
     VkCommandPool imgui_command_pool;
     std::vector<VkCommandBuffer> imgui_command_buffers;
 
+    // shadow map re-renders are recorded per frame, and only submitted when part of the
+    // cached shadow map is dirty
+    VkCommandPool shadowCommandPool;
+    std::vector<VkCommandBuffer> shadowCommandBuffers;
+    std::vector<bool> shadowRenderedForImage;
+
     // vector of semaphores indicating images have been aquired
     std::vector<VkSemaphore> imageAvailableSemaphores;
     // vector of semaphores indicating images are ready for rendering
@@ -170,7 +210,7 @@ private:
     // bool to store if we have resized
     bool framebufferResized = false;
 
-    Model<5> dragon_model;
+    Model dragon_model;
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
     VkBuffer indexBuffer;
@@ -190,11 +230,78 @@ private:
     VkDeviceMemory drawnLastFrameSSBOMemory;
     VkBuffer previousFrameLODSSBO;
     VkDeviceMemory previousFrameLODSSBOMemory;
+    std::vector<VkBuffer> shadowIndirectSSBO;
+    std::vector<VkDeviceMemory> shadowIndirectSSBOMemory;
+    std::vector<VkBuffer> shadowIndirectCountSSBO;
+    std::vector<VkDeviceMemory> shadowIndirectCountSSBOMemory;
+    std::vector<VkBuffer> pointSplatSSBO;
+    std::vector<VkDeviceMemory> pointSplatSSBOMemory;
+    std::vector<VkBuffer> lodBucketSSBO;
+    std::vector<VkDeviceMemory> lodBucketSSBOMemory;
+    std::vector<VkBuffer> bucketInstanceSSBO;
+    std::vector<VkDeviceMemory> bucketInstanceSSBOMemory;
+    std::vector<VkBuffer> drawSortCommandScratchSSBO;
+    std::vector<VkDeviceMemory> drawSortCommandScratchSSBOMemory;
+    std::vector<VkBuffer> drawSortInstanceScratchSSBO;
+    std::vector<VkDeviceMemory> drawSortInstanceScratchSSBOMemory;
+    std::vector<VkBuffer> impostorSSBO;
+    std::vector<VkDeviceMemory> impostorSSBOMemory;
+    // the cluster hierarchy, written once, and the cluster draws of each camera pass as a
+    // clusterDrawHeaderSize header then maxClusterDraws commands. The header counts the draws
+    // and holds cluster_cut.glsl's dispatch over the instances the cull listed in
+    // clusterInstanceSSBO, see getClusterInstanceCapacity
+    VkBuffer clusterSSBO;
+    VkDeviceMemory clusterSSBOMemory;
+    std::vector<VkBuffer> clusterDrawSSBO;
+    std::vector<VkDeviceMemory> clusterDrawSSBOMemory;
+    std::vector<VkBuffer> clusterInstanceSSBO;
+    std::vector<VkDeviceMemory> clusterInstanceSSBOMemory;
+    std::vector<VkBuffer> cullStatsSSBO;
+    std::vector<VkDeviceMemory> cullStatsSSBOMemory;
     std::vector<VkBuffer> sphereProjectionDebugSSBO;
     std::vector<VkDeviceMemory> sphereProjectionDebugSSBOMemory;
+    // point lights for the tiled lighting, only rewritten when the light count changes
+    VkBuffer pointLightSSBO;
+    VkDeviceMemory pointLightSSBOMemory;
+    // per tile light counts followed by per tile light lists, filled by light_cull.glsl
+    std::vector<VkBuffer> lightTileSSBO;
+    std::vector<VkDeviceMemory> lightTileSSBOMemory;
+    // the same layout over the SSAABB overlay's rectangles, filled by aabb_bin.glsl. Only made
+    // with the instrumented cull that writes the rectangles
+    std::vector<VkBuffer> aabbTileSSBO;
+    std::vector<VkDeviceMemory> aabbTileSSBOMemory;
 
     static constexpr size_t chickenCount = 150000;// 50;
 
+    // push constant values selecting which pass lod_indirect.glsl culls for
+    static constexpr uint32_t cullStageLate = 0;
+    static constexpr uint32_t cullStageEarly = 1;
+    static constexpr uint32_t cullStageShadow = 2;
+
+    // push constant values selecting where geometry_pass.vert reads mesh ids from
+    static constexpr uint32_t drawSourceCommands = 0;
+    static constexpr uint32_t drawSourceBuckets = 1;
+    static constexpr uint32_t drawSourceClusters = 2;
+
+    // bytes per draw the culls write, lod_indirect.glsl's VkDrawIndexedIndirectCommand with its
+    // mesh id and two words of padding. Also the stride the indirect draws are issued with
+    static constexpr uint32_t indirectCommandStride = 32;
+
+    // cluster draws per camera pass, an instance whose cut doesn't fit is drawn at LOD 0
+    static constexpr uint32_t maxClusterDraws = 1 << 16;
+    static constexpr VkDeviceSize clusterDrawHeaderSize = 32;
+    // cluster_cut.glsl's local size, and where its VkDispatchIndirectCommand sits in the
+    // cluster draw header
+    static constexpr uint32_t clusterCutGroupSize = 64;
+    static constexpr VkDeviceSize clusterCutDispatchOffset = 16;
+
+    // light binning tile size and list length, matching light_cull.glsl and the lighting shaders
+    static constexpr uint32_t lightTileSize = 16;
+    static constexpr uint32_t maxLightsPerTile = 256;
+    static constexpr uint32_t maxPointLights = 100000;
+    // list length per tile for the SSAABB overlay, matching aabb_bin.glsl and lighting_pass.frag
+    static constexpr uint32_t maxAabbsPerTile = 256;
+
     float timestampPeriod = 1.0f;
 
     struct ModelTransforms {
@@ -205,6 +312,8 @@ private:
     std::unique_ptr<std::array<float, chickenCount>> modelScales;
 
     void createSSBOs();
+    void createCullInstrumentation();
+    void destroyCullInstrumentation();
 
     std::vector<VkBuffer> uniformBuffers;
     std::vector<VkDeviceMemory> uniformBuffersMemory;
@@ -213,21 +322,37 @@ private:
     std::vector<VkDeviceMemory> shadowUniformBuffersMemory;
 
     VkDescriptorPool computeDescriptorPool;
-    VkDescriptorPool depthPyramidComputeDescriptorPool;
+    VkDescriptorPool drawSortDescriptorPool;
+    VkDescriptorPool lightCullDescriptorPool;
+    VkDescriptorPool aabbBinDescriptorPool;
     VkDescriptorPool descriptorPool;
     VkDescriptorPool lightingDescriptorPool;
     VkDescriptorPool shadowDescriptorPool;
+    VkDescriptorPool pointSplatDescriptorPool;
+    VkDescriptorPool impostorDescriptorPool;
     std::vector<VkDescriptorSet> computeDescriptorSets;
-    std::vector<VkDescriptorSet> depthPyramidComputeDescriptorSets;
+    std::vector<VkDescriptorSet> shadowComputeDescriptorSets;
+    std::vector<VkDescriptorSet> drawSortDescriptorSets;
+    // pushed, the cut runs twice a frame over the same buffers
+    std::vector<mc::DescriptorSetData> clusterCutDescriptors;
+    std::vector<VkDescriptorSet> lightCullDescriptorSets;
+    std::vector<VkDescriptorSet> aabbBinDescriptorSets;
     std::vector<VkDescriptorSet> descriptorSets;
     std::vector<VkDescriptorSet> lightingDescriptorSets;
     std::vector<VkDescriptorSet> shadowDescriptorSets;
+    std::vector<VkDescriptorSet> pointSplatDescriptorSets;
+    std::vector<VkDescriptorSet> impostorDescriptorSets;
     VkDescriptorPool imgui_descriptor_pool;
 
     VkImage textureImage;
     VkDeviceMemory textureImageMemory;
     VkImageView textureImageView;
     VkSampler textureSampler;
+    VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t textureMipLevels = 1;
+    bool textureCompressionBCSupported = false;
+    // the point splat contribution cull falls back to dropping without it
+    bool largePointsSupported = false;
 
     VkImage depthImage;
     VkDeviceMemory depthImageMemory;
@@ -248,18 +373,26 @@ private:
 
     std::vector<VkQueryPool> queryPools;
     std::pair<uint32_t, uint32_t> earlyCullQueryIndices;
+    std::pair<uint32_t, uint32_t> earlySortQueryIndices;
     std::pair<uint32_t, uint32_t> earlyRenderQueryIndices;
     std::pair<uint32_t, uint32_t> depthPyramidQueryIndices;
+    std::pair<uint32_t, uint32_t> lightCullQueryIndices;
     std::pair<uint32_t, uint32_t> lateCullQueryIndices;
+    std::pair<uint32_t, uint32_t> lateSortQueryIndices;
     std::pair<uint32_t, uint32_t> lateRenderQueryIndices;
+    std::pair<uint32_t, uint32_t> shadowQueryIndices;
 
     static constexpr size_t queryHistorySamples = 1000;
 
     std::array<float, queryHistorySamples> earlyCullTimeHistory = {};
     std::array<float, queryHistorySamples> earlyRenderTimeHistory = {};
     std::array<float, queryHistorySamples> depthPyramidTimeHistory = {};
+    std::array<float, queryHistorySamples> lightCullTimeHistory = {};
     std::array<float, queryHistorySamples> lateCullTimeHistory = {};
+    // both passes' draw sorts together
+    std::array<float, queryHistorySamples> drawSortTimeHistory = {};
     std::array<float, queryHistorySamples> lateRenderTimeHistory = {};
+    std::array<float, queryHistorySamples> shadowTimeHistory = {};
 
     bool updatingImGuiQueryData = true;
 
@@ -285,6 +418,127 @@ private:
     bool pcf = false;
     std::string save_path;
     bool updating_pos = true;
+    bool early_reprojection = false;
+    // false until a depth pyramid has been built for the current swap chain
+    bool depthPyramidHistoryValid = false;
+    // set whenever visibility history is missing or stale, the next frame draws large meshes
+    // as occluders in its early pass instead of last frame's visible set
+    bool bootstrapOcclusion = true;
+    float bootstrap_occluder_size = 64.0f;
+    static constexpr float cameraCutDistance = 2.0f;
+    static constexpr float cameraCutMinCosAngle = 0.8f;
+    glm::vec3 lastCameraPosition{};
+    glm::vec3 lastCameraFront{};
+    // extra LOD levels dropped when culling for the shadow map
+    int shadow_lod_bias = 1;
+
+    // what the late cull does with meshes covering fewer than contribution_cull_pixels pixels.
+    // Matches CONTRIBUTION_CULL_* in lod_indirect.glsl
+    static constexpr int contributionCullOff = 0;
+    static constexpr int contributionCullDrop = 1;
+    static constexpr int contributionCullPointSplat = 2;
+    int contribution_cull_mode = contributionCullPointSplat;
+    float contribution_cull_pixels = 2.0f;
+    // largest side in (0, 1) screen units below which instances are drawn as impostors
+    float impostor_screen_size = 0.02f;
+    // the simplification error, in pixels, a mesh LOD may show on screen. The cull draws the
+    // coarsest LOD within it, see lodIndexFromError in lod_indirect.glsl
+    float lod_error_pixels = 1.0f;
+    // instances that want LOD 0 somewhere are drawn as a cut through the cluster hierarchy
+    // instead, so only their near parts get full detail
+    bool cluster_lod = true;
+    // cull in to one instanced draw per LOD rather than one draw per instance
+    bool instance_bucketing = true;
+    // bin each pass's draws by view depth so near chickens rasterize first
+    bool depth_sort = true;
+    // count the fragments the geometry passes shade, an atomic per fragment so off by default
+    bool overdraw_stats = false;
+    // geometry passes write only a packed instance and triangle id, and the lighting subpass
+    // fetches the attributes it needs from the vertex and index buffers. visibility_buffer is
+    // what the overlay asks for, visibilityBufferActive what the swap chain resources were built
+    // with. They differ for one frame after a toggle, until applyModeChange rebuilds them
+    bool visibility_buffer = false;
+    bool visibilityBufferActive = false;
+
+    // G-buffer attachment formats, selectable to compare bandwidth between GPUs. Both store
+    // specular in albedo alpha and octahedral normals in the normal target's red and green.
+    // Position is always rebuilt from depth
+    struct GBufferProfile {
+        const char* name;
+        VkFormat albedo;
+        VkFormat normal;
+        uint32_t bytesPerPixel;
+    };
+    static constexpr int gbufferProfileWide = 0;
+    static constexpr int gbufferProfileCompact = 1;
+    static constexpr std::array<GBufferProfile, 2> gbufferProfiles = {{
+        { "Wide", VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_A2R10G10B10_UNORM_PACK32, 20 },
+        { "Compact", VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16_UNORM, 8 },
+    }};
+    // requested and built-with, as for the visibility buffer
+    int gbuffer_profile = gbufferProfileWide;
+    int gbufferProfileActive = gbufferProfileWide;
+
+    // the pipelines that read display_mode, specialised on it so the debug views cost nothing
+    // in the composed view. Built the first time a mode is shown and kept until the swap chain
+    // is recreated, the layouts come from the shared programs so descriptor sets still match
+    struct DisplayModePipelines {
+        VkPipeline cull = VK_NULL_HANDLE;
+        VkPipeline earlyGeometry = VK_NULL_HANDLE;
+        VkPipeline lateGeometry = VK_NULL_HANDLE;
+        VkPipeline lighting = VK_NULL_HANDLE;
+    };
+    std::unordered_map<int, DisplayModePipelines> displayModePipelines;
+    // the mode the pre-recorded command buffers were recorded with
+    int displayModeActive = 0;
+
+    // every pipeline goes through the one cache, saved on exit and reloaded on the next run.
+    // MC_PIPELINE_CACHE overrides where the file lives
+    std::unique_ptr<mc::PipelineCache> pipelineCache;
+
+    // textures and asset buffers that shaders index by slot, set 1 of the geometry and lighting
+    // layouts
+    std::unique_ptr<mc::BindlessTable> bindlessTable;
+    // asset copies go through here rather than a queue idle per upload
+    std::unique_ptr<mc::UploadService> uploadService;
+    // the GPU material table, and the entry each instance draws with, both read through the
+    // bindless table so more assets need no new bindings
+    VkBuffer materialSSBO;
+    VkDeviceMemory materialSSBOMemory;
+    VkBuffer instanceMaterialSSBO;
+    VkDeviceMemory instanceMaterialSSBOMemory;
+    uint32_t materialBufferSlot = 0;
+    uint32_t instanceMaterialBufferSlot = 0;
+    void createMaterialBuffers();
+    // wall clock of initVulkan, and of the pipeline builds within it (display mode variants
+    // included as they are first built), shown in the overlay to compare cold and warm starts
+    double startupTimeMs = 0.0;
+    double pipelineCreationTimeMs = 0.0;
+
+    // the cull's top down debug image and the projected bounds the SSAABB views outline, and
+    // the depth pyramid views too while the top down view is open. Without them the cull and
+    // lighting load the plain shader builds, which have neither binding, and the image and
+    // buffer are not created. Requested and built-with, as for the visibility buffer
+    bool cull_debug_view = false;
+    bool cullInstrumentationActive = false;
+    bool wantsCullInstrumentation() const { return cull_debug_view || (display_mode >= 20 && display_mode < 23); }
+
+    // point lights scattered over the flock. point_light_count is what the overlay or
+    // MC_POINT_LIGHTS asks for, pointLightCount what the light buffer holds
+    int point_light_count = 0;
+    uint32_t pointLightCount = 0;
+
+    // the shadow map is cached between frames. Tiles are marked dirty when a caster moves, and
+    // the whole map when the light or shadow settings change
+    static constexpr uint32_t shadowCacheTilesPerSide = 8;
+    static constexpr uint64_t shadowCacheAllTiles = ~uint64_t(0);
+    uint64_t shadowDirtyTiles = shadowCacheAllTiles;
+    glm::mat4 shadowCacheLightVP{};
+    int shadowCacheLodBias = -1;
+    float shadowCacheLodErrorPixels = -1.0f;
+    size_t shadowCacheHits = 0;
+    size_t shadowCacheInvalidations = 0;
+    uint32_t shadowCacheLastDirtyTileCount = 0;
 
     UniformBufferObject ubo{};
 
@@ -292,7 +546,15 @@ private:
     void createGeometryPass(bool clearAttachmentsOnLoad, VkRenderPass& renderPass);
     void createEarlyGeometryPass();
     void createLateGeometryPass();
+    void createDepthTargets();
+    void destroyGeometryTargets();
     void createShadowPass();
+    // bakes the octahedral impostor atlas, needs the texture, vertex and index buffers
+    void createImpostorAtlas();
+    DisplayModePipelines createDisplayModePipelines(int displayMode);
+    const DisplayModePipelines& getDisplayModePipelines(int displayMode);
+    void destroyDisplayModePipelines();
+    const char* lightingFragShaderPath() const;
 
     VkFormat findDepthFormat();
 
@@ -337,18 +599,10 @@ private:
 
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
 
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-
-    VkCommandBuffer beginSingleTimeCommands();
-
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-
     void createCommandPool(VkCommandPool* commandPool, VkCommandPoolCreateFlags flags);
 
     void createCommandBuffers(VkCommandBuffer* commandBuffer, uint32_t commandBufferCount, VkCommandPool& commandPool);
 
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
     // clean up swap chain for a clean recreate
@@ -380,10 +634,16 @@ private:
 
     // recreate swap chain incase it is invalidated
     void recreateSwapChain();
+    // rebuilds what the visibility buffer, G-buffer profile and cull instrumentation toggles change
+    void applyModeChange();
 
     void createDescriptorSets();
 
+    // builds the compute and graphics pipelines side by side on worker threads
+    void createPipelines();
+
     void createComputePipeline();
+    void createCullProgram();
 
     // create the graphics pipeline.
     void createGraphicsPipeline();
@@ -396,15 +656,33 @@ private:
 
     // create command buffers
     void createCommandBuffers();
+    void recordCommandBuffers();
+
+    // records the light cull and shadow render for the given tiles of the cached shadow map
+    void recordShadowCommandBuffer(uint32_t imageIndex, uint64_t dirtyTiles);
+
+    // returns the shadow map tiles a sphere's light space bounds touch
+    uint64_t shadowTileMask(const glm::vec3& center, float radius) const;
 
     void createSyncObjects();
 
     void updateUniformBuffer(uint32_t currentImage);
 
+    void randomiseInstances();
     void updateSSBO();
 
     void updateLODSSBO();
 
+    // fills the light buffer with point_light_count lights
+    void updateLightSSBO();
+
+    // tiles across and down the swap chain that lights are binned in to
+    glm::uvec2 getLightTileCount() const;
+
+    // instances a camera pass can draw as cluster cuts, as many as the largest cut fits
+    // maxClusterDraws. The rest fall back to LOD 0
+    uint32_t getClusterInstanceCapacity() const;
+
     uint32_t getPow2Size(uint32_t width, uint32_t height);
 
     // create a VkShaderModule to encapsulate our shaders
@@ -10,6 +10,9 @@ struct QueueFamilyIndices {
     // information on presentation queue
     // this is used to check that we can draw to our surface
     std::optional<uint32_t> presentFamily;
+    // queue for uploads, a transfer only family if the device has one and the graphics family
+    // otherwise. Not required for isComplete
+    std::optional<uint32_t> transferFamily;
 
     // query whether all families have a value
     bool isComplete() {
@@ -0,0 +1,141 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Bins the projected bounds the late cull writes for the SSAABB display modes in to screen
+// tiles, so the overlay in lighting_pass.frag only tests the rectangles near each pixel
+// instead of every instance. The overlay draws just a thin outline of each rectangle, so a
+// rectangle is appended to the tiles its outline passes through and skips the ones wholly
+// inside it. A thread's work follows the rectangle's perimeter in tiles, not its area.
+
+// same grid as the light tiles, ubo.light_tile_count_x/y cover it
+const uint AABB_TILE_SIZE = 16;
+const uint MAX_AABBS_PER_TILE = 256;
+// how far inside a rectangle its outline reaches, in (0, 1) screen units. Matches the
+// overlay in lighting_pass.frag
+const float AABB_OUTLINE_WIDTH = 0.002;
+
+layout(local_size_x = 64) in;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+} ubo;
+
+struct SphereProjectionDebugData
+{
+    vec4 projectedAABB;
+};
+
+// (max x, max y, min x, min y), negated for instances the late cull rejected
+layout(std430, binding = 1) readonly buffer SphereProjectionDebugBuffer
+{
+	SphereProjectionDebugData data[];
+} sphereProjectionDebugBuffer;
+
+// laid out as the light tile buffer: a count per tile, then MAX_AABBS_PER_TILE instance
+// indices per tile. Counts are zeroed before each dispatch and can pass MAX_AABBS_PER_TILE
+layout(std430, binding = 2) buffer AabbTileBuffer
+{
+	uint data[];
+} aabbTileBuffer;
+
+uvec2 tileOf(vec2 screen, uvec2 tileCount)
+{
+    return min(uvec2(clamp(screen, 0.0, 1.0) * ubo.win_dim) / AABB_TILE_SIZE, tileCount - 1u);
+}
+
+void main()
+{
+    uint instance = gl_GlobalInvocationID.x;
+    if (instance >= sphereProjectionDebugBuffer.data.length())
+    {
+        return;
+    }
+
+    vec4 aabb = abs(sphereProjectionDebugBuffer.data[instance].projectedAABB);
+    vec2 boxMin = aabb.zw;
+    vec2 boxMax = aabb.xy;
+
+    // no pixel is ever inside an empty or off screen rectangle
+    if (any(greaterThanEqual(boxMin, boxMax)) ||
+        any(greaterThan(boxMin, vec2(1.0))) || any(lessThan(boxMax, vec2(0.0))))
+    {
+        return;
+    }
+
+    uvec2 tileCount = uvec2(ubo.light_tile_count_x, ubo.light_tile_count_y);
+    uvec2 minTile = tileOf(boxMin, tileCount);
+    uvec2 maxTile = tileOf(boxMax, tileCount);
+    // tiles strictly between these are covered by the rectangle's inside, with no outline
+    uvec2 innerMinTile = tileOf(boxMin + AABB_OUTLINE_WIDTH, tileCount);
+    uvec2 innerMaxTile = tileOf(boxMax - AABB_OUTLINE_WIDTH, tileCount);
+
+    uint listStart = tileCount.x * tileCount.y;
+
+    for (uint y = minTile.y; y <= maxTile.y; ++y)
+    {
+        bool edgeRow = y <= innerMinTile.y || y >= innerMaxTile.y;
+
+        for (uint x = minTile.x; x <= maxTile.x; ++x)
+        {
+            // between the top and bottom edges only the left and right edge tiles are binned
+            if (!edgeRow && x > innerMinTile.x && x < innerMaxTile.x)
+            {
+                x = innerMaxTile.x - 1u;
+                continue;
+            }
+
+            uint tileIndex = y * tileCount.x + x;
+            uint slot = atomicAdd(aabbTileBuffer.data[tileIndex], 1u);
+            if (slot < MAX_AABBS_PER_TILE)
+            {
+                aabbTileBuffer.data[listStart + tileIndex * MAX_AABBS_PER_TILE + slot] = instance;
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#version 450
+
+// Cuts through the cluster hierarchy of every instance lod_indirect.glsl sent down the cluster
+// path. Dispatched indirectly with a row of workgroups per instance and an invocation per
+// cluster, so each cluster of each instance is measured once. A cluster is drawn when its own
+// error is within budget on screen and its parent's is not, see mc::ClusterDag. Each cluster
+// is measured from its own sphere, so the parts of a big mesh far from the camera are drawn
+// coarser than the parts close to it.
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+struct VkDrawIndexedIndirectCommand
+{
+	uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint meshId;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std140, binding = 0) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+layout(std140, binding = 1) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+    uint material_buffer;
+    uint instance_material_buffer;
+    float lod_error_pixels;
+    int cluster_lod;
+} ubo;
+
+struct LodConfigData
+{
+    float error;
+    uint offset;
+    uint size;
+    int vertexOffset;
+};
+
+layout(std140, binding = 2) readonly buffer LodConfigBuffer
+{
+	LodConfigData data[];
+} lodConfigData;
+
+layout(binding = 3) readonly buffer ModelScalesBuffer
+{
+	float data[];
+} modelScalesBuffer;
+
+struct ClusterData
+{
+    vec4 selfSphere;
+    vec4 parentSphere;
+    float selfError;
+    float parentError;
+    uint firstIndex;
+    uint indexCount;
+};
+
+layout(std430, binding = 4) readonly buffer ClusterBuffer
+{
+    ClusterData data[];
+} clusterBuffer;
+
+// the mesh ids the cull sent down the cluster path, one per workgroup row
+layout(std430, binding = 5) readonly buffer ClusterInstanceBuffer
+{
+    uint data[];
+} clusterInstanceBuffer;
+
+// see lod_indirect.glsl
+layout(std430, binding = 6) buffer ClusterDrawBuffer
+{
+    uint count;
+    uint instanceCount;
+    uint pad0[2];
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+    uint pad1;
+    VkDrawIndexedIndirectCommand draws[];
+} clusterDrawBuffer;
+
+// How many pixels an error in model units covers at the nearest point of a model space sphere,
+// seen from the culling view.
+float projectedClusterError(mat4 modelView, float scale, vec4 sphere, float error)
+{
+    vec4 center = modelView * vec4(sphere.xyz, 1.0);
+    float dist = max(length(center.xyz / center.w) - sphere.w * scale, ubo.zNear);
+    return error * scale * abs(ubo.culling_p11) * 0.5 * ubo.win_dim.y / dist;
+}
+
+void main()
+{
+    uint cluster = gl_GlobalInvocationID.x;
+    if (cluster >= clusterBuffer.data.length())
+    {
+        return;
+    }
+
+    uint meshId = clusterInstanceBuffer.data[gl_WorkGroupID.y];
+    mat4 modelView = ubo.culling_view * modelTranformsBuffer.data[meshId];
+    float scale = modelScalesBuffer.data[meshId];
+    ClusterData data = clusterBuffer.data[cluster];
+
+    // a root's parent error is FLT_MAX and so never within budget
+    if (projectedClusterError(modelView, scale, data.parentSphere, data.parentError) <= ubo.lod_error_pixels ||
+        projectedClusterError(modelView, scale, data.selfSphere, data.selfError) > ubo.lod_error_pixels)
+    {
+        return;
+    }
+
+    // the cull only takes as many instances as full detail cuts fit, so this never drops part
+    // of a cut unless the hierarchy breaks that bound
+    uint draw = atomicAdd(clusterDrawBuffer.count, 1);
+    if (draw >= clusterDrawBuffer.draws.length())
+    {
+        return;
+    }
+
+    clusterDrawBuffer.draws[draw].indexCount = data.indexCount;
+    clusterDrawBuffer.draws[draw].instanceCount = 1;
+    clusterDrawBuffer.draws[draw].firstIndex = data.firstIndex;
+    // clusters index LOD 0's vertex range
+    clusterDrawBuffer.draws[draw].vertexOffset = lodConfigData.data[0].vertexOffset;
+    clusterDrawBuffer.draws[draw].firstInstance = 0;
+    clusterDrawBuffer.draws[draw].meshId = meshId;
+}
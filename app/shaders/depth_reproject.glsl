@@ -0,0 +1,124 @@
+#version 450
+
+// Scatters one mip of last frame's depth pyramid in to the same mip of a pyramid seen from
+// this frame's culling view, for the early cull. Each texel is unprojected at its depth with
+// the view the pyramid was built from, and its corners projected again with the culling view.
+// Every target texel under the footprint keeps the furthest depth landing on it, as a float
+// bit pattern so imageAtomicMax orders it. Target texels nothing lands on stay 0, which the
+// cull reads as the far plane.
+
+layout(local_size_x = 32, local_size_y = 32, local_size_z = 1) in;
+
+layout(binding = 0, r32ui) uniform uimage2D outImage;
+layout(binding = 1) uniform sampler2D inImage;
+
+layout(std140, binding = 2) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+} ubo;
+
+// Footprints wider than this many target texels are stretched over a depth discontinuity or
+// right in front of the camera. They are dropped rather than smeared over what lies behind.
+const int MAX_FOOTPRINT = 4;
+
+shared mat4 reprojection;
+
+void main()
+{
+	if (gl_LocalInvocationIndex == 0)
+	{
+		reprojection = ubo.culling_proj * ubo.culling_view * inverse(ubo.prev_proj * ubo.prev_view);
+	}
+	barrier();
+
+	ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(outImage);
+
+	if (!bool(ubo.early_reprojection) || pos.x >= size.x || pos.y >= size.y)
+	{
+		return;
+	}
+
+	// the far plane, or texels past the frame the pyramid build filled with a marker
+	float depth = texelFetch(inImage, pos, 0).x;
+	if (depth >= 1.0)
+	{
+		return;
+	}
+
+	vec2 ndcMin = vec2(1.0);
+	vec2 ndcMax = vec2(-1.0);
+	float furthest = 0.0;
+
+	for (int corner = 0; corner < 4; ++corner)
+	{
+		vec2 uv = (vec2(pos) + vec2(corner & 1, corner >> 1)) / vec2(size);
+		vec4 clip = reprojection * vec4(uv * 2.0 - 1.0, depth, 1.0);
+
+		// behind the camera now, nothing sensible to say about where it lands
+		if (clip.w <= 0.0)
+		{
+			return;
+		}
+
+		vec3 ndc = clip.xyz / clip.w;
+		ndcMin = min(ndcMin, ndc.xy);
+		ndcMax = max(ndcMax, ndc.xy);
+		furthest = max(furthest, ndc.z);
+	}
+
+	if (furthest >= 1.0)
+	{
+		return;
+	}
+
+	ivec2 first = ivec2(floor((ndcMin * 0.5 + 0.5) * vec2(size)));
+	ivec2 last = ivec2(floor((ndcMax * 0.5 + 0.5) * vec2(size)));
+
+	if (any(greaterThanEqual(last - first, ivec2(MAX_FOOTPRINT))))
+	{
+		return;
+	}
+
+	first = max(first, ivec2(0));
+	last = min(last, size - 1);
+
+	for (int y = first.y; y <= last.y; ++y)
+	{
+		for (int x = first.x; x <= last.x; ++x)
+		{
+			imageAtomicMax(outImage, ivec2(x, y), floatBitsToUint(furthest));
+		}
+	}
+}
@@ -0,0 +1,214 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Coarse front-to-back ordering of the draws a cull pass emitted, so near chickens fill the
+// depth buffer before the ones they hide are rasterized. Workgroup 0 sorts the per-mesh
+// command list, workgroup n sorts the instance list of LOD bucket n - 1. Each list is
+// counting sorted in to SORT_BINS view depth bins through a scratch buffer and copied back in
+// place, so the geometry pass reads it exactly as it would the unsorted list.
+
+const uint SORT_BINS = 64;
+const uint SORT_THREADS = 256;
+// far plane of the projection built in updateUniformBuffer
+const float SORT_FAR_DISTANCE = 250.0;
+
+layout(local_size_x = 256) in;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+} ubo;
+
+layout(std140, binding = 1) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+struct VkDrawIndexedIndirectCommand
+{
+	uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint meshId;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, binding = 2) buffer IndirectBuffer
+{
+	VkDrawIndexedIndirectCommand data[];
+} indirectBuffer;
+
+layout(std430, binding = 3) readonly buffer IndirectBufferCountBuffer
+{
+	uint data;
+} indirectBufferCountBuffer;
+
+struct LodBucketCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 4) readonly buffer LodBucketBuffer
+{
+    LodBucketCommand draws[];
+} lodBucketBuffer;
+
+layout(std430, binding = 5) buffer BucketInstanceBuffer
+{
+    uint data[];
+} bucketInstanceBuffer;
+
+// same layouts as the lists they sort, the lists are scattered in to these and copied back
+layout(std430, binding = 6) buffer CommandScratchBuffer
+{
+	VkDrawIndexedIndirectCommand data[];
+} commandScratchBuffer;
+
+layout(std430, binding = 7) buffer InstanceScratchBuffer
+{
+    uint data[];
+} instanceScratchBuffer;
+
+shared uint binCounts[SORT_BINS];
+shared uint binOffsets[SORT_BINS];
+
+// Bins are spaced logarithmically between the near and far plane, so the resolution is
+// where the overdraw is, close to the camera.
+uint depthBin(uint meshId)
+{
+    vec4 mvPos = ubo.view * modelTranformsBuffer.data[meshId] * vec4(0.0, 0.0, 0.0, 1.0);
+    float depth = clamp(-mvPos.z, ubo.zNear, SORT_FAR_DISTANCE);
+    float t = log2(depth / ubo.zNear) / log2(SORT_FAR_DISTANCE / ubo.zNear);
+
+    return min(uint(t * float(SORT_BINS)), SORT_BINS - 1);
+}
+
+uint meshIdAt(bool commandList, uint slot)
+{
+    return commandList ? indirectBuffer.data[slot].meshId : bucketInstanceBuffer.data[slot];
+}
+
+void main()
+{
+    if (!bool(ubo.depth_sort))
+    {
+        return;
+    }
+
+    bool commandList = gl_WorkGroupID.x == 0;
+    uint first = commandList ? 0 : lodBucketBuffer.draws[gl_WorkGroupID.x - 1].firstInstance;
+    uint count = commandList ? indirectBufferCountBuffer.data : lodBucketBuffer.draws[gl_WorkGroupID.x - 1].instanceCount;
+
+    // only one of the two lists is in use, depending on ubo.instance_bucketing
+    if (count < 2)
+    {
+        return;
+    }
+
+    for (uint bin = gl_LocalInvocationIndex; bin < SORT_BINS; bin += SORT_THREADS)
+    {
+        binCounts[bin] = 0;
+    }
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < count; i += SORT_THREADS)
+    {
+        atomicAdd(binCounts[depthBin(meshIdAt(commandList, first + i))], 1);
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        uint offset = 0;
+        for (uint bin = 0; bin < SORT_BINS; ++bin)
+        {
+            binOffsets[bin] = offset;
+            offset += binCounts[bin];
+        }
+    }
+    barrier();
+
+    // order within a bin is whatever the atomics give, the bins are what matter for early-Z
+    for (uint i = gl_LocalInvocationIndex; i < count; i += SORT_THREADS)
+    {
+        uint slot = first + i;
+        uint sortedSlot = first + atomicAdd(binOffsets[depthBin(meshIdAt(commandList, slot))], 1);
+
+        if (commandList)
+        {
+            commandScratchBuffer.data[sortedSlot] = indirectBuffer.data[slot];
+        }
+        else
+        {
+            instanceScratchBuffer.data[sortedSlot] = bucketInstanceBuffer.data[slot];
+        }
+    }
+    memoryBarrierBuffer();
+    barrier();
+
+    for (uint i = gl_LocalInvocationIndex; i < count; i += SORT_THREADS)
+    {
+        uint slot = first + i;
+
+        if (commandList)
+        {
+            indirectBuffer.data[slot] = commandScratchBuffer.data[slot];
+        }
+        else
+        {
+            bucketInstanceBuffer.data[slot] = instanceScratchBuffer.data[slot];
+        }
+    }
+}
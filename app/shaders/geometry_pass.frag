@@ -1,5 +1,9 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// depth test before shading, so the overdraw count below only sees fragments that pass it
+layout(early_fragment_tests) in;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 inNormal;
@@ -7,11 +11,14 @@ layout(location = 2) in vec2 fragTexCoord;
 layout(location = 3) in flat float texture_on;
 layout(location = 4) in float specularity;
 layout(location = 5) flat in uint ID;
+layout(location = 6) flat in uint inMeshId;
 
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outNormal;
 
-layout(binding = 1) uniform sampler2D texSampler;
+// see lod_indirect.glsl
+layout(constant_id = 0) const int DISPLAY_MODE = 24;
+layout(constant_id = 1) const bool DEBUG_MESH_COLOURS = false;
 
 layout(std140, binding = 0) uniform UniformBufferObject {
     mat4 model;
@@ -20,12 +27,15 @@ layout(std140, binding = 0) uniform UniformBufferObject {
     mat4 culling_model;
     mat4 culling_view;
     mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
     mat4 light;
     mat4 lightVP;
 	vec4 Ka;
 	vec4 Kd;
 	vec4 Ks;
 	vec4 Ke;
+    vec4 top_down_model_bounds;
     vec2 win_dim;
     float Ns;
 	float model_stage_on;
@@ -43,44 +53,101 @@ layout(std140, binding = 0) uniform UniformBufferObject {
 	float zNear;
 	int display_mode;
     int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+    uint material_buffer;
+    uint instance_material_buffer;
 } ubo;
 
-struct SphereProjectionDebugData
+// the bindless table, see BindlessTable.h. Every buffer slot is the same binding, each block
+// type below is a view of it and ubo holds the slots to read
+struct Material
 {
-    vec4 projectedAABB;
-    //vec4 depthData;
+    vec4 baseColour;
+    uint albedoTexture;
 };
 
-layout(std430, binding = 3) buffer SphereProjectionDebugBuffer
+layout(set = 1, binding = 0) uniform sampler2D bindlessTextures[];
+
+layout(std430, set = 1, binding = 1) readonly buffer MaterialBuffer
+{
+    Material data[];
+} materialBuffers[];
+
+layout(std430, set = 1, binding = 1) readonly buffer InstanceMaterialBuffer
+{
+    uint data[];
+} instanceMaterialBuffers[];
+
+layout(std430, binding = 6) buffer CullStatsBuffer
+{
+    uint contributionCulled;
+    uint pointSplats;
+    uint gbufferFragments;
+} cullStatsBuffer;
+
+// octahedral normal encoding in to [0, 1], so the same value suits every G-buffer profile's
+// normal format. Matches decodeNormal in lighting_pass.frag
+vec2 octWrap(vec2 v)
 {
-	SphereProjectionDebugData data[];
-} sphereProjectionDebugBuffer;
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
 
 void main() {
-    if (ubo.display_mode == 23)
+    if (bool(ubo.overdraw_stats))
+    {
+        atomicAdd(cullStatsBuffer.gbufferFragments, 1);
+    }
+
+    if (DISPLAY_MODE == 23)
     {
         //outColor = vec4(vec3(float(sphereProjectionDebugBuffer.data[ID].lodLevel + 1) / 10.0), 1.0);
     }
     else
     {
+        uint materialIndex = instanceMaterialBuffers[ubo.instance_material_buffer].data[inMeshId];
+        Material material = materialBuffers[ubo.material_buffer].data[materialIndex];
+
         if (texture_on > 0)
         {
-            outColor = vec4(fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
+            // the texture slot varies per instance, so the index is marked non-uniform
+            outColor = vec4(fragColor * material.baseColour.rgb * texture(bindlessTextures[nonuniformEXT(material.albedoTexture)], fragTexCoord).rgb, 1.0);
         }
         else
         {
-            outColor = vec4(fragColor, 1.0);
+            outColor = vec4(fragColor * material.baseColour.rgb, 1.0);
         }
     }
 
-    if (sphereProjectionDebugBuffer.data.length() < 6)
+    if (DEBUG_MESH_COLOURS)
     {
         vec4 abc[5] = vec4[](vec4(1.0, 0.0, 0.0, 1.0), vec4(0.0, 1.0, 0.0, 1.0), vec4(0.0, 0.0, 1.0, 1.0), vec4(1.0, 1.0, 0.0, 1.0), vec4(0.0, 1.0, 1.0, 1.0));
-        outNormal.rgb = abc[ID].rgb;
+        // ID is the LOD for bucketed draws, and chains can be longer than the palette
+        outNormal = vec4(encodeNormal(normalize(abc[ID % 5].rgb * 2.0 - 1.0)), 0.0, 1.0);
     }
     else
     {
-        outNormal.rgb = normalize(inNormal) * 0.5 + vec3(0.5);
+        outNormal = vec4(encodeNormal(normalize(inNormal)), 0.0, 1.0);
     }
 
     outColor.a = specularity;
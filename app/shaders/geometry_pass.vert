@@ -3,6 +3,19 @@
 #extension GL_KHR_vulkan_glsl : enable
 #extension GL_ARB_shader_draw_parameters: require
 
+// Where a draw's mesh id comes from. Matches VulkanObject::drawSource*.
+const uint DRAW_SOURCE_COMMANDS = 0;
+const uint DRAW_SOURCE_BUCKETS = 1;
+const uint DRAW_SOURCE_CLUSTERS = 2;
+
+layout(push_constant) uniform block
+{
+	uint DRAW_SOURCE;
+};
+
+// see lod_indirect.glsl
+layout(constant_id = 0) const int DISPLAY_MODE = 24;
+
 layout(std140, binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
@@ -10,12 +23,15 @@ layout(std140, binding = 0) uniform UniformBufferObject {
     mat4 culling_model;
     mat4 culling_view;
     mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
     mat4 light;
     mat4 lightVP;
 	vec4 Ka;
 	vec4 Kd;
 	vec4 Ks;
 	vec4 Ke;
+    vec4 top_down_model_bounds;
     vec2 win_dim;
     float Ns;
 	float model_stage_on;
@@ -33,6 +49,21 @@ layout(std140, binding = 0) uniform UniformBufferObject {
 	float zNear;
 	int display_mode;
     int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
 } ubo;
 
 layout(std140, binding = 2) readonly buffer ModelTranformsBuffer
@@ -57,6 +88,34 @@ layout(std430, binding = 4) readonly buffer IndirectBuffer
 	VkDrawIndexedIndirectCommand data[];
 } indirectBuffer;
 
+// per-LOD instance lists, indexed by gl_InstanceIndex which includes the bucket's firstInstance
+layout(std430, binding = 5) readonly buffer BucketInstanceBuffer
+{
+	uint data[];
+} bucketInstanceBuffer;
+
+struct LodConfigData
+{
+    float error;
+    uint offset;
+    uint size;
+    int vertexOffset;
+};
+
+// a bucket draw's gl_DrawIDARB is its LOD, for finding where its triangles start
+layout(std140, binding = 7) readonly buffer LodConfigBuffer
+{
+	LodConfigData data[];
+} lodConfigData;
+
+// cluster hierarchy draws, after the 32 byte header, see lod_indirect.glsl
+layout(std430, binding = 8) readonly buffer ClusterDrawBuffer
+{
+    uint count;
+    uint pad[7];
+    VkDrawIndexedIndirectCommand draws[];
+} clusterDrawBuffer;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -68,6 +127,10 @@ layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out float texture_on;
 layout(location = 4) out float specularity;
 layout(location = 5) flat out uint ID;
+// for the visibility pass. Triangle ids index the shared index buffer, so they are the draw's
+// first triangle plus gl_PrimitiveID
+layout(location = 6) flat out uint outMeshId;
+layout(location = 7) flat out uint outFirstTriangle;
 
 mat4 rotationMatrix(vec3 axis, float angle)
 {
@@ -86,16 +149,22 @@ void main() {
     // TODO: make the chickens spin!
     //mat4 rotMat = rotationMatrix(normalize(vec3(0.1, 0.2, 0.3)), 25.0);
 
-    if (ubo.display_mode == 22)
+    uint meshId = DRAW_SOURCE == DRAW_SOURCE_BUCKETS ? bucketInstanceBuffer.data[gl_InstanceIndex] :
+        DRAW_SOURCE == DRAW_SOURCE_CLUSTERS ? clusterDrawBuffer.draws[gl_DrawIDARB].meshId :
+        indirectBuffer.data[gl_DrawIDARB].meshId;
+
+    if (DISPLAY_MODE == 22)
     {
-        gl_Position = ubo.proj * ubo.view * modelTranformsBuffer.data[indirectBuffer.data[gl_DrawIDARB].meshId] * vec4(normalize(inPosition) * 0.351285, 1.0);
+        gl_Position = ubo.proj * ubo.view * modelTranformsBuffer.data[meshId] * vec4(normalize(inPosition) * 0.351285, 1.0);
     }
     else
     {
-        gl_Position = ubo.proj * ubo.view * modelTranformsBuffer.data[indirectBuffer.data[gl_DrawIDARB].meshId] * vec4(inPosition, 1.0);
+        gl_Position = ubo.proj * ubo.view * modelTranformsBuffer.data[meshId] * vec4(inPosition, 1.0);
     }
 
-    outNormal = inNormal;
+    // in to world space with the instance's rotation. Instances are scaled uniformly, the
+    // fragment shader normalises
+    outNormal = mat3(modelTranformsBuffer.data[meshId]) * inNormal;
 
     specularity = ubo.specular;
 
@@ -104,4 +173,9 @@ void main() {
     fragTexCoord = inTexCoord;
     texture_on = int(ubo.texture_stage_on);
     ID = gl_DrawIDARB;
+
+    outMeshId = meshId;
+    outFirstTriangle = (DRAW_SOURCE == DRAW_SOURCE_BUCKETS ? lodConfigData.data[gl_DrawIDARB].offset :
+        DRAW_SOURCE == DRAW_SOURCE_CLUSTERS ? clusterDrawBuffer.draws[gl_DrawIDARB].firstIndex :
+        indirectBuffer.data[gl_DrawIDARB].firstIndex) / 3;
 }
\ No newline at end of file
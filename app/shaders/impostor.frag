@@ -0,0 +1,87 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 atlasTexCoord;
+layout(location = 1) in vec3 inViewPos;
+layout(location = 2) in vec3 viewTowardsCamera;
+layout(location = 3) in vec3 fragColor;
+layout(location = 4) in float texture_on;
+layout(location = 5) in float specularity;
+layout(location = 6) flat in mat3 instanceRotation;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outNormal;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+} ubo;
+
+layout(binding = 3) uniform sampler2D impostorAlbedo;
+layout(binding = 4) uniform sampler2D impostorNormalDepth;
+
+// same octahedral encoding as geometry_pass.frag
+vec2 octWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 albedo = texture(impostorAlbedo, atlasTexCoord);
+
+    if (albedo.a < 0.5)
+    {
+        discard;
+    }
+
+    vec4 normalDepth = texture(impostorNormalDepth, atlasTexCoord);
+
+    // move the quad's depth to the baked surface so impostors occlude and are occluded
+    // like the meshes they replace
+    vec3 surfaceViewPos = inViewPos + viewTowardsCamera * (normalDepth.a * 2.0 - 1.0);
+    vec4 surfaceClipPos = ubo.proj * vec4(surfaceViewPos, 1.0);
+    gl_FragDepth = surfaceClipPos.z / surfaceClipPos.w;
+
+    if (texture_on > 0)
+    {
+        outColor = vec4(fragColor * albedo.rgb, specularity);
+    }
+    else
+    {
+        outColor = vec4(fragColor, specularity);
+    }
+
+    // the atlas stores model space normals as xyz * 0.5 + 0.5, rotated in to world space like
+    // the mesh normals geometry_pass.vert writes
+    outNormal = vec4(encodeNormal(normalize(instanceRotation * (normalDepth.rgb * 2.0 - 1.0))), 0.0, 1.0);
+}
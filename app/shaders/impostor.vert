@@ -0,0 +1,108 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Draws instances the cull put in the impostor tier as camera facing quads, textured with the
+// nearest frame of the octahedral impostor atlas. Four vertices per instance, as a strip.
+
+// Matches VulkanObject::impostorFramesPerSide
+const uint IMPOSTOR_FRAMES_PER_SIDE = 8;
+const float BOUNDING_RADIUS = 0.351285;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+} ubo;
+
+layout(std140, binding = 1) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+struct VkDrawIndirectCommand
+{
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+};
+
+layout(std430, binding = 2) readonly buffer ImpostorBuffer
+{
+    VkDrawIndirectCommand draws[2];
+    uint meshIds[];
+} impostorBuffer;
+
+layout(location = 0) out vec2 atlasTexCoord;
+layout(location = 1) out vec3 outViewPos;
+layout(location = 2) out vec3 viewTowardsCamera;
+layout(location = 3) out vec3 fragColor;
+layout(location = 4) out float texture_on;
+layout(location = 5) out float specularity;
+// the atlas normals are baked in model space
+layout(location = 6) flat out mat3 instanceRotation;
+
+// unit direction to (0, 1) octahedral coordinates, y up
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+    {
+        p = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+    }
+    return p * 0.5 + 0.5;
+}
+
+void main()
+{
+    // gl_InstanceIndex includes the draw's firstInstance
+    uint meshId = impostorBuffer.meshIds[gl_InstanceIndex];
+    mat4 model = modelTranformsBuffer.data[meshId];
+
+    vec3 center = (model * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+    vec3 cameraPos = inverse(ubo.view)[3].xyz;
+    vec3 dir = normalize(inverse(mat3(model)) * (cameraPos - center));
+
+    uvec2 frame = uvec2(min(octEncode(dir) * float(IMPOSTOR_FRAMES_PER_SIDE), vec2(float(IMPOSTOR_FRAMES_PER_SIDE) - 1.0)));
+
+    // same basis the frames were baked with
+    vec3 up = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, dir));
+    up = cross(dir, right);
+
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+
+    vec4 viewPos = ubo.view * model * vec4((corner.x * right + corner.y * up) * BOUNDING_RADIUS, 1.0);
+    gl_Position = ubo.proj * viewPos;
+
+    atlasTexCoord = (vec2(frame) + 0.5 + 0.5 * corner) / float(IMPOSTOR_FRAMES_PER_SIDE);
+    outViewPos = viewPos.xyz;
+    viewTowardsCamera = mat3(ubo.view) * mat3(model) * dir * BOUNDING_RADIUS;
+
+    fragColor = vec3(ubo.diffuse, ubo.diffuse, ubo.diffuse);
+    texture_on = ubo.texture_stage_on;
+    specularity = ubo.specular;
+    instanceRotation = mat3(model);
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in float viewDepth;
+
+// alpha is coverage, cleared to zero around the mesh
+layout(location = 0) out vec4 outAlbedo;
+// normal encoded as in the G-buffer, alpha is depth towards the viewer in (0, 1)
+layout(location = 1) out vec4 outNormalDepth;
+
+layout(binding = 0) uniform sampler2D texSampler;
+
+void main()
+{
+    outAlbedo = vec4(texture(texSampler, fragTexCoord).rgb, 1.0);
+    outNormalDepth = vec4(normalize(inNormal) * 0.5 + vec3(0.5), viewDepth * 0.5 + 0.5);
+}
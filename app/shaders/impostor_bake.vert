@@ -0,0 +1,50 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Renders LOD 0 in to every frame of the octahedral impostor atlas in one draw, one instance
+// per frame. Each frame is an orthographic view of the mesh's bounding sphere from the
+// direction the frame's centre decodes to.
+
+// Matches VulkanObject::impostorFramesPerSide
+const uint IMPOSTOR_FRAMES_PER_SIDE = 8;
+const float BOUNDING_RADIUS = 0.351285;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out float viewDepth;
+
+// (0, 1) octahedral coordinates to a unit direction, y up
+vec3 octDecode(vec2 uv)
+{
+    vec2 f = uv * 2.0 - 1.0;
+    vec3 n = vec3(f.x, 1.0 - abs(f.x) - abs(f.y), f.y);
+    float t = max(-n.y, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.z += n.z >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    uvec2 frame = uvec2(gl_InstanceIndex % IMPOSTOR_FRAMES_PER_SIDE, gl_InstanceIndex / IMPOSTOR_FRAMES_PER_SIDE);
+    vec3 dir = octDecode((vec2(frame) + 0.5) / float(IMPOSTOR_FRAMES_PER_SIDE));
+
+    vec3 up = abs(dir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, dir));
+    up = cross(dir, right);
+
+    // (-1, 1) across the bounding sphere, z towards the viewer
+    vec3 local = vec3(dot(inPosition, right), dot(inPosition, up), dot(inPosition, dir)) / BOUNDING_RADIUS;
+
+    vec2 atlasPos = (vec2(frame) + 0.5 + 0.5 * local.xy) / float(IMPOSTOR_FRAMES_PER_SIDE);
+    gl_Position = vec4(atlasPos * 2.0 - 1.0, 0.5 - 0.5 * local.z, 1.0);
+
+    fragTexCoord = inTexCoord;
+    outNormal = inNormal;
+    viewDepth = local.z;
+}
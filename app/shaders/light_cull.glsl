@@ -0,0 +1,180 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+
+// Bins the point lights in to screen tiles for the lighting subpass. Each thread takes one
+// light, projects its view space bounds to a rectangle of tiles and appends the light to every
+// tile in it that has geometry within the light's reach. The depth pyramid keeps the furthest
+// depth under each texel, so a tile is rejected when all of it is nearer than the light's
+// nearest point. Work follows the number of tiles each light covers rather than lights times
+// tiles, and the lighting subpass only loops over its own tile's list.
+
+const uint LIGHT_TILE_SIZE = 16;
+const uint MAX_LIGHTS_PER_TILE = 256;
+// pyramid mip 0 is half resolution, so a level 3 texel covers one 16 pixel tile
+const int TILE_PYRAMID_LEVEL = 3;
+
+layout(local_size_x = 64) in;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+} ubo;
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 1) readonly buffer PointLightBuffer
+{
+	PointLight data[];
+} pointLightBuffer;
+
+// a light count per tile for the whole grid, followed by MAX_LIGHTS_PER_TILE light indices per
+// tile. Counts are zeroed before each dispatch and can pass MAX_LIGHTS_PER_TILE, readers clamp
+layout(std430, binding = 2) buffer LightTileBuffer
+{
+	uint data[];
+} lightTileBuffer;
+
+layout (set = 0, binding = 3) uniform sampler2D inDepthPyramid;
+
+// (0, 1) screen position and depth buffer value of a view space point
+vec3 projectToScreen(vec3 viewPos)
+{
+    vec4 clip = ubo.proj * vec4(viewPos, 1.0);
+    vec3 ndc = clip.xyz / clip.w;
+    return vec3(ndc.xy * 0.5 + 0.5, ndc.z);
+}
+
+// furthest depth in the tile. The pyramid sampler is a max reduction, so sampling the tile's
+// corners covers every texel under it
+float tileFarDepth(uvec2 tile)
+{
+    int level = min(TILE_PYRAMID_LEVEL, textureQueryLevels(inDepthPyramid) - 1);
+    vec2 tileMin = vec2(tile * LIGHT_TILE_SIZE) / ubo.win_dim;
+    vec2 tileMax = min(vec2((tile + 1u) * LIGHT_TILE_SIZE) / ubo.win_dim, vec2(1.0));
+
+    float depth = textureLod(inDepthPyramid, tileMin, level).x;
+    depth = max(depth, textureLod(inDepthPyramid, vec2(tileMax.x, tileMin.y), level).x);
+    depth = max(depth, textureLod(inDepthPyramid, vec2(tileMin.x, tileMax.y), level).x);
+    depth = max(depth, textureLod(inDepthPyramid, tileMax, level).x);
+
+    return depth;
+}
+
+void main()
+{
+    uint lightIndex = gl_GlobalInvocationID.x;
+    if (lightIndex >= ubo.point_light_count)
+    {
+        return;
+    }
+
+    vec4 positionRadius = pointLightBuffer.data[lightIndex].positionRadius;
+    vec3 center = (ubo.view * vec4(positionRadius.xyz, 1.0)).xyz;
+    float radius = positionRadius.w;
+
+    // view space looks down -z. The whole sphere is in front of the near plane
+    if (center.z - radius > -ubo.zNear)
+    {
+        return;
+    }
+
+    uvec2 tileCount = uvec2(ubo.light_tile_count_x, ubo.light_tile_count_y);
+    uvec2 minTile = uvec2(0);
+    uvec2 maxTile = tileCount - 1u;
+    // nothing nearer than the near plane is drawn, so a sphere crossing it can't reject a tile
+    float nearestDepth = 0.0;
+
+    // the box around the sphere only projects when it is all beyond the near plane, otherwise
+    // the light is tested against every tile
+    if (center.z + radius < -ubo.zNear)
+    {
+        vec2 minScreen = vec2(1e30);
+        vec2 maxScreen = vec2(-1e30);
+        for (uint corner = 0; corner < 8; ++corner)
+        {
+            vec3 offset = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+            vec2 screen = projectToScreen(center + offset * radius).xy;
+            minScreen = min(minScreen, screen);
+            maxScreen = max(maxScreen, screen);
+        }
+
+        if (any(greaterThan(minScreen, vec2(1.0))) || any(lessThan(maxScreen, vec2(0.0))))
+        {
+            return;
+        }
+
+        minTile = min(uvec2(clamp(minScreen, 0.0, 1.0) * ubo.win_dim) / LIGHT_TILE_SIZE, tileCount - 1u);
+        maxTile = min(uvec2(clamp(maxScreen, 0.0, 1.0) * ubo.win_dim) / LIGHT_TILE_SIZE, tileCount - 1u);
+        nearestDepth = projectToScreen(vec3(0.0, 0.0, center.z + radius)).z;
+    }
+
+    uint listStart = tileCount.x * tileCount.y;
+
+    for (uint y = minTile.y; y <= maxTile.y; ++y)
+    {
+        for (uint x = minTile.x; x <= maxTile.x; ++x)
+        {
+            // everything drawn in the tile is nearer than the light reaches
+            if (nearestDepth > tileFarDepth(uvec2(x, y)))
+            {
+                continue;
+            }
+
+            uint tileIndex = y * tileCount.x + x;
+            uint slot = atomicAdd(lightTileBuffer.data[tileIndex], 1u);
+            if (slot < MAX_LIGHTS_PER_TILE)
+            {
+                lightTileBuffer.data[listStart + tileIndex * MAX_LIGHTS_PER_TILE + slot] = lightIndex;
+            }
+        }
+    }
+}
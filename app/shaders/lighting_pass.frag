@@ -8,6 +8,8 @@ layout(std140, binding = 0) uniform UniformBufferObject {
     mat4 culling_model;
     mat4 culling_view;
     mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
     mat4 light;
     mat4 lightVP;
 	vec4 Ka;
@@ -32,6 +34,21 @@ layout(std140, binding = 0) uniform UniformBufferObject {
 	float zNear;
 	int display_mode;
     int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
 } ubo;
 
 layout (input_attachment_index = 0, set = 0, binding = 1) uniform subpassInput inColor;
@@ -45,17 +62,53 @@ layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragcolor;
 
+// see lod_indirect.glsl, every branch on it below folds away once specialised
+layout(constant_id = 0) const int DISPLAY_MODE = 24;
+
 struct SphereProjectionDebugData
 {
     vec4 projectedAABB;
     //vec4 depthData;
 };
 
+// only lighting_pass_instrumented_frag.spv has the projected bounds to outline, see
+// lod_indirect.glsl
+#ifdef CULL_INSTRUMENTATION
 layout(std430, binding = 8) buffer SphereProjectionDebugBuffer
 {
 	SphereProjectionDebugData data[];
 } sphereProjectionDebugBuffer;
 
+// the SSAABB overlay's rectangles binned by aabb_bin.glsl in to the light tile grid
+const uint MAX_AABBS_PER_TILE = 256;
+const float AABB_OUTLINE_WIDTH = 0.002;
+
+layout(std430, binding = 15) readonly buffer AabbTileBuffer
+{
+	uint data[];
+} aabbTileBuffer;
+#endif
+
+// matches light_cull.glsl, which fills the tile lists each frame
+const uint LIGHT_TILE_SIZE = 16;
+const uint MAX_LIGHTS_PER_TILE = 256;
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 13) readonly buffer PointLightBuffer
+{
+	PointLight data[];
+} pointLightBuffer;
+
+layout(std430, binding = 14) readonly buffer LightTileBuffer
+{
+	uint data[];
+} lightTileBuffer;
+
 float linearizeDepth(float z, float n, float f)
 {
     return (f * n)/(f * z - f - n * z);
@@ -74,6 +127,39 @@ vec4 position_from_depth(float depth)
     return vec4(vec3(position), 1.0);
 }
 
+// inverse of encodeNormal in geometry_pass.frag
+vec3 decodeNormal(vec2 encoded)
+{
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// diffuse light from the point lights binned in to this pixel's tile, with a falloff reaching
+// zero at each light's radius
+vec3 pointLighting(vec3 position, vec3 normal, vec3 albedo)
+{
+    uvec2 tile = uvec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE;
+    uint tileIndex = tile.y * ubo.light_tile_count_x + tile.x;
+    uint lightCount = min(lightTileBuffer.data[tileIndex], MAX_LIGHTS_PER_TILE);
+    uint listStart = ubo.light_tile_count_x * ubo.light_tile_count_y + tileIndex * MAX_LIGHTS_PER_TILE;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < lightCount; ++i)
+    {
+        PointLight pointLight = pointLightBuffer.data[lightTileBuffer.data[listStart + i]];
+        vec3 toLight = pointLight.positionRadius.xyz - position;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - distance / pointLight.positionRadius.w, 0.0, 1.0);
+        result += pointLight.color.rgb * (falloff * falloff * max(dot(normal, toLight / max(distance, 1e-4)), 0.0));
+    }
+
+    return result * albedo;
+}
+
 float calc_shadow_influence(vec4 position)
 {
 
@@ -103,49 +189,50 @@ void main()
 {
     vec4 tmpOutFragColor;
 
-	if(ubo.display_mode == 0)
+	if(DISPLAY_MODE == 0)
 	{
-		outFragcolor = vec4(subpassLoad(inNormal).rgb, 1.0);
+		outFragcolor = vec4(decodeNormal(subpassLoad(inNormal).rg) * 0.5 + vec3(0.5), 1.0);
 	}
-	else if(ubo.display_mode == 1)
+	else if(DISPLAY_MODE == 1)
 	{
         float z = linearizeDepth(subpassLoad(inDepth).r, -1.0, -250.0) / (250.0);
 		outFragcolor = vec4(z, z, z,  1.0);
 	}
-	else if(ubo.display_mode == 2)
+	else if(DISPLAY_MODE == 2)
 	{
 		outFragcolor = vec4(subpassLoad(inColor).a, subpassLoad(inColor).a, subpassLoad(inColor).a, 1.0);
 	}
-	else if(ubo.display_mode == 3)
+	else if(DISPLAY_MODE == 3)
 	{
 		outFragcolor = vec4(subpassLoad(inColor).rgb, 1.0);
 	}
-    else if(ubo.display_mode == 4)
+    else if(DISPLAY_MODE == 4)
 	{
         float depth_val = linearizeDepth(texture(inShadowDepth, inUV).r, 1.0, 250.0) / 250.0;
 		outFragcolor = vec4(depth_val, depth_val, depth_val, 1.0);
 	}
-    else if(ubo.display_mode == 5)
+    else if(DISPLAY_MODE == 5)
 	{
         outFragcolor = position_from_depth(subpassLoad(inDepth).r);
 	}
-    else if(ubo.display_mode >= 6 && ubo.display_mode < 20)
+    else if(DISPLAY_MODE >= 6 && DISPLAY_MODE < 20)
 	{
-        float depth_val = linearizeDepth(textureLod(inDepthPyramid, inUV, ubo.display_mode - 7).r, -1.0, -250.0) / 250.0;
+        float depth_val = linearizeDepth(textureLod(inDepthPyramid, inUV, DISPLAY_MODE - 7).r, -1.0, -250.0) / 250.0;
 
         vec3 final_col = vec3(depth_val, depth_val, depth_val);
 
-        if(textureLod(inDepthPyramid, inUV, ubo.display_mode - 7).r == 1.0)
+        if(textureLod(inDepthPyramid, inUV, DISPLAY_MODE - 7).r == 1.0)
         {
             final_col = vec3(1.0, 0.0, 0.0);
         }
 
-        float isGridLine = 1.0 - clamp(grid(inUV * ubo.win_dim, pow(2, ubo.display_mode - 6), 0.5), 0.0, 1.0);
-        float isUpperGridLine = 1.0 - clamp(grid(inUV * ubo.win_dim, pow(2, ubo.display_mode - 5), 1.0), 0.0, 1.0);
+        float isGridLine = 1.0 - clamp(grid(inUV * ubo.win_dim, pow(2, DISPLAY_MODE - 6), 0.5), 0.0, 1.0);
+        float isUpperGridLine = 1.0 - clamp(grid(inUV * ubo.win_dim, pow(2, DISPLAY_MODE - 5), 1.0), 0.0, 1.0);
 
         final_col = mix(final_col, vec3(0.5, 0.5, 0.0), isGridLine);
         final_col = mix(final_col, vec3(0.5, 0.5, 0.0), isUpperGridLine); 
 
+#ifdef CULL_INSTRUMENTATION
         vec2 clipSpace = inUV;
 
         float currentExtraBVal = 0.0f;
@@ -184,17 +271,22 @@ void main()
         {
             outFragcolor = vec4(final_col, 1.0);
         }        
+#else
+        outFragcolor = vec4(final_col, 1.0);
+#endif
 	}
 	else
 	{
         vec4 position = position_from_depth(subpassLoad(inDepth).r);
 
-        vec3 normal = (subpassLoad(inNormal).rgb - vec3(0.5)) / 0.5;
+        vec3 normal = decodeNormal(subpassLoad(inNormal).rg);
 
 		if(ubo.model_stage_on > 0)
         {
             if(ubo.lighting_stage_on > 0)
             {
+                vec3 local_light = pointLighting(position.xyz, normalize(mat3(ubo.model) * normal), subpassLoad(inColor).rgb);
+
                 vec4 shadow_clip_space = ubo.lightVP * vec4(position.xyz, 1.0);
                 vec4 shadow_NDC = shadow_clip_space / shadow_clip_space.w;
                 shadow_NDC.xy = shadow_NDC.xy * 0.5 + 0.5;
@@ -211,8 +303,8 @@ void main()
 
                     if(shadow_NDC.z > closest_dist + 0.00001)
                     {
-                        outFragcolor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ubo.ambient * ubo.Ka.xyz), vec3(0.0), vec3(1.0)), 1.0);
-                        tmpOutFragColor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ubo.ambient * ubo.Ka.xyz), vec3(0.0), vec3(1.0)), 1.0);
+                        outFragcolor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ubo.ambient * ubo.Ka.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
+                        tmpOutFragColor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ubo.ambient * ubo.Ka.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
                         return;
                     }
                 }
@@ -235,8 +327,8 @@ void main()
                     specular = clamp(subpassLoad(inColor).a * spec_val, 0.0, 1.0) * shadow;
                 }
 
-                outFragcolor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ambient * ubo.Ka.xyz + diffuse * ubo.Kd.xyz + specular * ubo.Ks.xyz), vec3(0.0), vec3(1.0)), 1.0);
-                tmpOutFragColor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ambient * ubo.Ka.xyz + diffuse * ubo.Kd.xyz + specular * ubo.Ks.xyz), vec3(0.0), vec3(1.0)), 1.0);
+                outFragcolor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ambient * ubo.Ka.xyz + diffuse * ubo.Kd.xyz + specular * ubo.Ks.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
+                tmpOutFragColor = vec4(clamp(ubo.Ke.xyz + subpassLoad(inColor).rgb * (ambient * ubo.Ka.xyz + diffuse * ubo.Kd.xyz + specular * ubo.Ks.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
              }
              else
              {
@@ -251,28 +343,41 @@ void main()
         }
 	}
 
-    if(ubo.display_mode >= 20 && ubo.display_mode < 23)
+#ifdef CULL_INSTRUMENTATION
+    if(DISPLAY_MODE >= 20 && DISPLAY_MODE < 23)
 	{
         vec2 clipSpace = inUV;
 
         float currentExtraRVal = 0.0f;
         float currentExtraBVal = 0.0f;
 
-        for (uint i = 0; i < sphereProjectionDebugBuffer.data.length(); ++i)
+        uvec2 tileCount = uvec2(ubo.light_tile_count_x, ubo.light_tile_count_y);
+        uvec2 tile = min(uvec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE, tileCount - 1u);
+        uint tileIndex = tile.y * tileCount.x + tile.x;
+        uint aabbCount = aabbTileBuffer.data[tileIndex];
+        uint listStart = tileCount.x * tileCount.y + tileIndex * MAX_AABBS_PER_TILE;
+
+        // the highest instance index wins where outlines cross, as when every instance was
+        // looped over in order. Tile order depends on the binning threads
+        int outlineInstance = -1;
+        for (uint i = 0; i < min(aabbCount, MAX_AABBS_PER_TILE); ++i)
         {
-          vec4 aabb_ = sphereProjectionDebugBuffer.data[i].projectedAABB;
-          vec4 aabb = abs(aabb_);
+            uint instance = aabbTileBuffer.data[listStart + i];
+            vec4 aabb_ = sphereProjectionDebugBuffer.data[instance].projectedAABB;
+            vec4 aabb = abs(aabb_);
             bool inBox = clipSpace.x < aabb[0] &&
                          clipSpace.x > aabb[2] &&
                          clipSpace.y < aabb[1] &&
                          clipSpace.y > aabb[3];
-            bool tooFarInBox = clipSpace.x < aabb[0] - 0.002 &&
-                               clipSpace.x > aabb[2] + 0.002 &&
-                               clipSpace.y < aabb[1] - 0.002 &&
-                               clipSpace.y > aabb[3] + 0.002;
-            if(inBox && !tooFarInBox)
+            bool tooFarInBox = clipSpace.x < aabb[0] - AABB_OUTLINE_WIDTH &&
+                               clipSpace.x > aabb[2] + AABB_OUTLINE_WIDTH &&
+                               clipSpace.y < aabb[1] - AABB_OUTLINE_WIDTH &&
+                               clipSpace.y > aabb[3] + AABB_OUTLINE_WIDTH;
+            if(inBox && !tooFarInBox && int(instance) > outlineInstance)
             {
+                outlineInstance = int(instance);
                 currentExtraRVal = 0.7;
+                currentExtraBVal = 0.0;
                 if (aabb != aabb_) {
                   currentExtraRVal = 0;
                   currentExtraBVal = 0.7;
@@ -280,10 +385,18 @@ void main()
             }
         }
 
+        // more rectangles crossed this tile than its list holds, so some outlines are missing
+        if (aabbCount > MAX_AABBS_PER_TILE)
+        {
+            currentExtraRVal = max(currentExtraRVal, 0.3);
+            tmpOutFragColor.y = min(1.0, tmpOutFragColor.y + 0.3);
+        }
+
         outFragcolor = vec4(
             min(1.0, tmpOutFragColor.x + currentExtraRVal),
             tmpOutFragColor.y,
             min(1.0, tmpOutFragColor.z + currentExtraBVal),
             tmpOutFragColor.w);
 	}
+#endif
 }
@@ -1,9 +1,40 @@
 #version 450
 #extension GL_KHR_vulkan_glsl : enable
 
+// Which pass this dispatch culls for. Matches VulkanObject::cullStage*.
+const uint CULL_STAGE_LATE = 0;
+const uint CULL_STAGE_EARLY = 1;
+const uint CULL_STAGE_SHADOW = 2;
+
+// What the late pass does with instances below the contribution threshold.
+// Matches VulkanObject::contributionCull*.
+const int CONTRIBUTION_CULL_OFF = 0;
+const int CONTRIBUTION_CULL_DROP = 1;
+const int CONTRIBUTION_CULL_POINT_SPLAT = 2;
+
+// Specialised per display mode by VulkanObject::createDisplayModePipelines, so the composed
+// pipeline carries none of the debug paths. DEBUG_MESH_COLOURS is set when there are few
+// enough meshes to give each its own colour in the top down view.
+layout(constant_id = 0) const int DISPLAY_MODE = 24;
+layout(constant_id = 1) const bool DEBUG_MESH_COLOURS = false;
+
+// CULL_INSTRUMENTATION builds lod_indirect_instrumented.spv, which also writes the top down
+// debug image and the projected bounds. The plain build has neither binding, see
+// VulkanObject::wantsCullInstrumentation for when each is used
+#ifdef CULL_INSTRUMENTATION
+// only the depth pyramid and SSAABB views read the projected bounds back
+const bool WRITE_PROJECTED_AABBS = DISPLAY_MODE >= 6 && DISPLAY_MODE < 23;
+#endif
+
+// LOD index of the octahedral impostor tier, below the last mesh LOD. Stored in
+// previousFrameLODBuffer like any other LOD.
+const uint IMPOSTOR_LOD = 0xFFFFFFFFu;
+// stored for instances drawn as a cut through the cluster hierarchy instead of one mesh LOD
+const uint CLUSTER_LOD = 0xFFFFFFFEu;
+
 layout(push_constant) uniform block
 {
-	bool EARLY;
+	uint CULL_STAGE;
 };
 
 layout(std140, binding = 0) readonly buffer ModelTranformsBuffer
@@ -35,6 +66,8 @@ layout(std140, binding = 2) uniform UniformBufferObject {
     mat4 culling_model;
     mat4 culling_view;
     mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
     mat4 light;
     mat4 lightVP;
 	vec4 Ka;
@@ -59,14 +92,34 @@ layout(std140, binding = 2) uniform UniformBufferObject {
 	float zNear;
 	int display_mode;
     int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+    uint material_buffer;
+    uint instance_material_buffer;
+    float lod_error_pixels;
+    int cluster_lod;
 } ubo;
 
 struct LodConfigData
 {
-    float maxDist;
+    // simplification error in model units, rising with the LOD index
+    float error;
     uint offset;
     uint size;
-    uint padding;
+    int vertexOffset;
 };
 
 layout(std140, binding = 3) readonly buffer LodConfigBuffer
@@ -92,12 +145,14 @@ struct SphereProjectionDebugData
     //vec4 depthData;
 };
 
+#ifdef CULL_INSTRUMENTATION
 layout(set = 0, binding = 7, rgba32f) uniform writeonly image2D meshesDrawnDebugView;
 
 layout(std430, binding = 8) buffer SphereProjectionDebugBuffer
 {
 	SphereProjectionDebugData data[];
 } sphereProjectionDebugBuffer;
+#endif
 
 layout(std430, binding = 9) buffer IndirectBufferCountBuffer
 {
@@ -109,6 +164,86 @@ layout(std430, binding = 10) buffer PreviousFrameLODBuffer
 	uint data[];
 } previousFrameLODBuffer;
 
+// Instances drawn as single points instead of meshes. The header is the
+// VkDrawIndirectCommand the splats are drawn with.
+layout(std430, binding = 11) buffer PointSplatBuffer
+{
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+    uint meshIds[];
+} pointSplatBuffer;
+
+layout(std430, binding = 12) buffer CullStatsBuffer
+{
+    uint contributionCulled;
+    uint pointSplats;
+    uint gbufferFragments;
+} cullStatsBuffer;
+
+struct VkDrawIndirectCommand
+{
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+};
+
+// Instances drawn as impostor billboards. One draw per geometry pass, early first, each
+// reading its mesh ids from meshIds[firstInstance + gl_InstanceIndex].
+layout(std430, binding = 13) buffer ImpostorBuffer
+{
+    VkDrawIndirectCommand draws[2];
+    uint meshIds[];
+} impostorBuffer;
+
+// Standard 20 byte command, one per LOD. Reset each pass with instanceCount 0 and
+// firstInstance at the start of the LOD's region of bucketInstanceBuffer.
+struct LodBucketCommand
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, binding = 14) buffer LodBucketBuffer
+{
+    LodBucketCommand draws[];
+} lodBucketBuffer;
+
+layout(std430, binding = 15) writeonly buffer BucketInstanceBuffer
+{
+    uint data[];
+} bucketInstanceBuffer;
+
+// the mesh ids of the current camera pass sent down the cluster path, for cluster_cut.glsl
+layout(std430, binding = 16) buffer ClusterInstanceBuffer
+{
+    uint data[];
+} clusterInstanceBuffer;
+
+// the cluster draws of the current camera pass after a 32 byte header, reset before each camera
+// cull. The cull counts the instances it sends down the cluster path and grows the indirect
+// dispatch of cluster_cut.glsl by a row per instance, which then writes the draws and counts them
+layout(std430, binding = 17) buffer ClusterDrawBuffer
+{
+    uint count;
+    uint instanceCount;
+    uint pad0[2];
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+    uint pad1;
+    VkDrawIndexedIndirectCommand draws[];
+} clusterDrawBuffer;
+
+// last frame's depth pyramid scattered in to the culling view by depth_reproject.glsl, as
+// float bits. 0 where nothing landed
+layout (set = 0, binding = 18) uniform usampler2D reprojectedDepthPyramid;
+
 const vec4 color_mapping_5[5] = vec4[](vec4(1.0, 0.0, 0.0, 1.0),
                                        vec4(0.0, 1.0, 0.0, 1.0),
                                        vec4(0.0, 0.0, 1.0, 1.0),
@@ -192,53 +327,106 @@ float linearizeDepth(float z, float n, float f)
     return (f * n)/(f * z - f - n * z);
 }
 
-// Take a position in view space and returns:
-//     uvec2(a, b)
-//     a: The number of indices
-//     b: The offset in to the index buffer
-uvec2 meshLODCalculation(vec4 mvPos, vec4 aabb, bool new)
+// Returns the coarsest LOD whose simplification error stays within ubo.lod_error_pixels once
+// projected. pixelsPerUnit is how many pixels a world space length at the mesh covers.
+uint lodIndexFromError(float pixelsPerUnit)
 {
-    uint lod_index = lodConfigData.data.length();
+    float pixelsPerModelUnit = pixelsPerUnit * modelScalesBuffer.data[gl_GlobalInvocationID.x];
 
-    if (new)
+    uint lod_index = 0;
+    for (uint curr_lod_index = 1; curr_lod_index < lodConfigData.data.length(); ++curr_lod_index)
     {
-        float max_size = max(aabb[0] - aabb[2], aabb[1] - aabb[3]);
+        if (lodConfigData.data[curr_lod_index].error * pixelsPerModelUnit > ubo.lod_error_pixels)
+        {
+            break;
+        }
+        lod_index = curr_lod_index;
+    }
+
+    return lod_index;
+}
 
-        for(uint curr_lod_index = 0; curr_lod_index < 4; ++curr_lod_index)
+// Returns the LOD index to draw a mesh with, or IMPOSTOR_LOD when it is small enough on screen
+// to be drawn as a billboard. new is false for the non culling view, which has no bounds.
+uint meshLODCalculation(vec4 mvPos, vec4 aabb, bool new)
+{
+    float radius = 0.351285 * modelScalesBuffer.data[gl_GlobalInvocationID.x];
+    // measured to the nearest point of the bounding sphere, so no part of the mesh shows more
+    // error than the budget
+    float dist = max(length(mvPos.xyz) - radius, ubo.zNear);
+    uint lod_index = lodIndexFromError(abs(ubo.culling_p11) * 0.5 * ubo.win_dim.y / dist);
+
+    if (new)
+    {
+        // even LOD 1 is too coarse for the nearest part of the mesh, but the rest of it may
+        // not need full detail
+        if (lod_index == 0 && bool(ubo.cluster_lod))
         {
-            float curr_lod_max_size = lodConfigData.data[curr_lod_index].maxDist;
-            float next_lod_max_size = lodConfigData.data[curr_lod_index + 1].maxDist;
-            if(max_size > curr_lod_max_size && max_size >= next_lod_max_size)
-            {
-                lod_index = curr_lod_index + 1;
-                break;
-            }
+            lod_index = CLUSTER_LOD;
         }
 
-        lod_index = min(lod_index, 4);
+        float screen_size = max(aabb[0] - aabb[2], aabb[1] - aabb[3]);
+        lod_index = screen_size < ubo.impostor_screen_size ? IMPOSTOR_LOD : lod_index;
         previousFrameLODBuffer.data[gl_GlobalInvocationID.x] = lod_index;
     }
-    else
+
+    return lod_index;
+}
+
+// Sends this invocation's mesh to cluster_cut.glsl to be drawn as a cut through the cluster
+// hierarchy. False, with nothing sent, when the instance list is full.
+bool appendClusterInstance()
+{
+    uint slot = atomicAdd(clusterDrawBuffer.instanceCount, 1);
+    if (slot >= clusterInstanceBuffer.data.length())
     {
-        float dist = length(mvPos);
+        return false;
+    }
 
-        float lodConfigs[5] = float[5](0.0, 0.0, 2.2, 5.5, 50.0);
+    clusterInstanceBuffer.data[slot] = gl_GlobalInvocationID.x;
+    atomicAdd(clusterDrawBuffer.dispatchY, 1);
+    return true;
+}
 
-        for(uint curr_lod_index = 0; curr_lod_index < lodConfigData.data.length() - 1; ++curr_lod_index)
+// Appends a draw of this invocation's mesh at the given LOD. Impostors go to the current
+// pass's billboard draw instead of the indexed draw list, and the cluster path to
+// cluster_cut.glsl, falling back to LOD 0 when that is full.
+void appendDraw(uint lod_index)
+{
+    if (lod_index == IMPOSTOR_LOD)
+    {
+        uint pass = CULL_STAGE == CULL_STAGE_EARLY ? 0 : 1;
+        uint impostorIdx = atomicAdd(impostorBuffer.draws[pass].instanceCount, 1);
+        impostorBuffer.meshIds[impostorBuffer.draws[pass].firstInstance + impostorIdx] = gl_GlobalInvocationID.x;
+        return;
+    }
+
+    if (lod_index == CLUSTER_LOD)
+    {
+        // the early pass replays last frame's choice, which may predate turning clusters off
+        if (bool(ubo.cluster_lod) && appendClusterInstance())
         {
-            float curr_lod_max_dist = lodConfigs[curr_lod_index];
-            float next_lod_max_dist = lodConfigs[curr_lod_index + 1];
-            if(dist > curr_lod_max_dist && dist <= next_lod_max_dist)
-            {
-                lod_index = curr_lod_index + 1;
-                break;
-            }
+            return;
         }
+        lod_index = 0;
+    }
 
-        lod_index = min(lod_index, lodConfigData.data.length() - 1);
+    // one instanced draw per LOD instead of a command per mesh
+    if (bool(ubo.instance_bucketing) && CULL_STAGE != CULL_STAGE_SHADOW)
+    {
+        uint bucketIdx = atomicAdd(lodBucketBuffer.draws[lod_index].instanceCount, 1);
+        bucketInstanceBuffer.data[lodBucketBuffer.draws[lod_index].firstInstance + bucketIdx] = gl_GlobalInvocationID.x;
+        return;
     }
 
-    return uvec2(lodConfigData.data[lod_index].size, lodConfigData.data[lod_index].offset);
+    uint drawBufferIdx = atomicAdd(indirectBufferCountBuffer.data, 1);
+
+    indirectBuffer.data[drawBufferIdx].indexCount = lodConfigData.data[lod_index].size;
+    indirectBuffer.data[drawBufferIdx].instanceCount = 1;
+    indirectBuffer.data[drawBufferIdx].firstIndex = lodConfigData.data[lod_index].offset;
+    indirectBuffer.data[drawBufferIdx].vertexOffset = lodConfigData.data[lod_index].vertexOffset;
+    indirectBuffer.data[drawBufferIdx].firstInstance = 0;
+    indirectBuffer.data[drawBufferIdx].meshId = gl_GlobalInvocationID.x;
 }
 
 // Takes a point in view space, a model radius, and a near and far frustum plane.
@@ -259,9 +447,137 @@ bool potentiallyInFrustum(vec3 mvPos, float radius, float near, float far)
     return near_far_test && frustum_test_x && frustum_test_y;
 }
 
-// Early pass. Simply draws what was drawn last frame.
+// Tests a world space sphere against the six planes of a view projection matrix with a
+// (0, 1) depth range.
+bool sphereInFrustum(mat4 VP, vec3 center, float radius)
+{
+    vec4 row0 = vec4(VP[0][0], VP[1][0], VP[2][0], VP[3][0]);
+    vec4 row1 = vec4(VP[0][1], VP[1][1], VP[2][1], VP[3][1]);
+    vec4 row2 = vec4(VP[0][2], VP[1][2], VP[2][2], VP[3][2]);
+    vec4 row3 = vec4(VP[0][3], VP[1][3], VP[2][3], VP[3][3]);
+
+    vec4 planes[6] = vec4[](row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2);
+
+    for (uint plane = 0; plane < 6; ++plane)
+    {
+        if (dot(planes[plane].xyz, center) + planes[plane].w < -radius * length(planes[plane].xyz))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Takes a screen space AABB in (0, 1) and returns the furthest depth stored in the depth
+// pyramid under it, along with the pyramid level that was sampled.
+float sampleDepthPyramid(vec4 aabb, out uint level)
+{
+    // screen space width and height of our AABB
+    float width = (aabb[0] - aabb[2]) *  ubo.win_dim.x;
+    float height = (aabb[1] - aabb[3]) *  ubo.win_dim.y;
+    // mip level of our input depth pyramid texture
+    level = uint(floor(log2(max(width, height))));
+    // Sample each corner of our AABB in the depth pyramid
+    float depth = textureLod(inDepthPyramid, vec2(aabb[2], aabb[3]), level).x;
+    depth = max(depth, textureLod(inDepthPyramid, vec2(aabb[0], aabb[3]), level).x);
+    depth = max(depth, textureLod(inDepthPyramid, vec2(aabb[2], aabb[1]), level).x);
+    depth = max(depth, textureLod(inDepthPyramid, vec2(aabb[0], aabb[1]), level).x);
+
+    return depth;
+}
+
+// Tests a mesh, as seen from this frame's culling view, against last frame's depth pyramid
+// reprojected in to that view. Returns true only if every reprojected texel under the mesh's
+// bounds is nearer than the mesh. Texels nothing was reprojected on to count as the far plane.
+bool occludedReprojected(vec3 mvPos, float radius)
+{
+    vec4 aabb;
+    if (!getAxisAlignedBoundingBox(mvPos, radius, -ubo.zNear, ubo.culling_proj, aabb))
+    {
+        return false;
+    }
+
+    // transform to (0, 1)
+    aabb = ((aabb + 1.0) * 0.5);
+    vec2 uvMin = min(aabb.xy, aabb.zw);
+    vec2 uvMax = max(aabb.xy, aabb.zw);
+
+    // the coarsest level at which the bounds span no more than one texel, so their four
+    // corners touch every texel under them
+    vec2 extent = (uvMax - uvMin) * vec2(textureSize(reprojectedDepthPyramid, 0));
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, textureQueryLevels(reprojectedDepthPyramid) - 1);
+    ivec2 size = textureSize(reprojectedDepthPyramid, level);
+    ivec2 first = clamp(ivec2(uvMin * vec2(size)), ivec2(0), size - 1);
+    ivec2 last = clamp(ivec2(uvMax * vec2(size)), ivec2(0), size - 1);
+
+    uint bits = texelFetch(reprojectedDepthPyramid, first, level).x;
+    uint depthBits = bits == 0 ? floatBitsToUint(1.0) : bits;
+    bits = texelFetch(reprojectedDepthPyramid, ivec2(last.x, first.y), level).x;
+    depthBits = max(depthBits, bits == 0 ? floatBitsToUint(1.0) : bits);
+    bits = texelFetch(reprojectedDepthPyramid, ivec2(first.x, last.y), level).x;
+    depthBits = max(depthBits, bits == 0 ? floatBitsToUint(1.0) : bits);
+    bits = texelFetch(reprojectedDepthPyramid, last, level).x;
+    depthBits = max(depthBits, bits == 0 ? floatBitsToUint(1.0) : bits);
+
+    float linearlizedDepth = linearizeDepth(uintBitsToFloat(depthBits), -1.0, -250.0) - ubo.zNear;
+    float depthSphere = (-mvPos.z - radius - ubo.zNear);
+
+    return depthSphere > linearlizedDepth;
+}
+
+// Bootstrap early pass. Used when there is no usable history of what was drawn last frame
+// (first frame, reloaded scene or camera cut). Only meshes with a large screen footprint are
+// drawn, so the depth pyramid holds good occluders before the late pass runs. Everything else
+// is marked as not drawn so the late pass tests it.
+void bootstrap(vec4 mvPos)
+{
+    float radius = 0.351285 * modelScalesBuffer.data[gl_GlobalInvocationID.x];
+
+    bool occluder = potentiallyInFrustum(mvPos.xyz, radius, 1.0, 250.0);
+
+    // a sphere reaching past the near plane covers the screen, the best occluder there is
+    vec4 aabb = vec4(1.0, 1.0, -1.0, -1.0);
+
+    if (occluder && -mvPos.z - radius > ubo.zNear)
+    {
+        // bounds past the screen edge are clamped to it rather than rejected, the nearest and
+        // largest occluders are the ones that reach past it
+        getAxisAlignedBoundingBox(mvPos.xyz, radius, -ubo.zNear, ubo.culling_proj, aabb);
+        aabb = clamp(aabb, -1.0, 1.0);
+    }
+
+    if (occluder)
+    {
+        // transform to (0, 1)
+        aabb = ((aabb + 1.0) * 0.5);
+
+        float width = (aabb[0] - aabb[2]) *  ubo.win_dim.x;
+        float height = (aabb[1] - aabb[3]) *  ubo.win_dim.y;
+        occluder = max(width, height) >= ubo.bootstrap_occluder_size;
+    }
+
+    drawnLastFrameBuffer.data[gl_GlobalInvocationID.x] = occluder;
+
+    if (!occluder)
+    {
+        return;
+    }
+
+    appendDraw(meshLODCalculation(mvPos, aabb, true));
+}
+
+// Early pass. Draws what was drawn last frame, optionally skipping meshes hidden behind last
+// frame's depth pyramid reprojected in to this frame's view. Skipped meshes are left for the
+// late pass to pick up.
 void early(vec4 mvPos)
 {
+    if (bool(ubo.bootstrap_occluders))
+    {
+        bootstrap(mvPos);
+        return;
+    }
+
     float radius = 0.351285 * modelScalesBuffer.data[gl_GlobalInvocationID.x];
 
     if (!drawnLastFrameBuffer.data[gl_GlobalInvocationID.x] ||
@@ -270,12 +586,93 @@ void early(vec4 mvPos)
 		return;
     }
 
+    if (bool(ubo.early_reprojection) && occludedReprojected(mvPos.xyz, radius))
+    {
+        drawnLastFrameBuffer.data[gl_GlobalInvocationID.x] = false;
+        return;
+    }
+
+    appendDraw(previousFrameLODBuffer.data[gl_GlobalInvocationID.x]);
+}
+
+// The shadow map is cached and split in to SHADOW_CACHE_TILES x SHADOW_CACHE_TILES tiles.
+// Matches VulkanObject::shadowCacheTilesPerSide.
+const uint SHADOW_CACHE_TILES = 8;
+
+// True if the light space bounds of a sphere touch any shadow map tile that is being
+// re-rendered this frame. Must agree with VulkanObject::shadowTileMask.
+bool touchesDirtyShadowTile(vec3 center, float radius)
+{
+    vec2 ndcMin = vec2(1.0);
+    vec2 ndcMax = vec2(-1.0);
+
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        vec3 offset = vec3((corner & 1) != 0 ? radius : -radius, (corner & 2) != 0 ? radius : -radius, (corner & 4) != 0 ? radius : -radius);
+        vec4 clip = ubo.lightVP * vec4(center + offset, 1.0);
+
+        // a corner behind the light could land anywhere, so assume every tile
+        if (clip.w <= 0.0)
+        {
+            ndcMin = vec2(-1.0);
+            ndcMax = vec2(1.0);
+            break;
+        }
+
+        ndcMin = min(ndcMin, clip.xy / clip.w);
+        ndcMax = max(ndcMax, clip.xy / clip.w);
+    }
+
+    uvec2 tileMin = uvec2(clamp((ndcMin * 0.5 + 0.5) * SHADOW_CACHE_TILES, vec2(0.0), vec2(SHADOW_CACHE_TILES - 1)));
+    uvec2 tileMax = uvec2(clamp((ndcMax * 0.5 + 0.5) * SHADOW_CACHE_TILES, vec2(0.0), vec2(SHADOW_CACHE_TILES - 1)));
+
+    for (uint y = tileMin.y; y <= tileMax.y; ++y)
+    {
+        for (uint x = tileMin.x; x <= tileMax.x; ++x)
+        {
+            uint tile = y * SHADOW_CACHE_TILES + x;
+            uint bits = tile < 32 ? ubo.shadow_dirty_tiles_lo : ubo.shadow_dirty_tiles_hi;
+            if ((bits & (1u << (tile & 31))) != 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Shadow pass. Culls against the light's frustum and picks a LOD from its error in shadow map
+// texels, biased towards coarser LODs. Writes in to the shadow indirect buffer, which is
+// bound in place of the camera's for this dispatch. Visibility history is left untouched.
+// Only meshes touching a dirty tile are drawn, the rest of the cached map is kept.
+void shadow(vec4 modelPos)
+{
+    float radius = 0.351285 * modelScalesBuffer.data[gl_GlobalInvocationID.x];
+
+    if (!sphereInFrustum(ubo.lightVP, modelPos.xyz, radius))
+    {
+        return;
+    }
+
+    if (!touchesDirtyShadowTile(modelPos.xyz, radius))
+    {
+        return;
+    }
+
+    // the light uses a 45 degree projection and the shadow map is the size of the window
+    vec4 lightClipPos = ubo.lightVP * modelPos;
+    float dist = max(lightClipPos.w - radius, ubo.zNear);
+    float pixelsPerUnit = 0.5 * ubo.win_dim.y / (dist * tan(radians(45.0 / 2.0)));
+
+    uint lod_index = min(lodIndexFromError(pixelsPerUnit) + uint(max(ubo.shadow_lod_bias, 0)), lodConfigData.data.length() - 1);
+
     uint drawBufferIdx = atomicAdd(indirectBufferCountBuffer.data, 1);
 
-    indirectBuffer.data[drawBufferIdx].indexCount = lodConfigData.data[previousFrameLODBuffer.data[gl_GlobalInvocationID.x]].size;
+    indirectBuffer.data[drawBufferIdx].indexCount = lodConfigData.data[lod_index].size;
     indirectBuffer.data[drawBufferIdx].instanceCount = 1;
-    indirectBuffer.data[drawBufferIdx].firstIndex = lodConfigData.data[previousFrameLODBuffer.data[gl_GlobalInvocationID.x]].offset;
-    indirectBuffer.data[drawBufferIdx].vertexOffset = 0;
+    indirectBuffer.data[drawBufferIdx].firstIndex = lodConfigData.data[lod_index].offset;
+    indirectBuffer.data[drawBufferIdx].vertexOffset = lodConfigData.data[lod_index].vertexOffset;
     indirectBuffer.data[drawBufferIdx].firstInstance = 0;
     indirectBuffer.data[drawBufferIdx].meshId = gl_GlobalInvocationID.x;
 }
@@ -289,6 +686,7 @@ void late(vec4 mvPos)
     float radius = 0.351285 * modelScalesBuffer.data[gl_GlobalInvocationID.x];
 
     bool visible = true;
+    bool belowContribution = false;
 
     visible = visible && potentiallyInFrustum(mvPos.xyz, radius, 1.0, 250.0);
 
@@ -302,16 +700,7 @@ void late(vec4 mvPos)
         // transform to (0, 1)
         aabb = ((aabb + 1.0) * 0.5);
 
-        // screen space width and height of our AABB
-        float width = (aabb[0] - aabb[2]) *  ubo.win_dim.x;
-        float height = (aabb[1] - aabb[3]) *  ubo.win_dim.y;
-        // mip level of our input depth pyramid texture
-        level = uint(floor(log2(max(width, height))));
-        // Sample each corner of our AABB in the depth pyramid
-        float originalDepth = textureLod(inDepthPyramid, vec2(aabb[2], aabb[3]), level).x;
-        originalDepth = max(originalDepth, textureLod(inDepthPyramid, vec2(aabb[0], aabb[3]), level).x);
-        originalDepth = max(originalDepth, textureLod(inDepthPyramid, vec2(aabb[2], aabb[1]), level).x);
-        originalDepth = max(originalDepth, textureLod(inDepthPyramid, vec2(aabb[0], aabb[1]), level).x);
+        float originalDepth = sampleDepthPyramid(aabb, level);
 
         // convert our sampled depth to view space
         float linearlizedDepth = linearizeDepth(originalDepth, -1.0, -250.0) - ubo.zNear;
@@ -320,12 +709,27 @@ void late(vec4 mvPos)
 
         visible = visible && depthSphere <= linearlizedDepth;
 
-        sphereProjectionDebugBuffer.data[gl_GlobalInvocationID.x].projectedAABB = aabb;
+        // contribution culling. A mesh covering fewer pixels than the threshold is not worth
+        // a full indexed draw
+        float pixelSize = max((aabb[0] - aabb[2]) * ubo.win_dim.x, (aabb[1] - aabb[3]) * ubo.win_dim.y);
+        belowContribution = visible && ubo.contribution_cull_mode != CONTRIBUTION_CULL_OFF && pixelSize < ubo.contribution_cull_pixels;
+
+#ifdef CULL_INSTRUMENTATION
+        if (WRITE_PROJECTED_AABBS)
+        {
+            sphereProjectionDebugBuffer.data[gl_GlobalInvocationID.x].projectedAABB = aabb;
+        }
+#endif
     }
     else
     {
         aabb = ((aabb + 1.0) * 0.5);
-        sphereProjectionDebugBuffer.data[gl_GlobalInvocationID.x].projectedAABB = -aabb;
+#ifdef CULL_INSTRUMENTATION
+        if (WRITE_PROJECTED_AABBS)
+        {
+            sphereProjectionDebugBuffer.data[gl_GlobalInvocationID.x].projectedAABB = -aabb;
+        }
+#endif
         level = 10;
     }
 
@@ -335,36 +739,51 @@ void late(vec4 mvPos)
     }
     else
     {
-        uvec2 meshResults = meshLODCalculation(mvPos, aabb, true);
+        uint lod_index = meshLODCalculation(mvPos, aabb, true);
+
+        if (belowContribution)
+        {
+            // already drawn in full by the early pass otherwise
+            if (!drawnLastFrameBuffer.data[gl_GlobalInvocationID.x])
+            {
+                atomicAdd(cullStatsBuffer.contributionCulled, 1);
+
+                if (ubo.contribution_cull_mode == CONTRIBUTION_CULL_POINT_SPLAT)
+                {
+                    uint splatIdx = atomicAdd(pointSplatBuffer.vertexCount, 1);
+                    pointSplatBuffer.meshIds[splatIdx] = gl_GlobalInvocationID.x;
+                    atomicAdd(cullStatsBuffer.pointSplats, 1);
+                }
+            }
+
+            // kept out of the visible set, so the early pass never draws it in full and it is
+            // re-tested here every frame
+            visible = false;
+        }
+
         if (visible && !drawnLastFrameBuffer.data[gl_GlobalInvocationID.x])
         {
             // For indirect draw buffer compaction we keep a count of all meshes which have been
             // drawn.
-            uint drawBufferIdx = atomicAdd(indirectBufferCountBuffer.data, 1);
-
-            indirectBuffer.data[drawBufferIdx].indexCount = mix(0, meshResults[0], visible);
-            indirectBuffer.data[drawBufferIdx].instanceCount = mix(0, 1, visible);
-            indirectBuffer.data[drawBufferIdx].firstIndex = mix(0, meshResults[1], visible);
-            indirectBuffer.data[drawBufferIdx].vertexOffset = 0;
-            indirectBuffer.data[drawBufferIdx].firstInstance = 0;
-            indirectBuffer.data[drawBufferIdx].meshId = gl_GlobalInvocationID.x;
+            appendDraw(lod_index);
         }
     }
 
-    vec4 modelPos = modelTranformsBuffer.data[gl_GlobalInvocationID.x] * vec4(0.0, 0.0, 0.0, 1.0);
-    vec2 modelXZ = modelPos.xz;
-    modelXZ -= vec2(17.0, 0.0);
-    float boundRadius = 5.0;
-    modelXZ += vec2(boundRadius + 1.0, boundRadius + 1.0);
-    modelXZ /= vec2(boundRadius * 2.0 + 2.0, boundRadius * 2.0 + 2.0);
-    modelXZ *= vec2(100.0 - radius, 100.0 - radius);
-    ivec2 debugMeshPos = ivec2(int(modelXZ[0]), int(modelXZ[1]));
-
     if (visible)
     {
         drawnLastFrameBuffer.data[gl_GlobalInvocationID.x] = true;
+#ifdef CULL_INSTRUMENTATION
         // simply for debugging to ImGui's top down view
-        if (sphereProjectionDebugBuffer.data.length() < 6)
+        vec4 modelPos = modelTranformsBuffer.data[gl_GlobalInvocationID.x] * vec4(0.0, 0.0, 0.0, 1.0);
+        vec2 modelXZ = modelPos.xz;
+        modelXZ -= vec2(17.0, 0.0);
+        float boundRadius = 5.0;
+        modelXZ += vec2(boundRadius + 1.0, boundRadius + 1.0);
+        modelXZ /= vec2(boundRadius * 2.0 + 2.0, boundRadius * 2.0 + 2.0);
+        modelXZ *= vec2(100.0 - radius, 100.0 - radius);
+        ivec2 debugMeshPos = ivec2(int(modelXZ[0]), int(modelXZ[1]));
+
+        if (DEBUG_MESH_COLOURS)
         {
             imageStore(meshesDrawnDebugView, debugMeshPos, color_mapping_5[gl_GlobalInvocationID.x % 5]);
         }
@@ -372,6 +791,7 @@ void late(vec4 mvPos)
         {
             imageStore(meshesDrawnDebugView, debugMeshPos, color_mapping_11[uint(level)]);
         }
+#endif
     }
     else
     {
@@ -387,22 +807,29 @@ void main()
     }
 
     vec4 modelPos = modelTranformsBuffer.data[gl_GlobalInvocationID.x] * vec4(0.0, 0.0, 0.0, 1.0);
+
+    if (CULL_STAGE == CULL_STAGE_SHADOW)
+    {
+        shadow(modelPos);
+        return;
+    }
+
     vec4 mvPos = ubo.culling_view * modelPos;
     mvPos = vec4(mvPos.xyz / mvPos.w, 1.0);
 
-    if (ubo.display_mode == 25)
+    if (DISPLAY_MODE == 25)
     {
-        uvec2 meshResults = meshLODCalculation(mvPos, vec4(1.0), false);
+        uint lod_index = meshLODCalculation(mvPos, vec4(1.0), false);
 
-        indirectBuffer.data[gl_GlobalInvocationID.x].indexCount = meshResults[0];
+        indirectBuffer.data[gl_GlobalInvocationID.x].indexCount = lodConfigData.data[lod_index].size;
         indirectBuffer.data[gl_GlobalInvocationID.x].instanceCount = 1;
-        indirectBuffer.data[gl_GlobalInvocationID.x].firstIndex = meshResults[1];
-        indirectBuffer.data[gl_GlobalInvocationID.x].vertexOffset = 0;
+        indirectBuffer.data[gl_GlobalInvocationID.x].firstIndex = lodConfigData.data[lod_index].offset;
+        indirectBuffer.data[gl_GlobalInvocationID.x].vertexOffset = lodConfigData.data[lod_index].vertexOffset;
         indirectBuffer.data[gl_GlobalInvocationID.x].firstInstance = 0;
     }
     else
     {
-        if (EARLY)
+        if (CULL_STAGE == CULL_STAGE_EARLY)
         {
             early(mvPos);
         }
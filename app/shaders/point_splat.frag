@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in float specularity;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec4 outNormal;
+
+// same octahedral encoding as geometry_pass.frag
+vec2 octWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+void main()
+{
+    outColor = vec4(fragColor, specularity);
+    outNormal = vec4(encodeNormal(normalize(inNormal)), 0.0, 1.0);
+}
@@ -0,0 +1,78 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Draws instances the late cull found below the contribution threshold as a single point
+// each. One vertex per instance, looked up in the point splat buffer.
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+} ubo;
+
+layout(std140, binding = 1) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+layout(std430, binding = 2) readonly buffer PointSplatBuffer
+{
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+    uint meshIds[];
+} pointSplatBuffer;
+
+layout(binding = 3) readonly buffer ModelScalesBuffer
+{
+	float data[];
+} modelScalesBuffer;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out float specularity;
+
+void main()
+{
+    uint meshId = pointSplatBuffer.meshIds[gl_VertexIndex];
+
+    vec4 worldPos = modelTranformsBuffer.data[meshId] * vec4(0.0, 0.0, 0.0, 1.0);
+    vec4 viewPos = ubo.view * worldPos;
+
+    gl_Position = ubo.proj * viewPos;
+
+    // cover the projected diameter of the chicken's bounding sphere. It is below the threshold,
+    // so this is only ever a few pixels
+    float radius = 0.351285 * modelScalesBuffer.data[meshId];
+    gl_PointSize = max(1.0, radius * abs(ubo.proj[1][1]) / max(-viewPos.z, 0.0001) * ubo.win_dim.y);
+
+    // too small to shade a surface, face the camera instead
+    vec3 cameraPos = inverse(ubo.view)[3].xyz;
+    outNormal = normalize(cameraPos - worldPos.xyz);
+
+    specularity = ubo.specular;
+
+    fragColor = vec3(ubo.diffuse, ubo.diffuse, ubo.diffuse);
+}
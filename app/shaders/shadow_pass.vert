@@ -1,4 +1,5 @@
 #version 450
+#extension GL_ARB_shader_draw_parameters: require
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -10,6 +11,28 @@ layout(binding = 0) uniform UBO
 	mat4 depthMVP;
 } ubo;
 
+layout(std140, binding = 1) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+struct VkDrawIndexedIndirectCommand
+{
+	uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint meshId;
+    uint pad1;
+    uint pad2;
+};
+
+layout(std430, binding = 2) readonly buffer IndirectBuffer
+{
+	VkDrawIndexedIndirectCommand data[];
+} indirectBuffer;
+
 out gl_PerVertex 
 {
     vec4 gl_Position;   
@@ -18,5 +41,5 @@ out gl_PerVertex
  
 void main()
 {
-	gl_Position =  ubo.depthMVP * vec4(inPosition, 1.0);
+	gl_Position =  ubo.depthMVP * modelTranformsBuffer.data[indirectBuffer.data[gl_DrawIDARB].meshId] * vec4(inPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Visibility buffer geometry pass. Writes only which instance and triangle covers each pixel,
+// visibility_resolve.frag fetches and shades the rest once per pixel
+
+// depth test before writing, so overdrawn fragments cost a depth test and nothing more
+layout(early_fragment_tests) in;
+
+layout(location = 6) flat in uint inMeshId;
+layout(location = 7) flat in uint inFirstTriangle;
+
+// instance in x, triangle in y
+layout(location = 0) out uvec2 outVisibility;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+} ubo;
+
+layout(std430, binding = 6) buffer CullStatsBuffer
+{
+    uint contributionCulled;
+    uint pointSplats;
+    uint gbufferFragments;
+} cullStatsBuffer;
+
+void main() {
+    if (bool(ubo.overdraw_stats))
+    {
+        atomicAdd(cullStatsBuffer.gbufferFragments, 1);
+    }
+
+    outVisibility = uvec2(inMeshId, inFirstTriangle + gl_PrimitiveID);
+}
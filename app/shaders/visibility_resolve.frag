@@ -0,0 +1,405 @@
+#version 450
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Visibility buffer resolve, the lighting subpass in visibility buffer mode. Each pixel's
+// instance and triangle are read from the visibility attachment, the triangle's vertices are
+// fetched and projected again, and the attributes the G-buffer would have stored are
+// interpolated with barycentrics rebuilt from the pixel position. Shading matches
+// lighting_pass.frag
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 culling_model;
+    mat4 culling_view;
+    mat4 culling_proj;
+    mat4 prev_view;
+    mat4 prev_proj;
+    mat4 light;
+    mat4 lightVP;
+	vec4 Ka;
+	vec4 Kd;
+	vec4 Ks;
+	vec4 Ke;
+    vec4 top_down_model_bounds;
+    vec2 win_dim;
+    float Ns;
+	float model_stage_on;
+	float texture_stage_on;
+	float lighting_stage_on;
+    float pcf_on;
+    float specular;
+	float diffuse;
+	float ambient;
+    float shadow_bias;
+    float p00;
+	float p11;
+    float culling_p00;
+	float culling_p11;
+	float zNear;
+	int display_mode;
+    int culling_updating;
+    int early_reprojection;
+    int bootstrap_occluders;
+    float bootstrap_occluder_size;
+    int shadow_lod_bias;
+    uint shadow_dirty_tiles_lo;
+    uint shadow_dirty_tiles_hi;
+    float contribution_cull_pixels;
+    int contribution_cull_mode;
+    float impostor_screen_size;
+    int instance_bucketing;
+    int depth_sort;
+    int overdraw_stats;
+    uint point_light_count;
+    uint light_tile_count_x;
+    uint light_tile_count_y;
+    uint material_buffer;
+    uint instance_material_buffer;
+} ubo;
+
+layout (input_attachment_index = 0, set = 0, binding = 1) uniform usubpassInput inVisibility;
+layout (input_attachment_index = 2, set = 0, binding = 4) uniform subpassInput inDepth;
+layout (set = 0, binding = 5) uniform sampler2D inShadowDepth;
+layout (set = 0, binding = 6) uniform sampler2DShadow inShadowDepthPCF;
+
+layout(std140, binding = 9) readonly buffer ModelTranformsBuffer
+{
+	mat4 data[];
+} modelTranformsBuffer;
+
+// Vertex as floats: vec3 pos, vec3 color, vec2 texCoord, vec3 norm
+const uint VERTEX_STRIDE = 11;
+const uint VERTEX_TEXCOORD = 6;
+const uint VERTEX_NORMAL = 8;
+
+layout(std430, binding = 10) readonly buffer VertexBuffer
+{
+	float data[];
+} vertexBuffer;
+
+// two 16 bit indices to a word when INDEX_16 is set
+layout(std430, binding = 11) readonly buffer IndexBuffer
+{
+	uint data[];
+} indexBuffer;
+
+struct LodConfigData
+{
+    float error;
+    uint offset;
+    uint size;
+    int vertexOffset;
+};
+
+// indices count from the start of their LOD's vertex range, so the triangle's LOD is needed
+layout(std140, binding = 12) readonly buffer LodConfigBuffer
+{
+	LodConfigData data[];
+} lodConfigData;
+
+// materials and textures through the bindless table, as geometry_pass.frag reads them
+struct Material
+{
+    vec4 baseColour;
+    uint albedoTexture;
+};
+
+layout(set = 1, binding = 0) uniform sampler2D bindlessTextures[];
+
+layout(std430, set = 1, binding = 1) readonly buffer MaterialBuffer
+{
+    Material data[];
+} materialBuffers[];
+
+layout(std430, set = 1, binding = 1) readonly buffer InstanceMaterialBuffer
+{
+    uint data[];
+} instanceMaterialBuffers[];
+
+// tile lists from light_cull.glsl, as read by lighting_pass.frag
+const uint LIGHT_TILE_SIZE = 16;
+const uint MAX_LIGHTS_PER_TILE = 256;
+
+struct PointLight
+{
+    vec4 positionRadius;
+    vec4 color;
+};
+
+layout(std430, binding = 13) readonly buffer PointLightBuffer
+{
+	PointLight data[];
+} pointLightBuffer;
+
+layout(std430, binding = 14) readonly buffer LightTileBuffer
+{
+	uint data[];
+} lightTileBuffer;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragcolor;
+
+// see lod_indirect.glsl, every branch on it below folds away once specialised
+layout(constant_id = 0) const int DISPLAY_MODE = 24;
+layout(constant_id = 2) const bool INDEX_16 = false;
+
+// cleared value, no triangle covers the pixel
+const uint VISIBILITY_EMPTY = 0xFFFFFFFF;
+
+float linearizeDepth(float z, float n, float f)
+{
+    return (f * n)/(f * z - f - n * z);
+}
+
+vec4 position_from_depth(float depth)
+{
+    float z = subpassLoad(inDepth).r;
+
+    vec4 clipSpace = vec4(inUV * 2.0 - 1.0, z, 1.0);
+	vec4 viewSpace = inverse(ubo.proj) * clipSpace;
+	viewSpace.xyz /= viewSpace.w;
+
+    vec4 position = inverse(ubo.view) * vec4( viewSpace.xyz, 1.0 );
+
+    return vec4(vec3(position), 1.0);
+}
+
+vec3 pointLighting(vec3 position, vec3 normal, vec3 albedo)
+{
+    uvec2 tile = uvec2(gl_FragCoord.xy) / LIGHT_TILE_SIZE;
+    uint tileIndex = tile.y * ubo.light_tile_count_x + tile.x;
+    uint lightCount = min(lightTileBuffer.data[tileIndex], MAX_LIGHTS_PER_TILE);
+    uint listStart = ubo.light_tile_count_x * ubo.light_tile_count_y + tileIndex * MAX_LIGHTS_PER_TILE;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < lightCount; ++i)
+    {
+        PointLight pointLight = pointLightBuffer.data[lightTileBuffer.data[listStart + i]];
+        vec3 toLight = pointLight.positionRadius.xyz - position;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - distance / pointLight.positionRadius.w, 0.0, 1.0);
+        result += pointLight.color.rgb * (falloff * falloff * max(dot(normal, toLight / max(distance, 1e-4)), 0.0));
+    }
+
+    return result * albedo;
+}
+
+uint readIndex(uint index)
+{
+    return INDEX_16 ?
+        (indexBuffer.data[index >> 1] >> ((index & 1u) * 16u)) & 0xFFFFu :
+        indexBuffer.data[index];
+}
+
+vec3 vertexPosition(uint vertexIndex)
+{
+    uint base = vertexIndex * VERTEX_STRIDE;
+    return vec3(vertexBuffer.data[base], vertexBuffer.data[base + 1], vertexBuffer.data[base + 2]);
+}
+
+vec2 vertexTexCoord(uint vertexIndex)
+{
+    uint base = vertexIndex * VERTEX_STRIDE + VERTEX_TEXCOORD;
+    return vec2(vertexBuffer.data[base], vertexBuffer.data[base + 1]);
+}
+
+vec3 vertexNormal(uint vertexIndex)
+{
+    uint base = vertexIndex * VERTEX_STRIDE + VERTEX_NORMAL;
+    return vec3(vertexBuffer.data[base], vertexBuffer.data[base + 1], vertexBuffer.data[base + 2]);
+}
+
+struct Barycentrics
+{
+    vec3 lambda;
+    // change in lambda one pixel to the right and one pixel down, for texture gradients
+    vec3 ddx;
+    vec3 ddy;
+};
+
+// perspective correct barycentrics of pixelNDC within the clip space triangle, and their
+// screen space derivatives
+Barycentrics barycentrics(vec4 p0, vec4 p1, vec4 p2, vec2 pixelNDC)
+{
+    Barycentrics result;
+
+    vec3 invW = 1.0 / vec3(p0.w, p1.w, p2.w);
+
+    vec2 ndc0 = p0.xy * invW.x;
+    vec2 ndc1 = p1.xy * invW.y;
+    vec2 ndc2 = p2.xy * invW.z;
+
+    float invDet = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+    vec3 ddxNDC = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    vec3 ddyNDC = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddxNDC, vec3(1.0));
+    float ddySum = dot(ddyNDC, vec3(1.0));
+
+    vec2 delta = pixelNDC - ndc0;
+    float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    float interpW = 1.0 / interpInvW;
+
+    result.lambda = interpW * (vec3(invW.x, 0.0, 0.0) + delta.x * ddxNDC + delta.y * ddyNDC);
+
+    // one pixel is 2 / size in NDC
+    vec2 pixelSize = 2.0 / ubo.win_dim;
+    ddxNDC *= pixelSize.x;
+    ddyNDC *= pixelSize.y;
+    ddxSum *= pixelSize.x;
+    ddySum *= pixelSize.y;
+
+    result.ddx = (result.lambda * interpInvW + ddxNDC) / (interpInvW + ddxSum) - result.lambda;
+    result.ddy = (result.lambda * interpInvW + ddyNDC) / (interpInvW + ddySum) - result.lambda;
+
+    return result;
+}
+
+void main()
+{
+    if(DISPLAY_MODE == 1)
+	{
+        float z = linearizeDepth(subpassLoad(inDepth).r, -1.0, -250.0) / (250.0);
+		outFragcolor = vec4(z, z, z,  1.0);
+        return;
+	}
+    else if(DISPLAY_MODE == 4)
+	{
+        float depth_val = linearizeDepth(texture(inShadowDepth, inUV).r, 1.0, 250.0) / 250.0;
+		outFragcolor = vec4(depth_val, depth_val, depth_val, 1.0);
+        return;
+	}
+    else if(DISPLAY_MODE == 5)
+	{
+        outFragcolor = position_from_depth(subpassLoad(inDepth).r);
+        return;
+	}
+
+    uvec2 visibility = subpassLoad(inVisibility).rg;
+    if (visibility.x == VISIBILITY_EMPTY)
+    {
+        outFragcolor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    uint meshId = visibility.x;
+    uint triangle = visibility.y;
+
+    uint firstIndex = triangle * 3;
+    // cluster hierarchy triangles lie past every LOD's and index LOD 0's range, which starts at 0
+    int vertexOffset = 0;
+    for (uint lod = 0; lod < lodConfigData.data.length(); ++lod)
+    {
+        if (firstIndex >= lodConfigData.data[lod].offset && firstIndex < lodConfigData.data[lod].offset + lodConfigData.data[lod].size)
+        {
+            vertexOffset = lodConfigData.data[lod].vertexOffset;
+            break;
+        }
+    }
+
+    uvec3 indices = uvec3(
+        readIndex(firstIndex),
+        readIndex(firstIndex + 1),
+        readIndex(firstIndex + 2)) + uint(vertexOffset);
+
+    mat4 mvp = ubo.proj * ubo.view * modelTranformsBuffer.data[meshId];
+    Barycentrics bary = barycentrics(
+        mvp * vec4(vertexPosition(indices.x), 1.0),
+        mvp * vec4(vertexPosition(indices.y), 1.0),
+        mvp * vec4(vertexPosition(indices.z), 1.0),
+        gl_FragCoord.xy / ubo.win_dim * 2.0 - 1.0);
+
+    mat3x2 texCoords = mat3x2(vertexTexCoord(indices.x), vertexTexCoord(indices.y), vertexTexCoord(indices.z));
+    vec2 texCoord = texCoords * bary.lambda;
+
+    // world space, as geometry_pass.vert rotates it
+    vec3 normal = normalize(mat3(modelTranformsBuffer.data[meshId]) *
+        (mat3(vertexNormal(indices.x), vertexNormal(indices.y), vertexNormal(indices.z)) * bary.lambda));
+
+    // what geometry_pass.frag writes to the albedo target, specular in alpha
+    uint materialIndex = instanceMaterialBuffers[ubo.instance_material_buffer].data[meshId];
+    Material material = materialBuffers[ubo.material_buffer].data[materialIndex];
+
+    vec4 albedo = vec4(vec3(ubo.diffuse) * material.baseColour.rgb, ubo.specular);
+    if (ubo.texture_stage_on > 0)
+    {
+        albedo.rgb *= textureGrad(bindlessTextures[nonuniformEXT(material.albedoTexture)], texCoord, texCoords * bary.ddx, texCoords * bary.ddy).rgb;
+    }
+
+	if(DISPLAY_MODE == 0)
+	{
+		outFragcolor = vec4(normal * 0.5 + vec3(0.5), 1.0);
+	}
+	else if(DISPLAY_MODE == 2)
+	{
+		outFragcolor = vec4(albedo.a, albedo.a, albedo.a, 1.0);
+	}
+	else if(DISPLAY_MODE == 3)
+	{
+		outFragcolor = vec4(albedo.rgb, 1.0);
+	}
+	else
+	{
+        vec4 position = position_from_depth(subpassLoad(inDepth).r);
+
+		if(ubo.model_stage_on > 0)
+        {
+            if(ubo.lighting_stage_on > 0)
+            {
+                vec3 local_light = pointLighting(position.xyz, normalize(mat3(ubo.model) * normal), albedo.rgb);
+
+                vec4 shadow_clip_space = ubo.lightVP * vec4(position.xyz, 1.0);
+                vec4 shadow_NDC = shadow_clip_space / shadow_clip_space.w;
+                shadow_NDC.xy = shadow_NDC.xy * 0.5 + 0.5;
+
+                float shadow = 1.0;
+
+                if(ubo.pcf_on > 0.5)
+                {
+                    shadow = texture(inShadowDepthPCF, shadow_NDC.xyz - vec3(0.0, 0.0, 0.00001)).r;
+                }
+                else
+                {
+                    float closest_dist = texture(inShadowDepth, shadow_NDC.xy).r;
+
+                    if(shadow_NDC.z > closest_dist + 0.00001)
+                    {
+                        outFragcolor = vec4(clamp(ubo.Ke.xyz + albedo.rgb * (ubo.ambient * ubo.Ka.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
+                        return;
+                    }
+                }
+
+                vec3 frag_pos = position.xyz;
+                vec3 normal_dir = normalize((mat3(ubo.model) * normal).xyz);
+                vec3 light_pos = (ubo.light * vec4(-2.5, 0.0, 0.0, 1.0)).xyz;
+                vec3 light_dir = normalize(frag_pos - light_pos);
+
+                float ambient = ubo.ambient;
+                float diffuse = ubo.diffuse * max(0.0, dot(normal_dir, -light_dir)) * shadow;
+
+                float specular = 0.0;
+                if(diffuse != 0.0)
+                {
+                    vec3 camera_dir = normalize(frag_pos - vec3(-2.0, 0.0, 0.0));
+                    vec3 reflection_dir = normalize(reflect(light_dir, normal_dir));
+
+                    float spec_val = pow(max(dot(reflection_dir, -camera_dir), 0.0), ubo.Ns);
+                    specular = clamp(albedo.a * spec_val, 0.0, 1.0) * shadow;
+                }
+
+                outFragcolor = vec4(clamp(ubo.Ke.xyz + albedo.rgb * (ambient * ubo.Ka.xyz + diffuse * ubo.Kd.xyz + specular * ubo.Ks.xyz) + local_light, vec3(0.0), vec3(1.0)), 1.0);
+             }
+             else
+             {
+                outFragcolor = vec4(albedo.rgb, 1.0);
+             }
+        }
+        else
+        {
+            outFragcolor = vec4(0.0);
+        }
+	}
+}